@@ -0,0 +1,309 @@
+//// audio_bpm.cpp
+// Feeds a WAV file (or a generated drum track) through the audio beat detection
+//
+// The audio is resampled to AudioBeat's rate and 8 bits, as the ADC would
+// deliver it, then run through two passes:
+//  - AudioBeat on its own, timing update() per block of samples with the
+//    host's steady clock, and reporting the tempo it settles on
+//  - the whole of Control on the virtual clock, samples pushed as they'd
+//    arrive, to check the beat clock follows the music (and, for a
+//    generated track, how far its beats land from the real ones)
+// --expect makes it a test: the exit status says whether both passes found
+// the tempo to within --tolerance BPM.
+//
+//   audio_bpm <file.wav> [--expect BPM] [--tolerance BPM]
+//   audio_bpm --synth BPM [--seconds N] [--write out.wav] [--expect BPM] [--tolerance BPM]
+//   audio_bpm --noise [--seconds N] --expect-none      (nothing to lock onto: the tempo must be left alone)
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "Control.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/******************************/
+/*          WAV FILES         */
+/******************************/
+struct Audio
+{
+  unsigned rate;
+  std::vector<float> samples;   // mono, -1..1
+};
+
+static uint32_t le32(const unsigned char *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint16_t le16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+
+static bool readWav(const char *path, Audio &audio)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f) { fprintf(stderr, "can't open %s\n", path); return false; }
+  std::vector<unsigned char> data;
+  unsigned char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+
+  if (data.size() < 12 || memcmp(&data[0], "RIFF", 4) || memcmp(&data[8], "WAVE", 4)) {
+    fprintf(stderr, "%s: not a WAV file\n", path);
+    return false;
+  }
+  unsigned channels = 0, bits = 0, format = 0;
+  for (size_t pos = 12; pos + 8 <= data.size();) {
+    uint32_t size = le32(&data[pos + 4]);
+    const unsigned char *body = &data[pos + 8];
+    if (pos + 8 + size > data.size()) size = data.size() - pos - 8;
+    if (!memcmp(&data[pos], "fmt ", 4) && size >= 16) {
+      format = le16(body);
+      channels = le16(body + 2);
+      audio.rate = le32(body + 4);
+      bits = le16(body + 14);
+    } else if (!memcmp(&data[pos], "data", 4)) {
+      if (format != 1 || (bits != 8 && bits != 16) || channels == 0) {
+        fprintf(stderr, "%s: only 8 or 16 bit PCM is supported\n", path);
+        return false;
+      }
+      unsigned frameBytes = channels * bits / 8;
+      for (size_t i = 0; i + frameBytes <= size; i += frameBytes) {
+        float sum = 0;
+        for (unsigned c = 0; c < channels; c++) {
+          const unsigned char *s = body + i + c * bits / 8;
+          sum += bits == 16 ? (int16_t)le16(s) / 32768.0f : (s[0] - 128) / 128.0f;
+        }
+        audio.samples.push_back(sum / channels);
+      }
+      return true;
+    }
+    pos += 8 + size + (size & 1);
+  }
+  fprintf(stderr, "%s: no audio data\n", path);
+  return false;
+}
+
+static void put32(FILE *f, uint32_t v) { for (int i = 0; i < 4; i++) fputc((v >> (8 * i)) & 0xFF, f); }
+static void put16(FILE *f, uint16_t v) { fputc(v & 0xFF, f); fputc(v >> 8, f); }
+
+static void writeWav(const char *path, const Audio &audio)
+{
+  FILE *f = fopen(path, "wb");
+  if (!f) { fprintf(stderr, "can't write %s\n", path); return; }
+  uint32_t bytes = audio.samples.size() * 2;
+  fwrite("RIFF", 1, 4, f); put32(f, 36 + bytes); fwrite("WAVE", 1, 4, f);
+  fwrite("fmt ", 1, 4, f); put32(f, 16); put16(f, 1); put16(f, 1);
+  put32(f, audio.rate); put32(f, audio.rate * 2); put16(f, 2); put16(f, 16);
+  fwrite("data", 1, 4, f); put32(f, bytes);
+  for (float s : audio.samples) put16(f, (uint16_t)(int16_t)lrintf(fmaxf(-1, fminf(1, s)) * 32767));
+  fclose(f);
+}
+
+/******************************/
+/*        DRUM TRACK          */
+/******************************/
+// Kick on every beat, snare on 2 and 4, hats on the eighths, over a held
+// chord and some noise. Repeatable: the noise is seeded.
+static Audio synthTrack(double bpm, double seconds)
+{
+  Audio audio;
+  audio.rate = 22050;
+  size_t n = (size_t)(seconds * audio.rate);
+  audio.samples.resize(n);
+  double beat = 60.0 / bpm;
+  uint32_t seed = 12345;
+  auto noise = [&seed]() { seed = seed * 1664525u + 1013904223u; return (int32_t)seed / 2147483648.0; };
+  double lastNoise = 0;
+  for (size_t i = 0; i < n; i++) {
+    double t = i / (double)audio.rate;
+    double inBeat = fmod(t, beat);
+    double inEighth = fmod(t, beat / 2);
+    int beatNumber = (int)(t / beat);
+    double white = noise();
+    double hiss = white - lastNoise;    // crude high pass
+    lastNoise = white;
+
+    double kickPhase = 2 * M_PI * (50 * inBeat + 70 * 0.03 * (1 - exp(-inBeat / 0.03)));
+    double s = 0.6 * sin(kickPhase) * exp(-inBeat / 0.08);
+    if (beatNumber % 2 == 1) s += (0.25 * white + 0.2 * sin(2 * M_PI * 180 * inBeat)) * exp(-inBeat / 0.06);
+    s += 0.12 * hiss * exp(-inEighth / 0.02);
+    s += 0.05 * (sin(2 * M_PI * 220 * t) + sin(2 * M_PI * 277.2 * t) + sin(2 * M_PI * 329.6 * t));
+    s += 0.02 * white;
+    audio.samples[i] = (float)s;
+  }
+  return audio;
+}
+
+// Crowd noise stand-in: loud, but no beat in it
+static Audio synthNoise(double seconds)
+{
+  Audio audio;
+  audio.rate = 22050;
+  audio.samples.resize((size_t)(seconds * audio.rate));
+  uint32_t seed = 54321;
+  for (float &s : audio.samples) {
+    seed = seed * 1664525u + 1013904223u;
+    s = 0.3f * (int32_t)seed / 2147483648.0f;
+  }
+  return audio;
+}
+
+/******************************/
+/*     ADC SAMPLE STREAM      */
+/******************************/
+// Box filter down to AudioBeat's rate, then to 8 bits around 128
+static std::vector<uint8_t> toAdcSamples(const Audio &audio)
+{
+  std::vector<uint8_t> out;
+  double step = audio.rate * (AudioBeat::samplePeriodUs / 1e6);   // input samples per output sample
+  double next = step, sum = 0;
+  unsigned count = 0;
+  for (size_t i = 0; i < audio.samples.size(); i++) {
+    sum += audio.samples[i];
+    count++;
+    if (i + 1 >= next) {
+      long v = lround(128 + 127 * sum / count);
+      out.push_back((uint8_t)constrain(v, 0L, 255L));
+      sum = 0;
+      count = 0;
+      next += step;
+    }
+  }
+  return out;
+}
+
+/******************************/
+/*          PASSES            */
+/******************************/
+CRGB leds[NUM_LEDS];
+Control control(leds, NUM_LEDS);
+
+struct DetectorResult
+{
+  unsigned bpm;
+  bool locked;
+  unsigned confidence;
+  unsigned onsets;
+  unsigned blocks;
+  double nsPerBlock;
+  double worstNsPerBlock;
+};
+
+// AudioBeat alone, a block of samples at a time, timed
+static DetectorResult runDetector(const std::vector<uint8_t> &samples)
+{
+  AudioBeat detector;
+  DetectorResult r = {};
+  double totalNs = 0;
+  unsigned long nowUs = 0;
+  for (size_t i = 0; i < samples.size(); i += AudioBeat::blockSize) {
+    size_t end = std::min(samples.size(), i + AudioBeat::blockSize);
+    for (size_t k = i; k < end; k++) detector.push(samples[k]);
+    nowUs += (end - i) * AudioBeat::samplePeriodUs;
+    auto start = std::chrono::steady_clock::now();
+    bool onset = false;
+    for (size_t k = i; k < end; k += AudioBeat::sliceSamples) onset |= detector.update(nowUs);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    totalNs += ns;
+    if (ns > r.worstNsPerBlock) r.worstNsPerBlock = ns;
+    if (onset) r.onsets++;
+  }
+  r.blocks = detector.blocks();
+  r.nsPerBlock = r.blocks ? totalNs / r.blocks : 0;
+  r.bpm = detector.bpm();
+  r.locked = detector.locked();
+  r.confidence = detector.confidence();
+  return r;
+}
+
+struct ClockResult
+{
+  unsigned bpm;
+  double meanErrorMs;   // beat clock beats vs the generated track's, over the last half
+  unsigned beatsChecked;
+};
+
+// The whole of Control on the virtual clock, samples arriving in real time
+static ClockResult runControl(const std::vector<uint8_t> &samples, double trueBpm)
+{
+  control.setupControl();
+  ClockResult r = {};
+  unsigned long startUs = micros();
+  unsigned long endUs = startUs + samples.size() * AudioBeat::samplePeriodUs;
+  size_t next = 0;
+  uint16_t lastBeat = control.getBeatClock().beats();
+  double errorSum = 0;
+  while ((long)(micros() - endUs) < 0) {
+    unsigned long t = micros() - startUs;
+    while (next < samples.size() && next * AudioBeat::samplePeriodUs <= t) control.getAudio().push(samples[next++]);
+    control.handleControl();
+    uint16_t beats = control.getBeatClock().beats();
+    if (beats != lastBeat && trueBpm > 0 && t > (endUs - startUs) / 2) {
+      double period = 60e6 / trueBpm;
+      double error = fmod((double)t, period);
+      if (error > period / 2) error -= period;
+      errorSum += fabs(error);
+      r.beatsChecked++;
+    }
+    lastBeat = beats;
+    host::advanceMicros(100);
+  }
+  r.bpm = control.get_BPM();
+  r.meanErrorMs = r.beatsChecked ? errorSum / r.beatsChecked / 1000 : 0;
+  return r;
+}
+
+int main(int argc, char **argv)
+{
+  const char *wav = 0, *writePath = 0;
+  double synthBpm = 0, seconds = 30, expect = 0, tolerance = 2;
+  bool noise = false, expectNone = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--synth") && i + 1 < argc) synthBpm = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--noise")) noise = true;
+    else if (!strcmp(argv[i], "--expect-none")) expectNone = true;
+    else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--write") && i + 1 < argc) writePath = argv[++i];
+    else if (!strcmp(argv[i], "--expect") && i + 1 < argc) expect = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) tolerance = atof(argv[++i]);
+    else wav = argv[i];
+  }
+
+  Audio audio;
+  unsigned startBpm = control.get_BPM();
+  if (noise || synthBpm > 0) {
+    audio = noise ? synthNoise(seconds) : synthTrack(synthBpm, seconds);
+    if (writePath) writeWav(writePath, audio);
+  } else if (!wav || !readWav(wav, audio)) {
+    fprintf(stderr, "usage: audio_bpm <file.wav> | --synth BPM | --noise [--seconds N] [--write out.wav]"
+                    " [--expect BPM] [--tolerance BPM] [--expect-none]\n");
+    return 2;
+  }
+  std::vector<uint8_t> samples = toAdcSamples(audio);
+
+  DetectorResult d = runDetector(samples);
+  ClockResult c = runControl(samples, synthBpm);
+
+  printf("%s: %.1f s, %zu samples at %.0f Hz\n", noise ? "noise" : (synthBpm > 0 ? "synth" : wav),
+         samples.size() * AudioBeat::samplePeriodUs / 1e6, samples.size(), 1e6 / AudioBeat::samplePeriodUs);
+  printf("detector:   %u BPM (confidence %u/255, %s), %u onsets in %u blocks\n", d.bpm, d.confidence,
+         d.locked ? "locked" : "not locked", d.onsets, d.blocks);
+  printf("cost:       %.0f ns per %u sample block (worst %.0f ns), %.3f%% of real time\n",
+         d.nsPerBlock, AudioBeat::blockSize, d.worstNsPerBlock, 100 * d.nsPerBlock / (AudioBeat::blockUs * 1000.0));
+  printf("beat clock: %u BPM", c.bpm);
+  if (c.beatsChecked) printf(", beats %.1f ms from the track's on average (last %u beats)", c.meanErrorMs, c.beatsChecked);
+  printf("\n");
+
+  if (expect > 0) {
+    bool ok = fabs(d.bpm - expect) <= tolerance && fabs(c.bpm - expect) <= tolerance;
+    printf("%s: expected %.0f +/- %.0f BPM\n", ok ? "PASS" : "FAIL", expect, tolerance);
+    return ok ? 0 : 1;
+  }
+  if (expectNone) {
+    bool ok = !d.locked && c.bpm == startBpm;
+    printf("%s: expected no tempo to follow\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+  }
+  return 0;
+}
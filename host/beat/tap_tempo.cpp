@@ -0,0 +1,93 @@
+//// tap_tempo.cpp
+// Tap tempo on the beat clock (totem/BeatClock.h), tap by tap
+//
+// Runs of taps at set intervals go through BeatClock::tap(), and the period
+// it's left with is printed after each:
+//  - a new run after a pause, at a new tempo: from its second tap on, the
+//    period is the new run's, with nothing left over from the run before
+//  - off-tempo taps in a run: after two, the old intervals are forgotten
+//    and the period is the new tempo's
+//  - bounces, 50 ms after each tap: ignored, and the next interval is from
+//    the real tap
+//  - the fastest taps: the tempo stops at the fastest the clock takes, and
+//    that still fits get_BPM()'s byte
+// --check makes it a test.
+//
+//   tap_tempo [--check]
+#include <Arduino.h>
+
+#include "BeatClock.h"
+
+#include <cstdio>
+#include <cstring>
+
+static bool failed = false;
+static void expect(bool ok, const char *what)
+{
+  printf("  %-62s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failed = true;
+}
+
+static unsigned long nowUs = 1000000UL;
+
+// n taps, intervalMs apart (the first after a gap of intervalMs); true if
+// from the tap numbered from on (1 = the first), the period was periodMs
+static bool taps(BeatClock &clock, uint8_t n, unsigned long intervalMs, unsigned long periodMs, uint8_t from)
+{
+  bool ok = true;
+  printf("  %u taps %lu ms apart:", n, intervalMs);
+  for (uint8_t i = 1; i <= n; i++) {
+    nowUs += intervalMs * 1000;
+    clock.tap(nowUs);
+    printf(" %lu", (unsigned long)clock.periodUs() / 1000);
+    if (i >= from && clock.periodUs() != periodMs * 1000) ok = false;
+  }
+  printf(" ms\n");
+  return ok;
+}
+
+int main(int argc, char **argv)
+{
+  bool check = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--check")) check = true;
+    else { fprintf(stderr, "usage: tap_tempo [--check]\n"); return 2; }
+  }
+
+  printf("A new run after a pause\n");
+  BeatClock clock;
+  taps(clock, 3, 500, 500, 1);
+  nowUs += 5000000UL;
+  expect(taps(clock, 5, 300, 300, 2), "300 ms from the new run's second tap");
+
+  printf("\nOff-tempo taps in a run\n");
+  BeatClock offTempo;
+  taps(offTempo, 6, 500, 500, 2);
+  expect(taps(offTempo, 5, 350, 350, 2), "350 ms from the second off-tempo tap");
+  taps(offTempo, 10, 350, 350, 1);
+  expect(taps(offTempo, 4, 420, 420, 2), "and again with the ring wrapped: 420 ms");
+
+  printf("\nBounces\n");
+  BeatClock bounces;
+  taps(bounces, 4, 500, 500, 1);
+  bool steady = true;
+  printf("  taps 500 ms apart, each with a bounce 50 ms after:");
+  for (uint8_t i = 0; i < 6; i++) {
+    nowUs += 50000UL;
+    bounces.tap(nowUs);
+    nowUs += 450000UL;
+    bounces.tap(nowUs);
+    printf(" %lu", (unsigned long)bounces.periodUs() / 1000);
+    if (bounces.periodUs() != 500000UL) steady = false;
+  }
+  printf(" ms\n");
+  expect(steady, "bounces ignored: 500 ms");
+
+  printf("\nThe fastest taps\n");
+  BeatClock fastest;
+  taps(fastest, 4, BeatClock::minPeriodUs / 1000 - 20, BeatClock::minPeriodUs / 1000, 2);
+  expect(fastest.periodUs() == BeatClock::minPeriodUs, "held at the fastest period");
+  expect(60000000UL / BeatClock::minPeriodUs <= 255, "its BPM fits a byte");
+
+  return check && failed ? 1 : 0;
+}
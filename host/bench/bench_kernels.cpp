@@ -0,0 +1,119 @@
+//// bench_kernels.cpp
+// The colour kernels (totem/Kernels.h) against the per pixel code they replaced
+//
+// Each case is a piece of a pattern as it was written before (a pixel at a
+// time: CRGB::fadeToBlackBy, +=, CHSV, the rows tested one by one) and as
+// it is now, run on the same frame of random pixels. Gives the host CPU
+// ns a pixel of each and the speedup, and checks the two leave the frame
+// exactly the same; any that don't are a failure.
+//
+//   bench_kernels [--frames N]
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "Control.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+static CRGB start[NUM_LEDS], before[NUM_LEDS], after[NUM_LEDS];
+static CRGB other[NUM_LEDS];
+
+static inline double nowNs()
+{
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Case
+{
+  const char *name;
+  std::function<void(CRGB *)> before, after;
+};
+
+static const uint8_t currentRow = NUM_ROWS / 2;
+
+static const Case cases[] = {
+  { "fade 20, whole frame",
+    [](CRGB *leds) { for (uint16_t i = 0; i < NUM_LEDS; i++) leds[i].fadeToBlackBy(20); },
+    [](CRGB *leds) { fadeSpan(leds, NUM_LEDS, 20); } },
+  { "fade, all rows but one",
+    [](CRGB *leds) {
+      for (uint8_t r = 0; r < NUM_ROWS; r++) {
+        if (r == currentRow) continue;
+        for (CRGB &led : Geometry::row(leds, r)) led.fadeToBlackBy(10);
+      }
+    },
+    [](CRGB *leds) { fadeSpanExcept(leds, NUM_LEDS, Geometry::row(leds, currentRow), 10); } },
+  { "fade, all diagonals but one",
+    [](CRGB *leds) {
+      for (uint8_t d = 0; d < NUM_ROWS; d++) {
+        if (d == currentRow) continue;
+        for (CRGB &led : Geometry::diag(leds, d)) led.fadeToBlackBy(10);
+      }
+    },
+    [](CRGB *leds) { fadeSpanExcept(leds, NUM_LEDS, Geometry::diag(leds, currentRow), 10); } },
+  { "fade, a column",
+    [](CRGB *leds) { for (CRGB &led : Geometry::col(leds, 1)) led.fadeToBlackBy(10); },
+    [](CRGB *leds) { fadeSet(Geometry::col(leds, 1), 10); } },
+  { "scale video, whole frame",
+    [](CRGB *leds) { for (uint16_t i = 0; i < NUM_LEDS; i++) leds[i].nscale8_video(100); },
+    [](CRGB *leds) { scaleSpanVideo(leds, NUM_LEDS, 100); } },
+  { "saturating add, frames",
+    [](CRGB *leds) { for (uint16_t i = 0; i < NUM_LEDS; i++) leds[i] += other[i]; },
+    [](CRGB *leds) { addSpan(leds, other, NUM_LEDS); } },
+  { "hue gradient, frame (s 240)",
+    [](CRGB *leds) { fill_rainbow(leds, NUM_LEDS, 17, 7); },
+    [](CRGB *leds) { hueSpan(leds, NUM_LEDS, 17, 7, 240); } },
+  { "hue gradient, frame (v 192)",
+    [](CRGB *leds) { uint8_t h = 17; for (uint16_t i = 0; i < NUM_LEDS; i++, h += 15) leds[i] = CHSV(h, 255, 192); },
+    [](CRGB *leds) { hueSpan(leds, NUM_LEDS, 17, 15, 255, 192); } },
+  { "hue gradient added, a row",
+    [](CRGB *leds) {
+      uint8_t h = 17;
+      for (CRGB &led : Geometry::row(leds, currentRow)) { led += CHSV(h, 255, 192); h += 15; }
+    },
+    [](CRGB *leds) { addHueSet(Geometry::row(leds, currentRow), 17, 15, 255, 192); } },
+};
+
+static double bench(const std::function<void(CRGB *)> &f, CRGB *leds, unsigned long frames)
+{
+  double t0 = nowNs();
+  for (unsigned long i = 0; i < frames; i++) {
+    f(leds);
+    if (!(i & 15)) memcpy(leds, start, sizeof(start));    // not let it fade to nothing
+  }
+  return (nowNs() - t0) / frames / NUM_LEDS;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long frames = 200000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc) frames = strtoul(argv[++i], 0, 10);
+    else { fprintf(stderr, "usage: bench_kernels [--frames N]\n"); return 2; }
+  }
+  for (uint16_t i = 0; i < NUM_LEDS; i++) {
+    start[i] = CRGB(random8(), random8(), random8());
+    other[i] = CRGB(random8(), random8(), random8());
+  }
+
+  printf("\nColour kernels on %dx%d (%d LEDs), %lu frames each, host CPU\n", NUM_COLS, NUM_ROWS, NUM_LEDS, frames);
+  printf("%-30s %14s %14s %9s %10s\n", "", "per pixel ns", "kernel ns", "speedup", "same");
+  int differ = 0;
+  for (const Case &c : cases) {
+    memcpy(before, start, sizeof(start));
+    memcpy(after, start, sizeof(start));
+    c.before(before);
+    c.after(after);
+    bool same = !memcmp(before, after, sizeof(before));
+    differ += !same;
+    double b = bench(c.before, before, frames), a = bench(c.after, after, frames);
+    printf("%-30s %14.3f %14.3f %8.1fx %10s\n", c.name, b, a, b / a, same ? "yes" : "DIFFER");
+  }
+  printf("(ns a pixel of the frame, whatever the pixels touched)\n");
+  return differ ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+//// bench_noise.cpp
+// Cost of the noise field (totem/Noise.h) an octave at a time, cached and not
+//
+// Renders the field for 1 to NOISE_OCTAVES octaves at 60 frames a second
+// and 120 BPM, with the planes cached between frames and with every octave
+// worked out from scratch each frame, timing each frame with the host's
+// steady clock. Frames where an octave crossed into its next time cell (a
+// plane to work out) are the cached case's worst; the rest are the two
+// multiply-adds and a lerp a pixel an octave. The spread of the values
+// comes out too, as a check the field fills its range.
+//
+//   bench_noise [--frames N]
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "Control.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static inline double nowNs()
+{
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Run
+{
+  double meanNs;          // all frames
+  double steadyNs;        // frames with no plane to work out
+  double crossingNs;      // frames with one, mean
+  double worstNs;
+  double planesPerFrame;
+  uint8_t lo, hi;         // values: 1st and 99th percentile
+};
+
+static const NoiseParams params = {2, 64, 32, 1};    // as Lava
+
+static Run bench(uint8_t octaves, uint8_t cached, unsigned long frames)
+{
+  Noise.setCached(cached);
+  unsigned long hist[256] = {0};
+  double all = 0, steady = 0, crossing = 0, worst = 0;
+  unsigned long steadyN = 0, crossingN = 0;
+  unsigned long planes0 = Noise.stats().planes;
+  uint32_t t = 0;     // 16.16 beats
+  for (unsigned long f = 0; f < frames + 1; f++) {
+    unsigned long planes = Noise.stats().planes;
+    double t0 = nowNs();
+    Noise.render(params, t >> 16, t, octaves, [&](uint16_t, uint8_t v) { hist[v]++; });
+    double ns = nowNs() - t0;
+    t += 65536 / 30;
+    if (f == 0) { planes0 = Noise.stats().planes; continue; }     // filling the cache from cold
+    all += ns;
+    worst = std::max(worst, ns);
+    if (Noise.stats().planes != planes) { crossing += ns; crossingN++; }
+    else { steady += ns; steadyN++; }
+  }
+  Run r;
+  r.meanNs = all / frames;
+  r.steadyNs = steadyN ? steady / steadyN : 0;
+  r.crossingNs = crossingN ? crossing / crossingN : 0;
+  r.worstNs = worst;
+  r.planesPerFrame = (double)(Noise.stats().planes - planes0) / frames;
+  unsigned long total = 0, seen = 0;
+  for (int v = 0; v < 256; v++) total += hist[v];
+  r.lo = 0; r.hi = 255;
+  for (int v = 0; v < 256; v++) { seen += hist[v]; if (seen * 100 < total) r.lo = v + 1; }
+  seen = 0;
+  for (int v = 255; v >= 0; v--) { seen += hist[v]; if (seen * 100 < total) r.hi = v - 1; }
+  return r;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long frames = 6000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc) frames = strtoul(argv[++i], 0, 10);
+    else { fprintf(stderr, "usage: bench_noise [--frames N]\n"); return 2; }
+  }
+
+  printf("\nNoise field on %dx%d (%d LEDs), %lu frames at 60 FPS and 120 BPM, host CPU\n", NUM_COLS, NUM_ROWS, NUM_LEDS, frames);
+  printf("%8s %14s %14s %14s %14s %14s %10s %10s\n", "octaves", "scratch ns", "cached ns", "steady ns", "crossing ns",
+         "worst ns", "planes/fr", "p1..p99");
+  double lastScratch = 0, lastCached = 0;
+  for (uint8_t o = 1; o <= NOISE_OCTAVES; o++) {
+    Run scratch = bench(o, 0, frames);
+    Run cached = bench(o, o, frames);
+    printf("%8u %14.0f %14.0f %14.0f %14.0f %14.0f %10.3f %6u..%u\n", o, scratch.meanNs, cached.meanNs, cached.steadyNs,
+           cached.crossingNs, cached.worstNs, cached.planesPerFrame, cached.lo, cached.hi);
+    printf("%8s %14.0f %14.0f   (octave %u alone; %.1f and %.1f ns a pixel)\n", "+", scratch.meanNs - lastScratch,
+           cached.meanNs - lastCached, o, (scratch.meanNs - lastScratch) / NUM_LEDS, (cached.meanNs - lastCached) / NUM_LEDS);
+    lastScratch = scratch.meanNs;
+    lastCached = cached.meanNs;
+  }
+  printf("cache: %u bytes of SRAM for %d octaves\n", (unsigned)(NOISE_CACHED_OCTAVES * 4 * NUM_LEDS), NOISE_CACHED_OCTAVES);
+  return 0;
+}
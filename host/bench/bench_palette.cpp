@@ -0,0 +1,123 @@
+//// bench_palette.cpp
+// Per pixel cost of palette colours: ColorFromPalette against the table (totem/Palette.h)
+//
+// Draws a frame of colours from a palette the way the palette patterns did
+// before the table (a CRGBPalette16 from the flash palette, then
+// ColorFromPalette each pixel), and from the table, with and without a
+// brightness, and gives the cost of each per pixel. Then what the table
+// costs on top: expanding it for a new palette, a frame of a blend to
+// another, and a frame with nothing to do; and that what it gives back is
+// what ColorFromPalette would have.
+//
+//   bench_palette [--frames N]
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "Control.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static CRGB leds[NUM_LEDS];
+static const char *user = "bench";
+
+static inline double nowNs()
+{
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ns a pixel, ColorFromPalette as the patterns did it
+static double benchDirect(unsigned long frames, bool bright)
+{
+  double t0 = nowNs();
+  for (unsigned long f = 0; f < frames; f++) {
+    CRGBPalette16 palette = PartyColors_p;
+    for (uint16_t i = 0; i < NUM_LEDS; i++) {
+      leds[i] = bright ? ColorFromPalette(palette, f + i * 2, f + i * 10) : ColorFromPalette(palette, f + i * 2);
+    }
+  }
+  return (nowNs() - t0) / frames / NUM_LEDS;
+}
+
+// ns a pixel, from the table
+static double benchTable(unsigned long frames, bool bright)
+{
+  double t0 = nowNs();
+  for (unsigned long f = 0; f < frames; f++) {
+    Palettes.frame();
+    PaletteLookup colours = Palettes.use(user, PartyColors_p);
+    for (uint16_t i = 0; i < NUM_LEDS; i++) {
+      leds[i] = bright ? colours(f + i * 2, f + i * 10) : colours(f + i * 2);
+    }
+  }
+  return (nowNs() - t0) / frames / NUM_LEDS;
+}
+
+// ns for Palettes.frame() and use(), a frame, over 'frames' frames, moving
+// between two palettes over blendFrames (0: the same palette throughout)
+static double benchUpkeep(unsigned long frames, uint8_t blendFrames)
+{
+  Palettes.frame();
+  Palettes.use(user, RainbowColors_p);
+  double t0 = nowNs();
+  for (unsigned long f = 0; f < frames; f++) {
+    Palettes.frame();
+    Palettes.use(user, blendFrames && f % 256 < 128 ? PartyColors_p : RainbowColors_p, blendFrames);
+  }
+  return (nowNs() - t0) / frames;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long frames = 20000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc) frames = strtoul(argv[++i], 0, 10);
+    else { fprintf(stderr, "usage: bench_palette [--frames N]\n"); return 2; }
+  }
+
+  printf("\nPalette colours on %dx%d (%d LEDs), %lu frames each, host CPU, table of %d\n", NUM_COLS, NUM_ROWS, NUM_LEDS,
+         frames, PALETTE_LUT_SIZE);
+  printf("%-22s %14s %14s %10s\n", "", "before ns/px", "table ns/px", "speedup");
+  double before = benchDirect(frames, false), after = benchTable(frames, false);
+  printf("%-22s %14.2f %14.2f %9.1fx\n", "colour", before, after, before / after);
+  before = benchDirect(frames, true);
+  after = benchTable(frames, true);
+  printf("%-22s %14.2f %14.2f %9.1fx\n", "colour, brightness", before, after, before / after);
+
+  unsigned long entries = Palettes.stats().entries;
+  double steady = benchUpkeep(frames, 0);
+  double blending = benchUpkeep(frames, 128);
+  unsigned long expanded = Palettes.stats().entries - entries;
+  double t0 = nowNs();
+  for (unsigned long f = 0; f < frames; f++) {
+    Palettes.frame(); Palettes.frame();     // no longer in use: the next use() takes the table over and expands it
+    Palettes.use(f & 1 ? "a" : "b", f & 2 ? PartyColors_p : RainbowColors_p);
+  }
+  double full = (nowNs() - t0) / frames;
+  printf("\nTable upkeep a frame: %.0f ns steady, %.0f ns blending (%.1f entries a frame), %.0f ns expanding it all\n",
+         steady, blending, (double)expanded / frames, full);
+  printf("  the before cost a frame here: %.0f ns; SRAM: %u bytes (table) + %u (the palette blended from)\n",
+         before * NUM_LEDS, (unsigned)(PALETTE_LUT_SIZE * sizeof(CRGB)), (unsigned)sizeof(CRGBPalette16));
+
+  // every index and brightness, from the table and worked out, for each palette
+  const TProgmemRGBPalette16 *palettes[] = { &PartyColors_p, &RainbowColors_p, &OceanColors_p, &ForestColors_p,
+                                             &LavaColors_p, &HeatColors_p, &CloudColors_p };
+  unsigned long differ = 0;
+  for (const TProgmemRGBPalette16 *p : palettes) {
+    Palettes.frame(); Palettes.frame();
+    PaletteLookup table = Palettes.use(user, *p);
+    CRGBPalette16 palette = *p;
+    for (int index = 0; index < 256; index++) {
+      for (int b = 0; b < 256; b++) {
+        uint8_t shared = index >> PaletteLutShift << PaletteLutShift;
+        differ += table(index, b) != ColorFromPalette(palette, shared, b);
+      }
+      differ += table(index) != ColorFromPalette(palette, index >> PaletteLutShift << PaletteLutShift);
+    }
+  }
+  printf("  table against ColorFromPalette, 7 palettes x 256 indexes x every brightness: %lu differ\n", differ);
+  return differ ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+//// bench_particles.cpp
+// Frame cost of the particle pool (totem/Particles.h) against particles alive
+//
+// Times erase(), update() and render() over a frame with n particles alive
+// (drifting around the globe, none dying, so n holds), for n from none to
+// the most a pool can have, and fits ns per frame = fixed + perParticle * n.
+// The fade over the whole buffer the old Confetti did every frame is timed
+// alongside, for where the two cross.
+// Then the safe maximum per board: what fits in a 60 FPS frame after the
+// WS2812 wire time (30 us per LED) and the rest of the render (as
+// output_timing: 6 us per LED on the AVR), at an estimated cost per
+// particle, and what the pool takes of SRAM.
+//
+//   bench_particles [--frames N] [--mcu-us-per-particle 28] [--leds 64,240,960]
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "Particles.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static CRGB leds[NUM_LEDS];
+static ParticlePool<255> pool;
+
+static inline double nowNs()
+{
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ns per frame with n particles alive
+static double benchPool(uint8_t n, unsigned long frames)
+{
+  memset(&pool, 0, sizeof(pool));
+  pool.erase(leds);
+  for (uint8_t i = 0; i < n; i++) {
+    pool.spawn(random16(pool.width), random8(NUM_ROWS - 1) * 256 + random8(), random8(65) - 32, 0, random8(), 0);
+  }
+  double t0 = nowNs();
+  for (unsigned long f = 0; f < frames; f++) {
+    pool.erase(leds);
+    pool.update();
+    pool.render(leds);
+  }
+  return (nowNs() - t0) / frames;
+}
+
+// ns per frame of the old Confetti: a fade of every pixel and one speckle
+static double benchFade(unsigned long frames)
+{
+  double t0 = nowNs();
+  for (unsigned long f = 0; f < frames; f++) {
+    fadeToBlackBy(leds, NUM_LEDS, 10);
+    leds[random16(NUM_LEDS)] += CHSV(random8(), 200, 255);
+  }
+  return (nowNs() - t0) / frames;
+}
+
+static std::vector<int> parseList(const char *s)
+{
+  std::vector<int> v;
+  for (char *end; *s; s = *end ? end + 1 : end) v.push_back(strtol(s, &end, 10));
+  return v;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long frames = 20000;
+  double mcuUsPerParticle = 28;   // AVR estimate: ~450 cycles at 16 MHz (HSV to RGB, four scaled adds, four erased pixels)
+  std::vector<int> ledCounts = {64, 240, 960};
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc) frames = strtoul(argv[++i], 0, 10);
+    else if (!strcmp(argv[i], "--mcu-us-per-particle") && i + 1 < argc) mcuUsPerParticle = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--leds") && i + 1 < argc) ledCounts = parseList(argv[++i]);
+    else { fprintf(stderr, "usage: bench_particles [--frames N] [--mcu-us-per-particle US] [--leds 64,240,...]\n"); return 2; }
+  }
+
+  const uint8_t counts[] = {0, 1, 2, 4, 8, 16, 32, 64, 128, 255};
+  double fade = benchFade(frames);
+  printf("\nParticle pool on %dx%d (%d LEDs), %lu frames each, host CPU\n", NUM_COLS, NUM_ROWS, NUM_LEDS, frames);
+  printf("%10s %12s %14s\n", "particles", "ns/frame", "ns/particle");
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (uint8_t n : counts) {
+    double ns = benchPool(n, frames);
+    printf("%10u %12.0f %14.1f\n", n, ns, n ? ns / n : 0.0);
+    sx += n; sy += ns; sxx += (double)n * n; sxy += n * ns;
+  }
+  double k = sizeof(counts);
+  double perParticle = (k * sxy - sx * sy) / (k * sxx - sx * sx);
+  double fixed = (sy - perParticle * sx) / k;
+  printf("fit: %.0f ns + %.1f ns a particle; the whole-buffer fade it replaces: %.0f ns a frame (%.1f particles' worth)\n",
+         fixed, perParticle, fade, perParticle > 0 ? max(0.0, (fade - fixed) / perParticle) : 0.0);
+
+  printf("\nSafe maximum at 60 FPS, %.0f us a particle (MCU estimate), WS2812 30 us and render 6 us per LED\n", mcuUsPerParticle);
+  printf("%6s %12s %12s\n", "LEDs", "spare us", "particles");
+  for (int n : ledCounts) {
+    double spare = 1e6 / 60 - n * 30.0 - 50 - n * 6.0;
+    printf("%6d %12.0f %12.0f\n", n, spare, spare > 0 ? spare / mcuUsPerParticle : 0.0);
+  }
+  printf("SRAM: %u bytes a particle, the pattern state kept three times over: MAX_PARTICLES %d is %u bytes\n",
+         ParticlePool<1>::bytesEach, MAX_PARTICLES, 3 * (2 + MAX_PARTICLES * ParticlePool<1>::bytesEach));
+  return 0;
+}
@@ -0,0 +1,162 @@
+//// bench_patterns.cpp
+// Per-pattern frame cost of Control::handleControl() on the host
+//
+// Steps the sketch on the virtual clock one 1 ms loop iteration at a time,
+// exactly like loop() on the pole, and times every iteration with the host's
+// steady clock. Iterations that rendered a frame are frames; the rest are
+// idle loop passes. "shown" is the share of frames that went out to the
+// LEDs rather than being skipped as unchanged. Heap allocations are counted
+// through operator new. mA is the power governor's estimate of the draw.
+//
+//   bench_patterns_8x8 [frames] [--csv]
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "Control.h"
+#include "UI.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+/******************************/
+/*    ALLOCATION COUNTING     */
+/******************************/
+static unsigned long allocCount = 0;
+
+void *operator new(std::size_t n)
+{
+  allocCount++;
+  if (void *p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void *operator new[](std::size_t n) { return operator new(n); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+/******************************/
+/*          BENCH             */
+/******************************/
+CRGB leds[NUM_LEDS];
+Control control(leds, NUM_LEDS);
+UI ui(&control);
+
+struct PatternStats
+{
+  const char *name;
+  unsigned long frames;
+  double meanNs;
+  double p99Ns;
+  double worstNs;
+  double idleNs;
+  double allocsPerFrame;
+  double shownPct;
+  double meanmA;      // estimated LED draw at the default brightness
+  uint16_t peakmA;
+};
+
+static inline double nowNs()
+{
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static PatternStats benchPattern(uint8_t p, unsigned long frames)
+{
+  control.set_pattern(p);
+
+  std::vector<double> frameNs;
+  frameNs.reserve(frames);
+  double idleTotal = 0;
+  unsigned long idleCount = 0;
+  double mASum = 0;
+  uint16_t peakmA = 0;
+
+  // one second of warm-up so fades and beat state settle
+  for (int i = 0; i < 1000; i++) {
+    host::advanceMillis(1);
+    control.handleControl();
+    ui.handleUI();
+  }
+
+  unsigned long allocsBefore = allocCount;
+  unsigned long showsBefore = FastLED.hostShowCount();
+  while (frameNs.size() < frames) {
+    host::advanceMillis(1);
+    unsigned long rendered = control.getFrameStats().frames;
+    double t0 = nowNs();
+    control.handleControl();
+    ui.handleUI();
+    double dt = nowNs() - t0;
+    if (control.getFrameStats().frames != rendered) {
+      frameNs.push_back(dt);
+      uint16_t mA = control.getPowerStats().mA;
+      mASum += mA;
+      if (mA > peakmA) peakmA = mA;
+    } else {
+      idleTotal += dt;
+      idleCount++;
+    }
+  }
+  unsigned long allocs = allocCount - allocsBefore;
+
+  PatternStats s;
+  s.name = Control::getPatternName(p);
+  s.frames = frameNs.size();
+  double sum = 0;
+  for (double d : frameNs) sum += d;
+  s.meanNs = sum / frameNs.size();
+  std::sort(frameNs.begin(), frameNs.end());
+  s.p99Ns = frameNs[(frameNs.size() * 99) / 100];
+  s.worstNs = frameNs.back();
+  s.idleNs = idleCount ? idleTotal / idleCount : 0;
+  s.allocsPerFrame = (double)allocs / frameNs.size();
+  s.shownPct = 100.0 * (FastLED.hostShowCount() - showsBefore) / frameNs.size();
+  s.meanmA = mASum / frameNs.size();
+  s.peakmA = peakmA;
+  return s;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long frames = 3000;
+  bool csv = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--csv")) csv = true;
+    else frames = strtoul(argv[i], 0, 10);
+  }
+  if (frames == 0) frames = 1;
+
+  control.setupControl();
+  ui.setupUI();
+
+  std::vector<PatternStats> results;
+  for (uint8_t p = 0; p < Control::getNumPatterns(); p++) {
+    results.push_back(benchPattern(p, frames));
+  }
+
+  if (csv) {
+    printf("cols,rows,leds,pattern,frames,mean_ns,p99_ns,worst_ns,idle_ns,allocs_per_frame,shown_pct,mean_mA,peak_mA\n");
+    for (const PatternStats &s : results) {
+      printf("%d,%d,%d,%s,%lu,%.0f,%.0f,%.0f,%.0f,%.3f,%.1f,%.0f,%u\n", NUM_COLS, NUM_ROWS, NUM_LEDS, s.name,
+             s.frames, s.meanNs, s.p99Ns, s.worstNs, s.idleNs, s.allocsPerFrame, s.shownPct, s.meanmA, s.peakmA);
+    }
+    return 0;
+  }
+
+  printf("\nMatrix %dx%d (%d LEDs), %lu frames per pattern, modelled WS2812 show: %lu us\n",
+         NUM_COLS, NUM_ROWS, NUM_LEDS, frames, (unsigned long)FastLED.hostWireMicros());
+  printf("%-16s %12s %12s %12s %12s %10s %8s %8s %8s\n", "pattern", "ns/frame", "p99 ns", "worst ns", "idle ns", "allocs/fr", "shown",
+         "mA", "peak mA");
+  for (const PatternStats &s : results) {
+    printf("%-16s %12.0f %12.0f %12.0f %12.0f %10.3f %7.1f%% %8.0f %8u\n", s.name, s.meanNs, s.p99Ns, s.worstNs, s.idleNs,
+           s.allocsPerFrame, s.shownPct, s.meanmA, s.peakmA);
+  }
+  return 0;
+}
@@ -0,0 +1,101 @@
+//// bench_scaling.cpp
+// How pattern cost grows with the number of LEDs
+//
+// Runs bench_patterns for each matrix size it was built for (the paths are
+// passed in by CMake), and fits ns per frame = fixed + perLed * LEDs to each
+// pattern by least squares. A pattern that scales linearly has a steady
+// ns/LED across the sizes and r2 close to 1; one with overhead per pixel
+// that grows with the matrix (index maths, wider types, lookups that fall
+// out of cache) shows ns/LED climbing with size.
+//
+//   bench_scaling [--frames N] bench_patterns_8x8 bench_patterns_60x16 ...
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+struct Sample
+{
+  int leds;
+  double meanNs;
+};
+
+// pattern name -> one sample per matrix size, in the order the sizes were given
+typedef std::map<std::string, std::vector<Sample> > Results;
+
+static bool runBench(const char *exe, unsigned long frames, Results &results, std::vector<int> &sizes)
+{
+  std::string cmd = std::string("\"") + exe + "\" --csv " + std::to_string(frames);
+  FILE *p = popen(cmd.c_str(), "r");
+  if (!p) return false;
+  char line[512];
+  bool header = true;
+  int leds = 0;
+  while (fgets(line, sizeof(line), p)) {
+    if (header) { header = false; continue; }
+    // cols,rows,leds,pattern,frames,mean_ns,...
+    int cols, rows;
+    char name[64];
+    unsigned long n;
+    double meanNs;
+    if (sscanf(line, "%d,%d,%d,%63[^,],%lu,%lf", &cols, &rows, &leds, name, &n, &meanNs) != 6) continue;
+    results[name].push_back({leds, meanNs});
+  }
+  if (pclose(p) != 0 || leds == 0) return false;
+  sizes.push_back(leds);
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long frames = 1000;
+  std::vector<const char *> benches;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc) frames = strtoul(argv[++i], 0, 10);
+    else benches.push_back(argv[i]);
+  }
+  if (benches.size() < 2) {
+    fprintf(stderr, "usage: bench_scaling [--frames N] <bench_patterns> <bench_patterns> ...\n");
+    return 2;
+  }
+
+  Results results;
+  std::vector<int> sizes;
+  for (const char *exe : benches) {
+    if (!runBench(exe, frames, results, sizes)) {
+      fprintf(stderr, "bench_scaling: %s failed\n", exe);
+      return 1;
+    }
+  }
+
+  printf("\nns per LED by matrix size (%lu frames each), and fit of ns/frame = fixed + perLed * LEDs\n", frames);
+  printf("%-16s", "pattern");
+  for (int leds : sizes) printf(" %7d", leds);
+  printf(" %10s %8s %8s\n", "fixed ns", "ns/LED", "r2");
+  for (const auto &r : results) {
+    const std::vector<Sample> &s = r.second;
+    double n = s.size(), sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (const Sample &v : s) {
+      sx += v.leds;
+      sy += v.meanNs;
+      sxx += (double)v.leds * v.leds;
+      sxy += v.leds * v.meanNs;
+    }
+    double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+    double fixed = (sy - slope * sx) / n;
+    double ssRes = 0, ssTot = 0;
+    for (const Sample &v : s) {
+      double e = v.meanNs - (fixed + slope * v.leds);
+      ssRes += e * e;
+      ssTot += (v.meanNs - sy / n) * (v.meanNs - sy / n);
+    }
+    printf("%-16s", r.first.c_str());
+    for (const Sample &v : s) printf(" %7.2f", v.meanNs / v.leds);
+    printf(" %10.0f %8.2f %8.4f\n", fixed, slope, ssTot > 0 ? 1 - ssRes / ssTot : 1.0);
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+//// bench_transitions.cpp
+// Frame cost while a transition is running, per transition type
+//
+// For every ordered pair of patterns, switches from one to the other with
+// a transition long enough to cover the whole measurement, so every timed
+// frame draws both patterns and blends them. "Cut" is the same switch with
+// no transition, i.e. one pattern per frame, for comparison.
+//
+//   bench_transitions_8x8 [frames per pair]
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "Control.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+CRGB leds[NUM_LEDS];
+Control control(leds, NUM_LEDS);
+
+static const char *transitionNames[numTransitionTypes] = { "Cut", "Linear fade", "Wipe rows", "Wipe columns" };
+
+static inline double nowNs()
+{
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Runs loop passes until 'frames' frames have rendered, returns total ns spent in frames
+static double runFrames(unsigned long frames, double &worst)
+{
+  double total = 0;
+  unsigned long done = 0;
+  while (done < frames) {
+    host::advanceMillis(1);
+    unsigned long rendered = control.getFrameStats().frames;
+    double t0 = nowNs();
+    control.handleControl();
+    double dt = nowNs() - t0;
+    if (control.getFrameStats().frames != rendered) {
+      total += dt;
+      if (dt > worst) worst = dt;
+      done++;
+    }
+  }
+  return total;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long frames = argc > 1 ? strtoul(argv[1], 0, 10) : 300;
+  if (frames == 0) frames = 1;
+  const uint8_t n = Control::getNumPatterns();
+
+  control.setupControl();
+
+  printf("\nMatrix %dx%d (%d LEDs), %lu frames per pattern pair, %d pairs\n", NUM_COLS, NUM_ROWS, NUM_LEDS, frames, n * (n - 1));
+  printf("%-14s %12s %12s %14s   %s\n", "transition", "ns/frame", "worst ns", "vs cut", "heaviest pair");
+
+  double cutMean = 0;
+  for (uint8_t t = 0; t < numTransitionTypes; t++) {
+    double total = 0, worst = 0, heaviest = 0;
+    uint8_t heavyFrom = 0, heavyTo = 0;
+    for (uint8_t from = 0; from < n; from++) {
+      for (uint8_t to = 0; to < n; to++) {
+        if (from == to) continue;
+        control.setTransition(CutTransition, 1);
+        control.set_pattern(from);
+        double warmWorst = 0;
+        runFrames(30, warmWorst);
+
+        control.setTransition((TransitionType)t, 60000);
+        control.set_pattern(to);
+        double pairWorst = 0;
+        double pairTotal = runFrames(frames, pairWorst);
+        total += pairTotal;
+        if (pairWorst > worst) worst = pairWorst;
+        if (pairTotal > heaviest) { heaviest = pairTotal; heavyFrom = from; heavyTo = to; }
+      }
+    }
+    double mean = total / (frames * n * (n - 1));
+    if (t == CutTransition) cutMean = mean;
+    printf("%-14s %12.0f %12.0f %+13.0f%%   %s -> %s (%.0f ns/frame)\n", transitionNames[t], mean, worst,
+           cutMean ? 100.0 * (mean - cutMean) / cutMean : 0.0,
+           Control::getPatternName(heavyFrom), Control::getPatternName(heavyTo), heaviest / frames);
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+//// output_timing.cpp
+// Achievable frame rate by LED count and number of output strips (shards)
+//
+// The model: a frame costs render time (per LED) plus WS2812 wire time,
+// 30 us per LED and a 50 us latch per strip. Strips sent one after another
+// (the AVR, interleaved) add up, but strips whose columns didn't change are
+// left out; strips sent in parallel take as long as the longest one. The
+// longest time interrupts are held off (one strip) is shown too: past the
+// mic ring's 26 ms, samples are lost and only held (see AudioBeat).
+//
+// Then the sketch itself, built for one size and shard count, runs on the
+// virtual clock with show() blocking for the wire time, and its frame rate
+// is checked against the model (render time is free on the virtual clock),
+// or against the rate the RateGovernor settled on, if that's lower: it
+// leaves a quarter of each frame spare, so a wire-bound pole runs under
+// the model.
+//
+//   output_timing [--leds 64,240,960,...] [--shards 1,2,4,8] [--render-us-per-led 6]
+//                 [--changed 100] [--seconds 10] [--check]
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "Control.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+CRGB leds[NUM_LEDS];
+Control control(leds, NUM_LEDS);
+
+static const double targetFps = 60;
+
+struct Model
+{
+  double interleavedFps;
+  double parallelFps;
+  uint32_t stripUs;       // one strip's wire time: the longest interrupts are off
+};
+
+static uint32_t stripUs(int ledsPerStrip) { return ledsPerStrip * 30UL + 50; }
+
+// changed: share of strips that changed this frame, 0..1
+static Model model(int leds, int shards, double renderUsPerLed, double changed)
+{
+  Model m;
+  int perStrip = (leds + shards - 1) / shards;
+  int sent = (int)std::ceil(shards * changed);
+  m.stripUs = stripUs(perStrip);
+  double render = renderUsPerLed * leds;
+  m.interleavedFps = std::fmin(targetFps, 1e6 / (render + (double)sent * m.stripUs));
+  m.parallelFps = std::fmin(targetFps, 1e6 / (render + (sent ? m.stripUs : 0)));
+  return m;
+}
+
+static std::vector<int> parseList(const char *s)
+{
+  std::vector<int> v;
+  for (char *end; *s; s = *end ? end + 1 : end) {
+    v.push_back(strtol(s, &end, 10));
+  }
+  return v;
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<int> ledCounts = {64, 128, 240, 480, 960, 1280, 2048};
+  std::vector<int> shardCounts = {1, 2, 4, 8};
+  double renderUsPerLed = 6;    // AVR estimate: pattern, copy/compare and power load, ~100 cycles at 16 MHz
+  double changed = 1.0;
+  unsigned long seconds = 10;
+  bool check = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--leds") && i + 1 < argc) ledCounts = parseList(argv[++i]);
+    else if (!strcmp(argv[i], "--shards") && i + 1 < argc) shardCounts = parseList(argv[++i]);
+    else if (!strcmp(argv[i], "--render-us-per-led") && i + 1 < argc) renderUsPerLed = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--changed") && i + 1 < argc) changed = atof(argv[++i]) / 100;
+    else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = strtoul(argv[++i], 0, 10);
+    else if (!strcmp(argv[i], "--check")) check = true;
+    else { fprintf(stderr, "output_timing: unknown option %s\n", argv[i]); return 2; }
+  }
+
+  printf("\nModelled FPS (capped at %.0f), render %.1f us/LED, %.0f%% of strips changed each frame\n",
+         targetFps, renderUsPerLed, changed * 100);
+  printf("%6s %6s %12s %10s %12s\n", "LEDs", "strips", "interleaved", "parallel", "irq off us");
+  for (int leds : ledCounts) {
+    for (int shards : shardCounts) {
+      Model m = model(leds, shards, renderUsPerLed, changed);
+      printf("%6d %6d %12.1f %10.1f %11lu%s\n", leds, shards, m.interleavedFps, m.parallelFps,
+             (unsigned long)m.stripUs, m.stripUs > 64UL * AudioBeat::samplePeriodUs ? " *" : "");
+    }
+  }
+  printf("(* interrupts off longer than the mic ring holds)\n");
+
+  // the sketch as built: every pixel changes every frame in Rainbow, so every strip goes out
+  control.setupControl();
+  FastLED.hostSetShowAdvancesClock(true);
+  for (uint8_t p = 0; p < Control::getNumPatterns(); p++) {
+    if (!strcmp(Control::getPatternName(p), "Rainbow")) control.set_pattern(p);
+  }
+  control.setTransition(CutTransition, 0);
+  for (int i = 0; i < 1000; i++) { host::advanceMicros(100); control.handleControl(); }  // settle
+
+  unsigned long frames0 = control.getFrameStats().frames;
+  unsigned long strips0 = FastLED.hostStripShowCount() + FastLED.hostShowCount() * FastLED.count();
+  uint64_t wire0 = FastLED.hostWireTotalMicros();
+  unsigned long end = micros() + seconds * 1000000UL;
+  while ((long)(micros() - end) < 0) {
+    host::advanceMicros(100);
+    control.handleControl();
+  }
+  double fps = (control.getFrameStats().frames - frames0) / (double)seconds;
+  unsigned long strips = FastLED.hostStripShowCount() + FastLED.hostShowCount() * FastLED.count() - strips0;
+  double wirePerFrame = (FastLED.hostWireTotalMicros() - wire0) / (fps * seconds);
+
+#if defined(SHARDS_PARALLEL)
+  double expected = model(NUM_LEDS, NUM_SHARDS, 0, 1.0).parallelFps;
+#else
+  double expected = model(NUM_LEDS, NUM_SHARDS, 0, 1.0).interleavedFps;
+#endif
+  double governed = 1000000.0 / control.getFramePeriod();
+  if (governed < expected) expected = governed;
+  printf("\nSketch %dx%d (%d LEDs) on %d strips: %.1f FPS on the virtual clock (model %.1f), "
+         "%.0f us on the wire per frame, %.2f strips per frame, %lu strips skipped\n",
+         NUM_COLS, NUM_ROWS, NUM_LEDS, NUM_SHARDS, fps, expected, wirePerFrame, strips / (fps * seconds),
+         control.getShowStats().stripsSkipped);
+
+  if (check && std::fabs(fps - expected) > expected * 0.05) {
+    fprintf(stderr, "output_timing: %.1f FPS, model says %.1f\n", fps, expected);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,141 @@
+//// CaptureDecoder.h
+// Decodes the frame capture stream (see totem/FrameCapture.h) on the host
+//
+// Bytes can come in any size of chunk, straight off the serial port: a
+// record is only taken once its sync byte, length and CRC all check out, so
+// anything else on the line (text from the sketch, a torn record from
+// joining mid-stream) is skipped over and counted. Log records (Log.h),
+// which share the port a whole record at a time, are skipped and counted
+// apart. Deltas before the first keyframe have nothing to apply to and are
+// dropped.
+#ifndef CAPTURE_DECODER_H
+#define CAPTURE_DECODER_H
+
+#include "Log.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct CapturedFrame
+{
+  bool key;
+  uint8_t cols, rows;
+  uint8_t flags;            // bit 0 new beat, bit 1 new bar
+  uint8_t skipped;          // frames the sketch skipped before this one
+  uint32_t ms;
+  uint16_t beats;
+  uint8_t phase;            // high byte of the beat phase
+  uint8_t brightness;
+  std::vector<uint8_t> rgb; // cols * rows * 3, in LED order
+  size_t recordBytes;       // size of the record on the wire
+};
+
+struct DecoderStats
+{
+  unsigned long frames = 0;
+  unsigned long keyframes = 0;
+  unsigned long crcErrors = 0;
+  unsigned long junkBytes = 0;      // not part of any record
+  unsigned long logBytes = 0;       // log records in between
+  unsigned long orphanDeltas = 0;   // deltas before the first keyframe
+};
+
+class CaptureDecoder
+{
+  public:
+    static const uint8_t sync = 0xA5;
+
+    // Calls handler(const CapturedFrame &) for each frame decoded
+    template<class Handler>
+    void feed(const uint8_t *data, size_t n, Handler handler)
+    {
+      pending_m.insert(pending_m.end(), data, data + n);
+      size_t at = 0;
+      while (pending_m.size() - at >= 5) {
+        const uint8_t *r = &pending_m[at];
+        if (r[0] == Logger::sync) {
+          size_t size = Logger::headerSize + r[2] + 1;
+          if (pending_m.size() - at < size) break;
+          uint8_t sum = 0;
+          for (size_t i = 1; i < size - 1; i++) sum += r[i];
+          if (sum == r[size - 1]) { at += size; stats_m.logBytes += size; continue; }
+        }
+        uint8_t type = r[1];
+        size_t length = r[2] | (r[3] << 8);
+        if (r[0] != sync || (type != 'K' && type != 'D') || length > maxPayload) { at++; stats_m.junkBytes++; continue; }
+        if (pending_m.size() - at < length + 5) break;            // the rest of it hasn't arrived
+        if (recordCrc(r, length) != r[4 + length]) { at++; stats_m.crcErrors++; stats_m.junkBytes++; continue; }
+        if (decode(type == 'K', r + 4, length)) {
+          frame_m.recordBytes = length + 5;
+          handler(frame_m);
+        }
+        at += length + 5;
+      }
+      pending_m.erase(pending_m.begin(), pending_m.begin() + at);
+    }
+
+    const DecoderStats &stats() const { return stats_m; }
+
+    // The CRC a record with this payload length ends with: of the type and payload
+    static uint8_t recordCrc(const uint8_t *r, size_t length) { return crc8(r + 4, length, crc8(r + 1, 1, 0)); }
+
+  private:
+    static const size_t maxPayload = 255 * 255 * 3 * 129 / 128 + 16;
+
+    static uint8_t crc8(const uint8_t *p, size_t n, uint8_t c)
+    {
+      for (size_t i = 0; i < n; i++) {
+        c ^= p[i];
+        for (int k = 0; k < 8; k++) c = c & 0x80 ? (c << 1) ^ 0x07 : c << 1;
+      }
+      return c;
+    }
+
+    bool decode(bool key, const uint8_t *p, size_t length)
+    {
+      const uint8_t *end = p + length;
+      if (key) {
+        if (length < 2) return false;
+        frame_m.cols = p[0];
+        frame_m.rows = p[1];
+        p += 2;
+        frame_m.rgb.assign(frame_m.cols * frame_m.rows * 3, 0);
+        haveKey_m = true;
+      } else if (!haveKey_m) {
+        stats_m.orphanDeltas++;
+        return false;
+      }
+      if (end - p < 10) return false;
+      frame_m.key = key;
+      frame_m.flags = p[0];
+      frame_m.skipped = p[1];
+      frame_m.ms = p[2] | (p[3] << 8) | (p[4] << 16) | ((uint32_t)p[5] << 24);
+      frame_m.beats = p[6] | (p[7] << 8);
+      frame_m.phase = p[8];
+      frame_m.brightness = p[9];
+      p += 10;
+
+      // RLE of the frame XOR the last one (a keyframe XOR black: the frame itself)
+      size_t i = 0, n = frame_m.rgb.size();
+      while (p < end && i < n) {
+        uint8_t c = *p++;
+        if (c & 0x80) {
+          i += (c & 0x7F) + 1;
+        } else {
+          for (int k = 0; k <= c && p < end && i < n; k++) frame_m.rgb[i++] ^= *p++;
+        }
+      }
+      if (i != n || p != end) { haveKey_m = false; return false; }   // the frame's lost: wait for a keyframe
+      stats_m.frames++;
+      if (key) stats_m.keyframes++;
+      return true;
+    }
+
+    std::vector<uint8_t> pending_m;
+    CapturedFrame frame_m;
+    bool haveKey_m = false;
+    DecoderStats stats_m;
+};
+
+#endif /* CAPTURE_DECODER_H */
@@ -0,0 +1,217 @@
+//// frame_capture.cpp
+// Records, decodes and replays the sketch's frame capture stream
+//
+//   frame_capture record [out.tcap] [--seconds N] [--pattern NAME] [--check]
+//     runs the sketch's loop() with capture on, on the virtual clock with
+//     Serial draining at 115200 baud, and checks every frame decoded from
+//     what it sent against the frame that went to the LEDs, and that the
+//     log sharing the port (kept busy with a profile report a second, the
+//     serial command 'p') never cut into a record
+//   frame_capture decode in.tcap
+//     one line per frame (works on a dump of the pole's serial port too)
+//   frame_capture replay in.tcap [--check]
+//     feeds the frames back through Control's output stage at their
+//     recorded times and checks what comes out against them
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include "totem.ino"
+#include "capture/CaptureDecoder.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct ShownFrame
+{
+  std::vector<uint8_t> rgb;
+  uint8_t brightness;
+};
+static std::vector<ShownFrame> shown;
+
+static void recordShow(const CLEDController *controllers, uint8_t count, uint8_t brightness)
+{
+  ShownFrame f;
+  for (uint8_t i = 0; i < count; i++) {
+    const uint8_t *p = controllers[i].leds_m[0].raw;
+    f.rgb.insert(f.rgb.end(), p, p + controllers[i].nLeds_m * 3);
+  }
+  f.brightness = brightness;
+  shown.push_back(f);
+}
+
+static bool readFile(const char *path, std::string &data)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f) { fprintf(stderr, "frame_capture: can't read %s\n", path); return false; }
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.append(buf, n);
+  fclose(f);
+  return true;
+}
+
+static std::vector<CapturedFrame> decodeAll(const std::string &data, DecoderStats &stats)
+{
+  CaptureDecoder decoder;
+  std::vector<CapturedFrame> frames;
+  decoder.feed((const uint8_t *)data.data(), data.size(), [&](const CapturedFrame &f) { frames.push_back(f); });
+  stats = decoder.stats();
+  return frames;
+}
+
+// Matches decoded frames to the frames shown; the skipped counts say which is which
+static unsigned long compare(const std::vector<CapturedFrame> &frames)
+{
+  unsigned long mismatches = 0;
+  size_t at = 0;
+  for (size_t i = 0; i < frames.size(); i++, at++) {
+    at += frames[i].skipped;
+    if (at >= shown.size() || shown[at].rgb != frames[i].rgb || shown[at].brightness != frames[i].brightness) {
+      if (mismatches++ < 5) fprintf(stderr, "frame_capture: frame %zu (at %u ms) doesn't match frame %zu shown\n", i, frames[i].ms, at);
+    }
+  }
+  return mismatches;
+}
+
+static int record(const char *out, unsigned long seconds, const char *pattern, bool check)
+{
+  for (uint8_t pin = 2; pin <= 5; pin++) host::setPin(pin, HIGH);   // no buttons held
+  Serial.hostPaceTx(true);
+  Serial.hostRecord(true);
+  setup();
+  FastLED.hostSetShowAdvancesClock(true);
+  FastLED.hostSetShowHook(recordShow);
+
+  uint8_t n = Control.getNumPatterns();
+  if (pattern) {
+    for (uint8_t p = 0; p < n; p++) {
+      if (!strcmp(Control.getPatternName(p), pattern)) Control.set_pattern(p);
+    }
+  }
+  Control.setCapture(true);
+  unsigned long start = micros();
+  unsigned long end = start + seconds * 1000000UL;
+  unsigned long perPattern = seconds * 1000000UL / n;
+  uint8_t current = 0;
+  unsigned long lastReport = start;
+  while ((long)(micros() - end) < 0) {
+    // without --pattern, a turn for each (with the transitions between them)
+    if (!pattern && (micros() - start) / perPattern > current) Control.set_pattern(++current % n);
+    if (micros() - lastReport >= 1000000UL) { lastReport += 1000000UL; Serial.hostInput("p"); }
+    loop();
+    host::advanceMicros(100);
+  }
+  Control.setCapture(false);
+  for (int i = 0; i < 10000; i++) { host::advanceMicros(100); loop(); }  // drain the ring
+
+  const std::string &data = Serial.hostRecorded();
+  if (out) {
+    FILE *f = fopen(out, "wb");
+    if (!f) { fprintf(stderr, "frame_capture: can't write %s\n", out); return 1; }
+    fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+  }
+
+  DecoderStats ds;
+  std::vector<CapturedFrame> frames = decodeAll(data, ds);
+  unsigned long mismatches = compare(frames);
+  const CaptureStats &cs = Control.getCaptureStats();
+  double raw = (double)frames.size() * NUM_LEDS * 3;
+  size_t bytes = data.size() - ds.logBytes;     // the capture's own
+  double bytesPerSec = bytes / (double)seconds;
+  printf("\nCapture of %dx%d, %lu s: %zu frames shown, %lu captured (%lu keyframes), %lu skipped\n",
+         NUM_COLS, NUM_ROWS, seconds, shown.size(), cs.frames, cs.keyframes, cs.skipped);
+  printf("%zu bytes, %.0f bytes/s (budget %d), %.1f bytes a frame, %.2f of raw\n",
+         bytes, bytesPerSec, CAPTURE_BYTES_PER_SEC, bytes / (double)frames.size(), bytes / raw);
+  printf("decoded %lu frames, %lu CRC errors, %lu junk bytes; %lu don't match the LEDs; Serial stalls %lu\n",
+         ds.frames, ds.crcErrors, ds.junkBytes, mismatches, Serial.hostStalls());
+  printf("log on the same port: %lu bytes sent, %lu skipped whole by the decoder\n", Log.stats().bytes, ds.logBytes);
+
+  if (check && (mismatches || Serial.hostStalls() || ds.frames != cs.frames || ds.frames == 0 ||
+                ds.junkBytes || ds.crcErrors || ds.logBytes != Log.stats().bytes ||
+                bytesPerSec > CAPTURE_BYTES_PER_SEC * 1.02)) {
+    fprintf(stderr, "frame_capture: check failed\n");
+    return 1;
+  }
+  return 0;
+}
+
+static int decode(const char *in)
+{
+  std::string data;
+  if (!readFile(in, data)) return 1;
+  DecoderStats ds;
+  std::vector<CapturedFrame> frames = decodeAll(data, ds);
+  printf("%10s %4s %6s %6s %5s %6s %6s %8s\n", "ms", "type", "beats", "phase", "beat", "skip", "bright", "bytes");
+  for (const CapturedFrame &f : frames) {
+    printf("%10u %4s %6u %6u %5s %6u %6u %8zu\n", f.ms, f.key ? "K" : "D", f.beats, f.phase,
+           f.flags & 0x02 ? "bar" : (f.flags & 0x01 ? "beat" : ""), f.skipped, f.brightness, f.recordBytes);
+  }
+  printf("%lu frames (%lu keyframes), %lu CRC errors, %lu junk bytes, %lu bytes of log, %lu deltas before a keyframe\n",
+         ds.frames, ds.keyframes, ds.crcErrors, ds.junkBytes, ds.logBytes, ds.orphanDeltas);
+  return 0;
+}
+
+static int replay(const char *in, bool check)
+{
+  std::string data;
+  if (!readFile(in, data)) return 1;
+  DecoderStats ds;
+  std::vector<CapturedFrame> frames = decodeAll(data, ds);
+  if (frames.empty()) { fprintf(stderr, "frame_capture: no frames in %s\n", in); return 1; }
+  if (frames[0].cols != NUM_COLS || frames[0].rows != NUM_ROWS) {
+    fprintf(stderr, "frame_capture: %s is %ux%u, this build is %dx%d\n", in, frames[0].cols, frames[0].rows, NUM_COLS, NUM_ROWS);
+    return 1;
+  }
+
+  Control.setupControl();
+  FastLED.hostSetShowHook(recordShow);
+  host::setMicros(frames[0].ms * 1000UL);
+  for (const CapturedFrame &f : frames) {
+    if ((long)(f.ms * 1000UL - micros()) > 0) host::setMicros(f.ms * 1000UL);
+    Control.set_brightness(f.brightness);
+    Control.replayFrame((const CRGB *)f.rgb.data());
+  }
+  // every frame replayed is shown, so they pair up one to one. The power governor
+  // only eases brightness back up, so compare the pixels, not the brightness
+  unsigned long mismatches = 0;
+  size_t at = 0;
+  for (size_t i = 0; i < frames.size() && at < shown.size(); i++, at++) {
+    if (shown[at].rgb != frames[i].rgb) mismatches++;
+  }
+  const PowerStats &ps = Control.getPowerStats();
+  printf("Replayed %zu frames over %.1f s: %zu shown, %lu differ from the capture; power %u mA (peak %u)\n",
+         frames.size(), (frames.back().ms - frames[0].ms) / 1000.0, shown.size(), mismatches, ps.mA, ps.peakmA);
+  if (check && (mismatches || shown.size() != frames.size())) {
+    fprintf(stderr, "frame_capture: replay check failed\n");
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  const char *mode = argc > 1 ? argv[1] : "";
+  const char *file = 0;
+  const char *pattern = 0;
+  unsigned long seconds = 10;
+  bool check = false;
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = strtoul(argv[++i], 0, 10);
+    else if (!strcmp(argv[i], "--pattern") && i + 1 < argc) pattern = argv[++i];
+    else if (!strcmp(argv[i], "--check")) check = true;
+    else file = argv[i];
+  }
+  if (seconds == 0) seconds = 1;
+
+  if (!strcmp(mode, "record")) return record(file, seconds, pattern, check);
+  if (!strcmp(mode, "decode") && file) return decode(file);
+  if (!strcmp(mode, "replay") && file) return replay(file, check);
+  fprintf(stderr, "usage: frame_capture record [out.tcap] [--seconds N] [--pattern NAME] [--check]\n"
+                  "       frame_capture decode in.tcap\n"
+                  "       frame_capture replay in.tcap [--check]\n");
+  return 2;
+}
@@ -0,0 +1,311 @@
+//// golden_frames.cpp
+// Every pattern's frames, hashed, against the golden file: has a change altered the output?
+//
+// Each pattern runs in the whole sketch (setup() and loop() from totem.ino)
+// in a process of its own, forked before setup(), so no pattern sees
+// another's state. Everything it depends on is fixed:
+//  - the virtual clock, each loop() pass 100 us
+//  - random8/random16 and random() seeded the same (--seed)
+//  - a script on the buttons: the tempo tapped in on the fn button, then
+//    brightness stepped up and the hue speed changed through the toggle
+//    and inc buttons, the same for every pattern
+// and a hash (FNV-1a) of each frame shown, with its brightness, is taken
+// for --frames frames. Each pattern runs --runs times: the hashes must be
+// the same every time, and the pattern's cost is the host CPU time a
+// frame (each frame's fastest of the runs), over that of a fixed
+// calibration loop timed alongside, so it carries between machines better
+// than nanoseconds would.
+// --check compares with the golden file: any frame hash that differs is a
+// failure (the first few are listed), and so is a pattern costing more
+// than --max-slowdown times its golden cost. A pattern not in the file
+// is reported, and not a failure. --record writes the file.
+//
+//   golden_frames --check FILE | --record FILE [--frames 360] [--seed 1] [--runs 7] [--max-slowdown 2]
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "totem.ino"
+
+struct PatternRun
+{
+  std::string name;
+  std::vector<uint32_t> hashes;
+  double cost;      // calibration loops a frame
+};
+
+static inline double nowNs()
+{
+  using namespace std::chrono;
+  return (double)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t fnv(uint32_t h, const uint8_t *p, size_t n)
+{
+  for (size_t i = 0; i < n; i++) h = (h ^ p[i]) * 16777619u;
+  return h;
+}
+
+static uint32_t shownHash = 2166136261u;      // of the frame on the LEDs
+
+static void hashShow(const CLEDController *controllers, uint8_t count, uint8_t brightness)
+{
+  uint32_t h = fnv(2166136261u, &brightness, 1);
+  for (uint8_t i = 0; i < count; i++) h = fnv(h, controllers[i].leds_m[0].raw, controllers[i].nLeds_m * 3);
+  shownHash = h;
+}
+
+// Presses: the button's pin held low from ms for 60 ms
+struct Press
+{
+  unsigned long ms;
+  uint8_t pin;
+};
+static const Press script[] = {
+  {500, 5}, {950, 5}, {1400, 5}, {1850, 5},       // fn: the tempo tapped in, 450 ms (133 BPM)
+  {2600, 2}, {2900, 3}, {3200, 3},                // toggle to brightness, up twice
+  {3500, 2}, {3800, 3},                           // toggle to hue speed, up once
+  {4100, 2},                                      // toggle back to patterns
+};
+
+// ns of a fixed piece of work about a frame's size, the fastest of many goes
+static double calibrate()
+{
+  static CRGB buf[256];
+  double best = 1e18;
+  for (int go = 0; go < 2000; go++) {
+    double t0 = nowNs();
+    for (uint16_t i = 0; i < 256; i++) buf[i] = CHSV(i + go, 240, 200);
+    fadeToBlackBy(buf, 256, 20);
+    double ns = nowNs() - t0;
+    if (ns < best) best = ns;
+  }
+  return best;
+}
+
+// In the forked child: pattern p from power on, for frames frames
+static void runPattern(uint8_t p, unsigned long frames, uint16_t seed, std::vector<uint32_t> &hashes, std::vector<float> &ns)
+{
+  random16_set_seed(seed);
+  randomSeed(seed);
+  for (uint8_t pin = 2; pin <= 5; pin++) host::setPin(pin, HIGH);
+  FastLED.hostSetShowHook(hashShow);
+  setup();
+  Control.setTransition(CutTransition, 0);
+  Control.set_pattern(p);
+
+  unsigned long start = millis();
+  size_t next = 0;
+  bool held = false;
+  while (hashes.size() < frames) {
+    unsigned long ms = millis() - start;
+    if (next < sizeof(script) / sizeof(script[0])) {
+      if (!held && ms >= script[next].ms) { host::setPin(script[next].pin, LOW); held = true; }
+      else if (held && ms >= script[next].ms + 60) { host::setPin(script[next].pin, HIGH); held = false; next++; }
+    }
+    unsigned long rendered = Control.getFrameStats().frames;
+    double t0 = nowNs();
+    loop();
+    double t = nowNs() - t0;
+    if (Control.getFrameStats().frames != rendered) {
+      ns.push_back(t);
+      hashes.push_back(shownHash);
+    }
+    host::advanceMicros(100);
+  }
+}
+
+// Each pattern in a child of its own, forked from this process before setup().
+// Every run does the same work frame for frame, so a frame's time is the
+// fastest of the runs': what's left once interrupts and the rest of the
+// machine are taken out.
+static bool runAll(unsigned long frames, uint16_t seed, int runs, std::vector<PatternRun> &out)
+{
+  double calibration = calibrate();
+  for (uint8_t p = 0; p < Control::getNumPatterns(); p++) {
+    PatternRun r;
+    r.name = Control::getPatternName(p);
+    std::vector<float> fastest(frames, 1e30f);
+    for (int run = 0; run < runs; run++) {
+      int fds[2];
+      if (pipe(fds)) { perror("golden_frames: pipe"); return false; }
+      fflush(stdout);
+      pid_t pid = fork();
+      if (pid < 0) { perror("golden_frames: fork"); return false; }
+      if (pid == 0) {
+        close(fds[0]);
+        std::vector<uint32_t> hashes;
+        std::vector<float> ns;
+        runPattern(p, frames, seed, hashes, ns);
+        bool ok = write(fds[1], ns.data(), frames * 4) == (ssize_t)(frames * 4) &&
+                  write(fds[1], hashes.data(), frames * 4) == (ssize_t)(frames * 4);
+        _exit(ok ? 0 : 1);
+      }
+      close(fds[1]);
+      std::vector<float> ns(frames);
+      std::vector<uint32_t> hashes(frames);
+      size_t got = 0, want = frames * 8;
+      std::vector<uint8_t> buf(want);
+      for (ssize_t n; got < want && (n = read(fds[0], buf.data() + got, want - got)) > 0; got += n) {}
+      close(fds[0]);
+      int status;
+      waitpid(pid, &status, 0);
+      if (got != want || !WIFEXITED(status) || WEXITSTATUS(status)) {
+        fprintf(stderr, "golden_frames: %s didn't finish its run\n", r.name.c_str());
+        return false;
+      }
+      memcpy(ns.data(), buf.data(), frames * 4);
+      memcpy(hashes.data(), buf.data() + frames * 4, frames * 4);
+      if (run && hashes != r.hashes) {
+        fprintf(stderr, "golden_frames: %s gave different frames on run %d: not deterministic\n", r.name.c_str(), run + 1);
+        return false;
+      }
+      r.hashes = hashes;
+      for (unsigned long i = 0; i < frames; i++) fastest[i] = min(fastest[i], ns[i]);
+    }
+    double sum = 0;
+    for (float t : fastest) sum += t;
+    r.cost = sum / frames / calibration;
+    out.push_back(r);
+  }
+  return true;
+}
+
+/******************************/
+/*        GOLDEN FILE         */
+/******************************/
+// # comment lines
+// size 8x8 seed 1 frames 360
+// pattern <cost> <name>
+// <hash> <hash> ... (8 a line)
+static bool writeGolden(const char *path, unsigned long frames, uint16_t seed, const std::vector<PatternRun> &runs)
+{
+  FILE *f = fopen(path, "w");
+  if (!f) { fprintf(stderr, "golden_frames: can't write %s\n", path); return false; }
+  fprintf(f, "# golden_frames: a hash of every frame each pattern showed, written by golden_frames --record\n");
+  fprintf(f, "# cost: host CPU time a frame, in calibration loops\n");
+  fprintf(f, "size %dx%d seed %u frames %lu\n", NUM_COLS, NUM_ROWS, seed, frames);
+  for (const PatternRun &r : runs) {
+    fprintf(f, "pattern %.5f %s\n", r.cost, r.name.c_str());
+    for (size_t i = 0; i < r.hashes.size(); i++) fprintf(f, "%08x%c", r.hashes[i], i % 8 == 7 || i + 1 == r.hashes.size() ? '\n' : ' ');
+  }
+  fclose(f);
+  return true;
+}
+
+static bool readGolden(const char *path, unsigned long &frames, uint16_t &seed, std::map<std::string, PatternRun> &runs)
+{
+  FILE *f = fopen(path, "r");
+  if (!f) { fprintf(stderr, "golden_frames: can't read %s\n", path); return false; }
+  char line[512];
+  PatternRun *current = 0;
+  bool sized = false;
+  while (fgets(line, sizeof(line), f)) {
+    line[strcspn(line, "\r\n")] = 0;
+    unsigned cols, rows, s;
+    double cost;
+    int at;
+    if (line[0] == '#' || !line[0]) continue;
+    if (sscanf(line, "size %ux%u seed %u frames %lu", &cols, &rows, &s, &frames) == 4) {
+      if (cols != NUM_COLS || rows != NUM_ROWS) {
+        fprintf(stderr, "golden_frames: %s is %ux%u, this build is %dx%d\n", path, cols, rows, NUM_COLS, NUM_ROWS);
+        fclose(f);
+        return false;
+      }
+      seed = s;
+      sized = true;
+    } else if (sscanf(line, "pattern %lf %n", &cost, &at) == 1) {
+      current = &runs[line + at];
+      current->name = line + at;
+      current->cost = cost;
+    } else if (current) {
+      for (char *p = line, *end; *p; p = end) {
+        uint32_t h = strtoul(p, &end, 16);
+        if (end == p) break;
+        current->hashes.push_back(h);
+      }
+    }
+  }
+  fclose(f);
+  if (!sized) fprintf(stderr, "golden_frames: %s has no size line\n", path);
+  return sized;
+}
+
+int main(int argc, char **argv)
+{
+  const char *checkPath = 0, *recordPath = 0;
+  unsigned long frames = 360;     // 6 s: the script's done by 4.2 s
+  uint16_t seed = 1;
+  int runs = 7;
+  double maxSlowdown = 2.0;   // room for a busy machine; tighter on a quiet one
+  bool framesGiven = false, seedGiven = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--check") && i + 1 < argc) checkPath = argv[++i];
+    else if (!strcmp(argv[i], "--record") && i + 1 < argc) recordPath = argv[++i];
+    else if (!strcmp(argv[i], "--frames") && i + 1 < argc) { frames = strtoul(argv[++i], 0, 10); framesGiven = true; }
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) { seed = strtoul(argv[++i], 0, 10); seedGiven = true; }
+    else if (!strcmp(argv[i], "--runs") && i + 1 < argc) runs = max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "--max-slowdown") && i + 1 < argc) maxSlowdown = atof(argv[++i]);
+    else { checkPath = recordPath = 0; break; }
+  }
+  if (!checkPath == !recordPath || !frames) {
+    fprintf(stderr, "usage: golden_frames --check FILE | --record FILE [--frames N] [--seed S] [--runs N] [--max-slowdown X]\n");
+    return 2;
+  }
+
+  std::map<std::string, PatternRun> golden;
+  if (checkPath) {
+    unsigned long goldenFrames = frames;
+    uint16_t goldenSeed = seed;
+    if (!readGolden(checkPath, goldenFrames, goldenSeed, golden)) return 1;
+    if ((framesGiven && goldenFrames != frames) || (seedGiven && goldenSeed != seed)) {
+      fprintf(stderr, "golden_frames: %s is %lu frames with seed %u\n", checkPath, goldenFrames, goldenSeed);
+      return 1;
+    }
+    frames = goldenFrames;
+    seed = goldenSeed;
+  }
+
+  std::vector<PatternRun> results;
+  if (!runAll(frames, seed, runs, results)) return 1;
+
+  if (recordPath) {
+    if (!writeGolden(recordPath, frames, seed, results)) return 1;
+    printf("%zu patterns, %lu frames each, seed %u: written to %s\n", results.size(), frames, seed, recordPath);
+    return 0;
+  }
+
+  printf("%dx%d, %lu frames a pattern, seed %u, against %s\n", NUM_COLS, NUM_ROWS, frames, seed, checkPath);
+  printf("%-16s %10s %12s %12s %8s\n", "pattern", "frames", "cost", "golden", "ratio");
+  bool failed = false;
+  for (const PatternRun &r : results) {
+    auto g = golden.find(r.name);
+    if (g == golden.end()) {
+      printf("%-16s %10s %12.5f %12s %8s   new: not in the golden file\n", r.name.c_str(), "-", r.cost, "-", "-");
+      continue;
+    }
+    size_t differ = 0, first = 0;
+    size_t n = min(r.hashes.size(), g->second.hashes.size());
+    for (size_t i = n; i-- > 0;) {
+      if (r.hashes[i] != g->second.hashes[i]) { differ++; first = i; }
+    }
+    differ += max(r.hashes.size(), g->second.hashes.size()) - n;
+    double ratio = r.cost / g->second.cost;
+    bool slow = ratio > maxSlowdown;
+    printf("%-16s %10s %12.5f %12.5f %7.2fx", r.name.c_str(), differ ? "DIFFER" : "same", r.cost, g->second.cost, ratio);
+    if (differ) printf("   %zu of %lu differ, from frame %zu", differ, frames, first);
+    if (slow) printf("   slower than %.2fx", maxSlowdown);
+    printf("\n");
+    failed |= differ || slow;
+  }
+  printf(failed ? "FAILED\n" : "ok\n");
+  return failed ? 1 : 0;
+}
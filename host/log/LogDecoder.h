@@ -0,0 +1,147 @@
+//// LogDecoder.h
+// Turns the sketch's binary log records (see totem/Log.h) back into text
+//
+// The text of each event comes from the same LOG_EVENTS table the sketch is
+// built with, so the two can't drift apart. Like the frame capture decoder,
+// records are only taken when the sync byte, id, length and checksum all
+// agree, so anything else on the serial line is skipped and counted. Frame
+// capture records, which share the port a whole record at a time, are
+// skipped and counted apart.
+#ifndef LOG_DECODER_H
+#define LOG_DECODER_H
+
+#include "Log.h"
+#include "Profiler.h"
+#include "capture/CaptureDecoder.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct LogRecord
+{
+  LogEvent id;
+  uint16_t ms;                  // low 16 bits of millis()
+  std::vector<uint8_t> args;
+  std::string text;
+};
+
+struct LogDecoderStats
+{
+  unsigned long records = 0;
+  unsigned long badRecords = 0;     // checksum or argument size wrong
+  unsigned long junkBytes = 0;      // not part of any record
+  unsigned long captureBytes = 0;   // frame capture records in between
+  unsigned long dropped = 0;        // as reported by LogDropped records
+};
+
+class LogDecoder
+{
+  public:
+    static const uint8_t maxArgs = 48;
+
+    // names patterns for {pattern}; numbers by default
+    std::function<std::string(uint8_t)> patternName = [](uint8_t p) { return std::to_string(p); };
+
+    template<class Handler>
+    void feed(const uint8_t *data, size_t n, Handler handler)
+    {
+      pending_m.insert(pending_m.end(), data, data + n);
+      size_t at = 0;
+      while (pending_m.size() - at >= Logger::headerSize + 1) {
+        const uint8_t *r = &pending_m[at];
+        if (r[0] == CaptureDecoder::sync && (r[1] == 'K' || r[1] == 'D')) {
+          size_t length = r[2] | (r[3] << 8);
+          if (pending_m.size() - at < length + 5) break;
+          if (CaptureDecoder::recordCrc(r, length) == r[4 + length]) { at += length + 5; stats_m.captureBytes += length + 5; continue; }
+        }
+        uint8_t len = r[2];
+        if (r[0] != Logger::sync || r[1] >= numLogEvents || len > maxArgs) { at++; stats_m.junkBytes++; continue; }
+        size_t size = Logger::headerSize + len + 1;
+        if (pending_m.size() - at < size) break;
+        uint8_t sum = 0;
+        for (size_t i = 1; i < size - 1; i++) sum += r[i];
+        if (sum != r[size - 1]) { at++; stats_m.junkBytes++; continue; }
+
+        LogRecord rec;
+        rec.id = (LogEvent)r[1];
+        rec.ms = r[3] | (r[4] << 8);
+        rec.args.assign(r + Logger::headerSize, r + Logger::headerSize + len);
+        if (format(rec)) {
+          stats_m.records++;
+          if (rec.id == LogDropped && len == 2) stats_m.dropped += rec.args[0] | (rec.args[1] << 8);
+          handler(rec);
+        } else {
+          stats_m.badRecords++;
+        }
+        at += size;
+      }
+      pending_m.erase(pending_m.begin(), pending_m.begin() + at);
+    }
+
+    const LogDecoderStats &stats() const { return stats_m; }
+
+  private:
+    static const char *text(LogEvent id)
+    {
+#define LOG_EVENT_TEXT(id, text) text,
+      static const char *texts[] = { LOG_EVENTS(LOG_EVENT_TEXT) };
+#undef LOG_EVENT_TEXT
+      return texts[id];
+    }
+
+    // Fills rec.text from the event's text; false if the arguments don't fit it
+    bool format(LogRecord &rec) const
+    {
+      const char *t = text(rec.id);
+      size_t used = 0;
+      std::string out;
+      while (*t) {
+        if (*t != '{') { out += *t++; continue; }
+        const char *close = strchr(t, '}');
+        if (!close) return false;
+        std::string spec(t + 1, close);
+        t = close + 1;
+        std::string names;
+        size_t colon = spec.find(':');
+        if (colon != std::string::npos) { names = spec.substr(colon + 1); spec = spec.substr(0, colon); }
+
+        bool isSigned = spec[0] == 'i';
+        bool byName = spec == "pattern" || spec == "stage";
+        size_t bytes = byName ? 1 : (size_t)atoi(spec.c_str() + 1) / 8;
+        if (bytes == 0 || used + bytes > rec.args.size()) return false;
+        uint32_t v = 0;
+        for (size_t i = 0; i < bytes; i++) v |= (uint32_t)rec.args[used + i] << (8 * i);
+        used += bytes;
+
+        if (spec == "pattern") out += patternName(v);
+        else if (spec == "stage") out += Profiler::name(v);
+        else if (!names.empty()) out += choose(names, v);
+        else if (isSigned) {
+          int32_t s = bytes == 1 ? (int8_t)v : (bytes == 2 ? (int16_t)v : (int32_t)v);
+          out += std::to_string(s);
+        } else out += std::to_string(v);
+      }
+      rec.text = out;
+      return used == rec.args.size();
+    }
+
+    static std::string choose(const std::string &names, uint32_t v)
+    {
+      size_t start = 0;
+      for (uint32_t i = 0; i < v; i++) {
+        start = names.find(',', start);
+        if (start == std::string::npos) return std::to_string(v);
+        start++;
+      }
+      return names.substr(start, names.find(',', start) - start);
+    }
+
+    std::vector<uint8_t> pending_m;
+    LogDecoderStats stats_m;
+};
+
+#endif /* LOG_DECODER_H */
@@ -0,0 +1,123 @@
+//// log_decode.cpp
+// Prints the sketch's binary log (see totem/Log.h) as text
+//
+//   log_decode FILE        a dump of the serial port (- for stdin), e.g.
+//                          stty -F /dev/ttyACM0 raw && cat /dev/ttyACM0 | log_decode -
+//   log_decode --sim [--check]
+//                          runs the sketch on the virtual clock with Serial
+//                          draining at 115200 baud, works the buttons, then
+//                          floods the log to overflow it, then asks for a
+//                          profile. --check fails unless every record arrives
+//                          or is reported dropped, and nothing ever waited on
+//                          Serial.
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "totem.ino"
+#include "log/LogDecoder.h"
+
+static void print(const LogRecord &r) { printf("%7u ms  %s\n", r.ms, r.text.c_str()); }
+
+static LogDecoder decoder()
+{
+  LogDecoder d;
+  d.patternName = [](uint8_t p) { return std::string(Control::getPatternName(p)); };
+  return d;
+}
+
+static int decodeFile(const char *path)
+{
+  FILE *f = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+  if (!f) { fprintf(stderr, "log_decode: can't read %s\n", path); return 1; }
+  LogDecoder d = decoder();
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    d.feed(buf, n, print);
+    fflush(stdout);
+  }
+  if (f != stdin) fclose(f);
+  const LogDecoderStats &s = d.stats();
+  fprintf(stderr, "%lu records, %lu bad, %lu junk bytes, %lu bytes of frame capture, %lu dropped on the pole\n", s.records, s.badRecords,
+          s.junkBytes, s.captureBytes, s.dropped);
+  return 0;
+}
+
+// loop() for ms milliseconds, 100 us a pass
+static void run(unsigned long ms)
+{
+  for (unsigned long i = 0; i < ms * 10; i++) {
+    loop();
+    host::advanceMicros(100);
+  }
+}
+
+static void press(uint8_t pin, unsigned long holdMs)
+{
+  host::setPin(pin, LOW);
+  run(holdMs);
+  host::setPin(pin, HIGH);
+  run(200);
+}
+
+static int simulate(bool check)
+{
+  for (uint8_t pin = 2; pin <= 5; pin++) host::setPin(pin, HIGH);
+  Serial.hostPaceTx(true);
+  Serial.hostRecord(true);
+  setup();
+  run(500);
+
+  press(2, 100);                          // toggle: brightness
+  for (int i = 0; i < 3; i++) press(3, 100);
+  press(4, 1500);                         // dec, held: long press and repeats
+  press(2, 100);                          // speed
+  press(2, 100);                          // pattern
+  press(3, 100);
+  for (int i = 0; i < 6; i++) press(5, 400);   // tap at 100 BPM
+
+  // a burst no ring could take: the rest must be dropped and counted, not stall the loop
+  unsigned long burst = 100;
+  for (unsigned long i = 0; i < burst; i++) LOG(LogBrightness, (uint8_t)i);
+  run(2000);
+  Serial.hostInput("p");                  // profile report, more than the ring holds at once
+  run(500);
+
+  LogDecoder d = decoder();
+  std::vector<LogRecord> records;
+  const std::string &out = Serial.hostRecorded();
+  d.feed((const uint8_t *)out.data(), out.size(), [&](const LogRecord &r) { records.push_back(r); print(r); });
+
+  const LogStats &ls = Log.stats();
+  const LogDecoderStats &ds = d.stats();
+  unsigned long counts[numLogEvents] = {0};
+  for (const LogRecord &r : records) counts[r.id]++;
+  printf("\n%lu records logged, %lu dropped; %lu decoded (%lu bad, %lu junk bytes), %lu reported dropped; "
+         "%lu bytes sent, Serial stalls %lu\n", ls.records, ls.dropped, ds.records, ds.badRecords, ds.junkBytes,
+         ds.dropped, ls.bytes, Serial.hostStalls());
+
+  if (!check) return 0;
+  bool ok = ds.badRecords == 0 && Serial.hostStalls() == 0 && ls.dropped > 0 &&
+            ds.records == ls.records && ds.dropped == ls.dropped &&
+            counts[LogBoot] == 1 && counts[LogUIState] == 3 && counts[LogPattern] == 1 && counts[LogTap] == 6 &&
+            counts[LogButton] >= 2 * 12 && counts[LogProfile] == numProfileStages;
+  if (!ok) fprintf(stderr, "log_decode: check failed\n");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+  bool sim = false, check = false;
+  const char *file = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--sim")) sim = true;
+    else if (!strcmp(argv[i], "--check")) check = true;
+    else file = argv[i];
+  }
+  if (sim) return simulate(check);
+  if (file) return decodeFile(file);
+  fprintf(stderr, "usage: log_decode FILE|-\n       log_decode --sim [--check]\n");
+  return 2;
+}
@@ -0,0 +1,231 @@
+//// memory_report.cpp
+// Where the SRAM and flash go, by subsystem, and how many LEDs still fit
+//
+// The Pro Micro has 2560 bytes of SRAM for everything: the LED buffers,
+// every subsystem's state, the Arduino core and the stack. This adds up
+// what each subsystem of the sketch (totem.ino, built with the AVR's
+// Config.h defaults, TOTEM_AVR_MODEL) takes, from the sizes of its
+// objects, against that less a reserve for the core and the stack
+// (--reserve, by default 640 bytes). The sizes are the host's: pointers and longs are bigger
+// here than on the AVR, so it's an upper bound. It goes on to what a pixel
+// costs (the buffers and caches that grow with the LED count), how many
+// LEDs the SRAM left would take, and what a pattern's state may grow to
+// before it costs anything, then the tables kept in flash.
+// --check fails if the sketch doesn't fit: with --nm, as a check on a
+// real build; here, only that the upper bound doesn't.
+//
+// With --nm, the symbols of a real AVR build (avr-nm -C -S --size-sort of
+// the ELF) are grouped into the same subsystems instead: the exact
+// figures, SRAM from .data/.bss and flash from .text/.data. The core's
+// buffers are in the symbols then, so only the stack is kept back (by
+// default 320 bytes).
+//
+//   memory_report [--sram 2560] [--reserve BYTES] [--check]
+//   avr-nm -C -S --size-sort totem.ino.elf | memory_report --nm -
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "totem.ino"
+
+struct Item
+{
+  const char *subsystem;
+  const char *what;
+  unsigned long bytes;
+  unsigned long perLed;       // of bytes, what grows with each LED
+};
+
+static void printItems(const char *title, const std::vector<Item> &items, unsigned long &total, unsigned long &perLed)
+{
+  printf("\n%-14s %-40s %8s %8s\n", title, "", "bytes", "/LED");
+  total = perLed = 0;
+  for (const Item &i : items) {
+    printf("%-14s %-40s %8lu ", i.subsystem, i.what, i.bytes);
+    if (i.perLed) printf("%8.1f\n", (double)i.perLed / NUM_LEDS);
+    else printf("%8s\n", "");
+    total += i.bytes;
+    perLed += i.perLed;
+  }
+  printf("%-14s %-40s %8lu %8.1f\n", "", "total", total, (double)perLed / NUM_LEDS);
+}
+
+// Each pattern's state, against the biggest (which is what the slots hold)
+template<class T> struct PatternSizes;
+template<class... P>
+struct PatternSizes<PatternTable<P...> >
+{
+  static void print()
+  {
+    printf("\nPattern state, held 3 times over (showing, outgoing, staged): %u bytes a slot\n",
+           (unsigned)sizeof(typename PatternTable<P...>::State));
+    (printf("  %-16s %6u\n", P::name(), (unsigned)sizeof(P)), ...);
+  }
+};
+
+// The sketch's SRAM, from the sizes of its objects
+static std::vector<Item> sramItems()
+{
+  const unsigned long pixels = sizeof(CRGB) * NUM_LEDS;
+  const unsigned long slot = sizeof(PatternSlot<TotemPatterns>);
+  const unsigned long parts = sizeof(FrameBuffer<Geometry>) + sizeof(Transition<Geometry>) + 3 * slot + sizeof(AudioBeat)
+                            + sizeof(FrameScheduler) + sizeof(RateGovernor) + sizeof(PowerGovernor) + sizeof(BeatClock)
+                            + sizeof(PlaylistPlayer);
+  std::vector<Item> items = {
+    { "LEDs", "back buffer, the patterns draw here", sizeof(leds), sizeof(leds) },
+    { "Control", "front buffer and dirty columns", sizeof(FrameBuffer<Geometry>), pixels },
+    { "Control", "transition, the frame blended from", sizeof(Transition<Geometry>), pixels },
+    { "Control", "pattern state x3", 3 * slot, 0 },
+    { "Control", "audio beat detection", sizeof(AudioBeat), 0 },
+    { "Control", "scheduler, rate, power, beat, playlist", sizeof(FrameScheduler) + sizeof(RateGovernor) + sizeof(PowerGovernor)
+                                                              + sizeof(BeatClock) + sizeof(PlaylistPlayer), 0 },
+    { "Control", "the rest", sizeof(class Control) - parts, 0 },
+    { "UI", "buttons, their queue and state", sizeof(UI), 0 },
+    { "Settings", "EEPROM journal", sizeof(Settings), 0 },
+    { "Log", "event log ring", sizeof(Logger), 0 },
+    { "Noise", "field cache", sizeof(NoiseField), 2UL * 2 * NOISE_CACHED_OCTAVES * NUM_LEDS },
+    { "Palette", "expanded table", sizeof(PaletteTable), 0 },
+  };
+#ifdef PROFILING
+  items.push_back({ "Profiler", "stage timings", sizeof(Profiler), 0 });
+#endif
+  return items;
+}
+
+// The constant tables the sketch keeps in flash (PROGMEM)
+static std::vector<Item> flashItems()
+{
+  unsigned long names = 0;
+  for (uint8_t p = 0; p < Control::getNumPatterns(); p++) names += strlen(Control::getPatternName(p)) + 1;
+  unsigned long steps = 0;
+  for (uint8_t l = 0; l < Control::getNumPlaylists(); l++) steps += playlists[l].count * sizeof(PlaylistStep);
+  const unsigned long geometry = sizeof(Geometry::xy) + sizeof(Geometry::rowOfIndex) + sizeof(Geometry::colOfIndex)
+                               + sizeof(Geometry::diagonal);
+  return {
+    { "Geometry", "row/col <-> index tables, diagonals", geometry, geometry },
+    { "Kernels", "rainbow colours of every hue", sizeof(RainbowTable<>::rgb), 0 },
+    { "Patterns", "names", names, 0 },
+    { "Patterns", "noise parameters", 3 * sizeof(NoiseParams), 0 },
+    { "Patterns", "palettes used (FastLED's)", 6 * sizeof(TProgmemRGBPalette16), 0 },
+    { "Playlist", "playlists and their steps", Control::getNumPlaylists() * sizeof(Playlist) + steps, 0 },
+    { "UI", "pins, button timing and handlers", UI_LEDS + NUM_BUTTONS * (1 + sizeof(ButtonTiming) + sizeof(void (UI::*)(buttonPress_t))), 0 },
+  };
+}
+
+static int report(unsigned long sram, unsigned long reserve, bool check)
+{
+  printf("\nSRAM of the sketch on %dx%d (%d LEDs), host sizes (an upper bound), Config.h as for the AVR\n", NUM_COLS, NUM_ROWS,
+         NUM_LEDS);
+  printf("noise cache %d octave(s), palette table %d entries, %d particles\n", NOISE_CACHED_OCTAVES, PALETTE_LUT_SIZE,
+         MAX_PARTICLES);
+  unsigned long total, perLed;
+  printItems("SRAM", sramItems(), total, perLed);
+  long left = (long)sram - (long)reserve - (long)total;
+  printf("\n%lu of %lu bytes, %lu kept for the core and the stack: %ld %s\n", total, sram, reserve, left < 0 ? -left : left,
+         left < 0 ? "OVER" : "to spare");
+  double pixel = (double)perLed / NUM_LEDS;
+  long fixed = total - perLed;
+  long fit = (long)(((long)sram - (long)reserve - fixed) / pixel);
+  if (fit > 0) printf("%.1f bytes a pixel: %ld LEDs would fit (%+ld)\n", pixel, fit, fit - NUM_LEDS);
+  else printf("%.1f bytes a pixel, but the rest is over the budget without any\n", pixel);
+
+  PatternSizes<TotemPatterns>::print();
+  printf("  a new pattern with up to %u bytes of state costs no SRAM; past that, 3 bytes a byte\n",
+         (unsigned)sizeof(TotemPatterns::State));
+
+  unsigned long flash, flashPerLed;
+  printItems("Flash tables", flashItems(), flash, flashPerLed);
+  printf("(code is on top; for it, and the exact figures, run the AVR build's symbols through --nm)\n");
+
+  if (check && left < 0) {
+    printf("FAIL: over the SRAM budget\n");
+    return 1;
+  }
+  return 0;
+}
+
+/******************************/
+/*     AVR BUILD SYMBOLS      */
+/******************************/
+// The subsystem a symbol belongs to, by the first of these its name has in it
+static const struct { const char *match; const char *subsystem; } subsystems[] = {
+  { "leds", "LEDs" }, { "Control", "Control" }, { "FrameBuffer", "Control" }, { "Transition", "Control" },
+  { "RainbowTable", "Kernels" }, { "Pattern", "Patterns" }, { "Rainbow", "Patterns" }, { "Confetti", "Patterns" }, { "Rolling", "Patterns" },
+  { "ScrollRows", "Patterns" }, { "BPMBoogie", "Patterns" }, { "Sparks", "Patterns" }, { "Particle", "Patterns" },
+  { "Lava", "Patterns" }, { "Plasma", "Patterns" }, { "Fire", "Patterns" }, { "Kernels", "Kernels" },
+  { "Noise", "Noise" }, { "Palette", "Palette" }, { "Geometry", "Geometry" },
+  { "AudioBeat", "Audio" }, { "Playlist", "Playlist" }, { "playlists", "Playlist" }, { "UI", "UI" }, { "ui", "UI" },
+  { "Buttons", "UI" }, { "Settings", "Settings" }, { "settings", "Settings" }, { "Log", "Log" }, { "Profile", "Profiler" },
+  { "Osc", "OSC" }, { "Capture", "Capture" }, { "CLED", "FastLED" }, { "FastLED", "FastLED" }, { "ClocklessController", "FastLED" },
+  { "Serial", "Arduino core" }, { "USB", "Arduino core" }, { "CDC", "Arduino core" }, { "timer0", "Arduino core" },
+};
+
+static const char *subsystemOf(const char *name)
+{
+  for (const auto &s : subsystems) {
+    if (strstr(name, s.match)) return s.subsystem;
+  }
+  return "other";
+}
+
+static int reportNm(FILE *in, unsigned long sram, unsigned long reserve, bool check)
+{
+  std::map<std::string, unsigned long> ram, flash;
+  unsigned long ramTotal = 0, flashTotal = 0;
+  char line[1024];
+  while (fgets(line, sizeof(line), in)) {
+    unsigned long addr, size;
+    char type;
+    int at = 0;
+    if (sscanf(line, "%lx %lx %c %n", &addr, &size, &type, &at) != 3) continue;   // no size: not an object or function
+    char *name = line + at;
+    name[strcspn(name, "\n")] = 0;
+    const char *sub = subsystemOf(name);
+    bool data = type == 'd' || type == 'D';
+    if (data || type == 'b' || type == 'B') { ram[sub] += size; ramTotal += size; }
+    if (data || type == 't' || type == 'T' || type == 'r' || type == 'R') { flash[sub] += size; flashTotal += size; }
+  }
+  printf("\n%-14s %10s %10s\n", "AVR build", "SRAM", "flash");
+  std::map<std::string, bool> seen;
+  for (auto &r : ram) seen[r.first] = true;
+  for (auto &f : flash) seen[f.first] = true;
+  for (auto &s : seen) printf("%-14s %10lu %10lu\n", s.first.c_str(), ram[s.first], flash[s.first]);
+  printf("%-14s %10lu %10lu\n", "total", ramTotal, flashTotal);
+  long left = (long)sram - (long)reserve - (long)ramTotal;
+  printf("\nSRAM: %lu of %lu bytes, %lu kept for the stack: %ld %s\n", ramTotal, sram, reserve, left < 0 ? -left : left,
+         left < 0 ? "OVER" : "to spare");
+  if (check && left < 0) {
+    printf("FAIL: over the SRAM budget\n");
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long sram = 2560, reserve = 0;
+  bool check = false;
+  const char *nm = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--sram") && i + 1 < argc) sram = strtoul(argv[++i], 0, 10);
+    else if (!strcmp(argv[i], "--reserve") && i + 1 < argc) reserve = strtoul(argv[++i], 0, 10);
+    else if (!strcmp(argv[i], "--check")) check = true;
+    else if (!strcmp(argv[i], "--nm") && i + 1 < argc) nm = argv[++i];
+    else {
+      fprintf(stderr, "usage: memory_report [--sram 2560] [--reserve BYTES] [--check] [--nm FILE|-]\n");
+      return 2;
+    }
+  }
+  if (!nm) return report(sram, reserve ? reserve : 640, check);
+
+  FILE *in = strcmp(nm, "-") ? fopen(nm, "r") : stdin;
+  if (!in) { perror(nm); return 2; }
+  int result = reportNm(in, sram, reserve ? reserve : 320, check);
+  if (in != stdin) fclose(in);
+  return result;
+}
@@ -0,0 +1,196 @@
+//// osc_remote.cpp
+// Drives the sketch's OSC endpoint (totem/Osc.h) over real UDP on localhost
+//
+// The sketch is built with OSC, its WiFiUDP the Linux socket stand-in in
+// stub/, and this plays the phone: a second socket that sends messages to
+// OSC_PORT and listens for the feedback on OSC_FEEDBACK_PORT.
+//
+//   osc_remote [--check]
+//     scripted: each address, malformed packets, a fader being swept (the
+//     feedback must stay throttled) and a burst of packets (no loop may
+//     take more than maxPacketsPerService of them). --check makes it a test.
+//   osc_remote --serve SECONDS
+//     runs the sketch in step with the real clock, for trying a real OSC
+//     client against it, e.g.  oscsend localhost 8000 /brightness f 0.25
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "totem.ino"
+
+static WiFiUDP phone;
+static std::vector<std::string> feedback;     // address and value of each message the phone got
+
+static void receive()
+{
+  uint8_t buf[256];
+  while (int size = phone.parsePacket()) {
+    int n = phone.read(buf, sizeof(buf));
+    OscMessage m;
+    if (!m.parse(buf, n)) { feedback.push_back("(bad)"); continue; }
+    std::string v = m.type(0) == 's' ? m.asString(0) : m.type(0) == 'f' ? std::to_string(m.asFloat(0)) : std::to_string(m.asInt(0));
+    feedback.push_back(std::string(m.address()) + " " + v);
+    (void)size;
+  }
+}
+
+// loop() for ms milliseconds, 100 us a pass; the most packets any one pass took
+static unsigned long run(unsigned long ms)
+{
+  unsigned long most = 0;
+  for (unsigned long i = 0; i < ms * 10; i++) {
+    unsigned long before = osc.stats().packets;
+    loop();
+    if (osc.stats().packets - before > most) most = osc.stats().packets - before;
+    host::advanceMicros(100);
+    receive();
+  }
+  return most;
+}
+
+static void sendRaw(const uint8_t *buf, size_t n)
+{
+  phone.beginPacket(WiFiUDP::localhost(), OSC_PORT);
+  phone.write(buf, n);
+  phone.endPacket();
+}
+
+static void send(const OscWriter &w, const uint8_t *buf) { sendRaw(buf, w.length()); }
+
+static uint8_t out[256];
+static void send(const char *address) { send(OscWriter(out, sizeof(out)).address(address, ""), out); }
+static void send(const char *address, float v) { send(OscWriter(out, sizeof(out)).address(address, "f").add(v), out); }
+static void send(const char *address, int32_t v) { send(OscWriter(out, sizeof(out)).address(address, "i").add(v), out); }
+
+static size_t count(const char *prefix)
+{
+  size_t n = 0;
+  for (const std::string &f : feedback) n += f.compare(0, strlen(prefix), prefix) == 0;
+  return n;
+}
+static std::string last(const char *prefix)
+{
+  for (size_t i = feedback.size(); i-- > 0; ) if (feedback[i].compare(0, strlen(prefix), prefix) == 0) return feedback[i];
+  return "";
+}
+
+static bool failed = false;
+static void expect(bool ok, const char *what)
+{
+  printf("  %-54s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failed = true;
+}
+
+static int scripted(bool check)
+{
+  if (!phone.begin(OSC_FEEDBACK_PORT)) { fprintf(stderr, "osc_remote: can't listen on %d\n", OSC_FEEDBACK_PORT); return 1; }
+  setup();
+  run(100);
+
+  printf("Addresses:\n");
+  send("/brightness", 0.5f);                    run(20);
+  expect(Control.getBrightness() == 128, "/brightness f 0.5 -> 128");
+  send("/brightness", (int32_t)200);            run(20);
+  expect(Control.getBrightness() == 200, "/brightness i 200 -> 200");
+  send("/pattern", (int32_t)3);                 run(20);
+  expect(Control.getPattern() == 3, "/pattern i 3");
+  send("/pattern/next");                        run(20);
+  expect(Control.getPattern() == 4, "/pattern/next");
+  send("/pattern", 99.0f);                      run(20);
+  expect(Control.getPattern() == 4, "/pattern f 99 (no such pattern) ignored");
+  send("/tempo", 128.0f);                       run(20);
+  expect(abs((int)Control.get_BPM() - 128) <= 1, "/tempo f 128");
+  for (int i = 0; i < 4; i++) { send("/tap", 1.0f); run(1); send("/tap", 0.0f); run(499); }
+  expect(Control.get_BPM() == 120, "/tap 1 every 500 ms -> 120 BPM (and /tap 0 ignored)");
+
+  printf("Bad packets:\n");
+  unsigned long bad = osc.stats().bad, unknown = osc.stats().unknown;
+  const uint8_t noTypes[] = {'/', 't', 'a', 'p', 0, 0, 0, 0};
+  const uint8_t bundle[] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0, 0, 0, 0, 0, 0, 0, 0, 1};
+  const uint8_t truncated[] = {'/', 'b', 'r', 'i', 'g', 'h', 't', 'n', 'e', 's', 's', 0, ',', 'f', 0, 0};
+  const uint8_t unended[] = {'/', 't', 'a', 'p', 'p', 'p', 'p', 'p'};
+  uint8_t big[OscEndpoint::bufSize + 4];
+  uint16_t bigLen = OscWriter(big, sizeof(big)).address("/brightness", "s").add(std::string(60, 'x').c_str()).length();
+  sendRaw((const uint8_t *)"hello", 5);
+  sendRaw(noTypes, sizeof(noTypes));
+  sendRaw(bundle, sizeof(bundle));
+  sendRaw(truncated, sizeof(truncated));
+  sendRaw(unended, sizeof(unended));
+  sendRaw(big, bigLen);
+  send("/nothing/here", 1.0f);
+  run(20);
+  expect(osc.stats().bad - bad == 6, "6 malformed, bundled or too big, dropped");
+  expect(osc.stats().unknown - unknown == 1, "unknown address counted");
+  expect(Control.getBrightness() == 200 && Control.getPattern() == 4, "state untouched by them");
+
+  printf("Feedback:\n");
+  run(200);
+  char want[64];
+  snprintf(want, sizeof(want), "/pattern/name %s", Control::getPatternName(4));
+  expect(last("/pattern ") == "/pattern 4", "/pattern 4");
+  expect(last("/pattern/name") == want, want);
+  expect(last("/tempo") == "/tempo " + std::to_string(120.0f), "/tempo 120");
+  expect(last("/brightness") == "/brightness " + std::to_string(200 / 255.0f), "/brightness 0.78");
+  size_t before = count("/brightness");
+  for (int i = 0; i < 1000; i++) { send("/brightness", (i % 97) / 96.0f); run(1); }     // a fader swept back and forth for a second
+  size_t sent = count("/brightness") - before;
+  printf("  fader moved 1000 times in 1 s: %zu /brightness sent back\n", sent);
+  expect(sent <= 1000 / OscEndpoint::feedbackMs + 1, "feedback throttled to one a feedbackMs");
+  Control.incBrightness();
+  run(200);
+  expect(last("/brightness") == "/brightness " + std::to_string(Control.getBrightness() / 255.0f), "a button's change is sent back too");
+
+  printf("Burst:\n");
+  Profile.reset();
+  unsigned long packets = osc.stats().packets;
+  const int burst = 200;
+  for (int i = 0; i < burst; i++) send("/brightness", (int32_t)(i & 0xFF));
+  unsigned long most = run(100);
+  const ProfileStage &ps = Profile.stage(ProfOsc);
+  printf("  %d sent at once, %lu taken (the rest dropped by the socket), at most %lu a loop;\n"
+         "  service() %u us at most, %.1f us mean (host CPU)\n", burst, osc.stats().packets - packets, most,
+         ps.maxTicks / Profiler::ticksPerUs, ps.count ? ps.sumTicks / (double)ps.count / Profiler::ticksPerUs : 0.0);
+  expect(most <= OscEndpoint::maxPacketsPerService, "no loop took more than maxPacketsPerService");
+
+  const OscStats &s = osc.stats();
+  printf("\n%lu packets, %lu handled, %lu bad, %lu unknown, %lu feedback messages\n", s.packets, s.handled, s.bad, s.unknown, s.feedback);
+  return check && failed ? 1 : 0;
+}
+
+static int serve(unsigned long seconds)
+{
+  setup();
+  printf("listening on 127.0.0.1:%d, feedback to the sender's port %d, for %lu s\n", OSC_PORT, OSC_FEEDBACK_PORT, seconds);
+  unsigned long handled = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned long ms = 0; ms < seconds * 1000; ms++) {
+    for (int i = 0; i < 10; i++) { loop(); host::advanceMicros(100); }
+    if (osc.stats().handled != handled) {
+      handled = osc.stats().handled;
+      printf("%7lu ms  pattern %s, brightness %u, %u BPM\n", ms, Control::getPatternName(Control.getPattern()),
+             Control.getBrightness(), Control.get_BPM());
+    }
+    std::this_thread::sleep_until(start + std::chrono::milliseconds(ms + 1));
+  }
+  const OscStats &s = osc.stats();
+  printf("%lu packets, %lu handled, %lu bad, %lu unknown, %lu feedback messages\n", s.packets, s.handled, s.bad, s.unknown, s.feedback);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  bool check = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--check")) check = true;
+    else if (!strcmp(argv[i], "--serve") && i + 1 < argc) return serve(strtoul(argv[++i], 0, 10));
+    else { fprintf(stderr, "usage: osc_remote [--check]\n       osc_remote --serve SECONDS\n"); return 2; }
+  }
+  return scripted(check);
+}
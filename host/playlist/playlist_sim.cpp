@@ -0,0 +1,188 @@
+//// playlist_sim.cpp
+// The playlists (totem/Playlist.h) played by the sketch on the virtual clock
+//
+// Minutes of show run in a second or two, each loop() pass 100 us:
+//  - the toggle button held for a long press starts the first playlist,
+//    the next long press the second, the one after that turns it off
+//  - every step comes in on its beat, shows its pattern with its hue
+//    speed, and lasts the beats it asked for (a step in seconds: rounded to
+//    beats at the tempo)
+//  - switches are to a pattern started, and its first frame drawn, ahead
+//    of time, and no frame is missed; a staged switch's frame (the first
+//    pass after the switch to output one) expands no palette (a palette
+//    blend's slice, as any frame of the blend) and fills no noise planes,
+//    and its host CPU time, against the other frames', is reported
+//  - no settings are saved while a playlist runs
+// --check makes it a test.
+//
+//   playlist_sim [--minutes N] [--check]
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "totem.ino"
+
+struct Switch
+{
+  unsigned long ms;
+  uint16_t beats;
+  uint16_t phase;
+  uint8_t pattern;
+  uint8_t hueSpeed;
+};
+
+struct PassCost
+{
+  unsigned long n = 0;
+  double sumUs = 0, maxUs = 0;
+  void add(double us) { n++; sumUs += us; if (us > maxUs) maxUs = us; }
+  double mean() const { return n ? sumUs / n : 0; }
+};
+
+static std::vector<Switch> switches;
+static size_t listStart;      // switches before the playlist playing now started
+static PassCost frameCost, switchCost;
+static bool switchPending, stagedPending;  // a switch, and its frame not out yet
+static unsigned long switchFrames;         // staged switches' frames: how many,
+static unsigned long switchEntries;        // the most palette entries one expanded,
+static unsigned long switchPlanes;         // and the noise planes they filled
+
+// loop() for ms milliseconds, 100 us a pass
+static void run(unsigned long ms)
+{
+  for (unsigned long i = 0; i < ms * 10; i++) {
+    unsigned long shows = FastLED.hostShowCount();
+    unsigned long switched = Control.getPlaylistStats().switches;
+    unsigned long staged = Control.getPlaylistStats().staged;
+    unsigned long entries = Palettes.stats().entries, planes = Noise.stats().planes;
+    uint8_t list = Control.getPlaylist();
+    auto t0 = std::chrono::steady_clock::now();
+    loop();
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    bool frame = FastLED.hostShowCount() != shows;
+    if (Control.getPlaylist() != list) listStart = switches.size();
+    if (Control.getPlaylistStats().switches != switched) {
+      const BeatClock &clock = Control.getBeatClock();
+      switches.push_back(Switch{millis(), clock.beats(), clock.phase(), Control.getPattern(), Control.getHueSpeed()});
+      switchPending = true;
+      stagedPending = Control.getPlaylistStats().staged != staged;
+    }
+    if (frame && switchPending) {
+      switchCost.add(us);
+      if (stagedPending) {
+        switchFrames++;
+        entries = Palettes.stats().entries - entries;
+        if (entries > switchEntries) switchEntries = entries;
+        switchPlanes += Noise.stats().planes - planes;
+      }
+      switchPending = stagedPending = false;
+    } else if (frame) {
+      frameCost.add(us);
+    }
+    host::advanceMicros(100);
+  }
+}
+
+static void holdToggle()
+{
+  host::setPin(2, LOW);
+  run(4100);                            // the toggle button's long press is 4 s
+  host::setPin(2, HIGH);
+  run(200);
+}
+
+static bool failed = false;
+static void expect(bool ok, const char *what)
+{
+  printf("  %-62s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failed = true;
+}
+
+// The switches recorded since the playlist started against its steps
+static void checkSteps(uint8_t list)
+{
+  size_t from = listStart;
+  const Playlist &p = playlists[list];
+  uint32_t beatUs = Control.getBeatClock().periodUs();
+  uint16_t maxPhase = 65536UL * 1000 / beatUs;    // within the beat's first ms
+  size_t onBeat = 0, right = 0, lengthOk = 0, lengths = 0;
+  for (size_t i = from; i < switches.size(); i++) {
+    const Switch &s = switches[i];
+    const PlaylistStep &step = p.steps[(i - from) % p.count];
+    onBeat += s.phase <= maxPhase;
+    right += s.pattern == step.pattern && (!step.hueSpeed || s.hueSpeed == step.hueSpeed);
+    if (i + 1 < switches.size()) {
+      uint16_t want = step.inSeconds() ? (step.length * 1000000UL + beatUs / 2) / beatUs : step.length;
+      lengths++;
+      lengthOk += (uint16_t)(switches[i + 1].beats - s.beats) == want;
+    }
+  }
+  size_t n = switches.size() - from;
+  printf("  %zu steps: %zu on the beat, %zu with the step's pattern and hue speed, %zu of %zu the right length\n",
+         n, onBeat, right, lengthOk, lengths);
+  expect(n > p.count, "played through and round again");
+  expect(onBeat == n, "each step in the first ms of its beat");
+  expect(right == n, "each step's pattern and hue speed");
+  expect(lengthOk == lengths, "each step as many beats as it asked for");
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long minutes = 10;
+  bool check = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--minutes") && i + 1 < argc) minutes = strtoul(argv[++i], 0, 10);
+    else if (!strcmp(argv[i], "--check")) check = true;
+    else { fprintf(stderr, "usage: playlist_sim [--minutes N] [--check]\n"); return 2; }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint8_t pin = 2; pin <= 5; pin++) host::setPin(pin, HIGH);
+  setup();
+  Control.set_tempo(500);
+  run(1000);
+  printf("%u playlists, %u BPM, %lu minutes each\n\n", Control.getNumPlaylists(), Control.get_BPM(), minutes);
+
+  printf("Playlist 0 (a long press):\n");
+  holdToggle();
+  expect(Control.getPlaylist() == 0, "the first long press starts playlist 0");
+  unsigned long saves = settings.stats().saves;
+  unsigned long missed = Control.getFrameStats().missed;
+  run(minutes * 60000);
+  checkSteps(0);
+
+  printf("Playlist 1 (another):\n");
+  holdToggle();
+  expect(Control.getPlaylist() == 1, "the next long press starts playlist 1");
+  run(minutes * 60000);
+  checkSteps(1);
+  expect(settings.stats().saves == saves, "no settings saved while playing");
+
+  printf("Off (and another):\n");
+  holdToggle();
+  expect(Control.getPlaylist() == PlaylistPlayer::off, "the long press after the last turns it off");
+  size_t before = switches.size();
+  uint8_t pattern = Control.getPattern();
+  run(60000);
+  expect(switches.size() == before && Control.getPattern() == pattern, "no more steps, the last one stays");
+
+  const PlaylistStats &ps = Control.getPlaylistStats();
+  printf("Switching:\n");
+  printf("  %lu switches, %lu to a pattern started ahead; %lu frames missed\n", ps.switches, ps.staged, Control.getFrameStats().missed - missed);
+  printf("  loop() passes, host CPU: frames %.2f us mean, %.2f max; switch frames %.2f us mean, %.2f max\n",
+         frameCost.mean(), frameCost.maxUs, switchCost.mean(), switchCost.maxUs);
+  printf("  %lu staged switch frames: at most %lu palette entries expanded, %lu noise planes filled\n", switchFrames, switchEntries, switchPlanes);
+  expect(ps.staged + 2 >= ps.switches, "all but a playlist's first step staged ahead");
+  expect(switchFrames == ps.staged, "every staged switch's frame measured");
+  expect(switchEntries <= PaletteTable::size / PaletteTable::stride, "no palette expanded on one, at most a blend's slice");
+  expect(!switchPlanes, "no noise planes filled on one");
+  expect(Control.getFrameStats().missed == missed, "no frame missed");
+
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("\n%lu minutes of show in %.1f s\n", 2 * minutes + 1, secs);
+  return check && failed ? 1 : 0;
+}
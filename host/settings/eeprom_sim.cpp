@@ -0,0 +1,189 @@
+//// eeprom_sim.cpp
+// The settings journal (totem/Settings.h) on the host's simulated EEPROM
+//
+// Each reboot is a fresh Control and Settings over the same EEPROM, as a
+// power cycle would leave them:
+//  - coalescing: a brightness button held for 6 s makes one save, and no
+//    loop ever has to wait on the EEPROM
+//  - restore: all four settings come back after a reboot
+//  - wear: thousands of saves, and how evenly they spread over the cells
+//    (against every save going to the same 8 bytes)
+//  - torn writes: the power goes during each byte of a save in turn, with
+//    the ring full of older records; the reboot must bring back the save
+//    before, and the next save must work
+// --check makes it a test.
+//
+//   eeprom_sim [--saves N] [--check]
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <FastLED.h>
+
+#include "Control.h"
+#include "Settings.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+CRGB leds[NUM_LEDS];
+
+struct Pole
+{
+  Control control;
+  Settings settings;
+  Pole() : control(leds, NUM_LEDS), settings(&control) {}
+};
+
+static std::unique_ptr<Pole> pole;
+static bool restored;
+
+static void reboot()
+{
+  EEPROM.hostPowerOn();
+  pole.reset();
+  pole.reset(new Pole);
+  restored = pole->settings.restore();
+}
+
+// settings.service() every stepUs for ms; the most EEPROM writes in one call
+static unsigned long run(unsigned long ms, uint32_t stepUs = 100)
+{
+  unsigned long most = 0;
+  for (unsigned long t = 0; t < ms * 1000; t += stepUs) {
+    unsigned long before = EEPROM.hostWrites();
+    pole->settings.service();
+    if (EEPROM.hostWrites() - before > most) most = EEPROM.hostWrites() - before;
+    host::advanceMicros(stepUs);
+  }
+  return most;
+}
+
+struct State
+{
+  uint8_t brightness, pattern, speed;
+  uint16_t periodMs;
+  bool operator==(const State &o) const
+  {
+    return brightness == o.brightness && pattern == o.pattern && speed == o.speed && periodMs == o.periodMs;
+  }
+};
+
+static State state()
+{
+  Control &c = pole->control;
+  return State{c.getBrightness(), c.getPattern(), c.getHueSpeed(), c.get_tempo()};
+}
+
+static void set(const State &s)
+{
+  Control &c = pole->control;
+  c.set_brightness(s.brightness);
+  if (s.pattern != c.getPattern()) c.set_pattern(s.pattern);
+  c.setHueSpeed(s.speed);
+  c.set_tempo(s.periodMs);
+}
+
+static State nth(unsigned long i)
+{
+  return State{(uint8_t)(i * 37), (uint8_t)(i % Control::getNumPatterns()), (uint8_t)(i % 50 + 1), (uint16_t)(300 + i % 500)};
+}
+
+static bool failed = false;
+static void expect(bool ok, const char *what)
+{
+  printf("  %-62s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failed = true;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long saves = 20000;
+  bool check = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--saves") && i + 1 < argc) saves = strtoul(argv[++i], 0, 10);
+    else if (!strcmp(argv[i], "--check")) check = true;
+    else { fprintf(stderr, "usage: eeprom_sim [--saves N] [--check]\n"); return 2; }
+  }
+
+  uint16_t slots = SETTINGS_EEPROM_SIZE / Settings::recordSize;
+  printf("Settings journal: %u slots of %u bytes from EEPROM address %u, saved after %u ms quiet\n\n",
+         slots, Settings::recordSize, SETTINGS_EEPROM_START, Settings::quietMs);
+
+  printf("Coalescing:\n");
+  reboot();
+  expect(!restored, "nothing to restore from an erased EEPROM");
+  unsigned long most = 0;
+  for (int i = 0; i < 30; i++) { pole->control.incBrightness(); most = max(most, run(200)); }   // held: a repeat every 200 ms
+  expect(pole->settings.stats().saves == 0, "no save while the button is held");
+  most = max(most, run(Settings::quietMs + 100));
+  expect(pole->settings.stats().saves == 1, "one save once it's let go and quiet");
+  printf("  %lu EEPROM writes, at most %lu in one service() call, %lu stalls\n", EEPROM.hostWrites(), most, EEPROM.hostStalls());
+  expect(most <= 1 && EEPROM.hostStalls() == 0, "a byte a call, never while the EEPROM is busy");
+
+  printf("Restore:\n");
+  State want = {pole->control.getBrightness(), 4, 33, 420};
+  set(want);
+  run(Settings::quietMs + 100);
+  reboot();
+  unsigned long reads = EEPROM.hostReads();
+  auto t0 = std::chrono::steady_clock::now();
+  Settings timing(&pole->control);
+  timing.restore();
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  printf("  restore() reads %lu bytes, %.1f us on this host\n", EEPROM.hostReads() - reads, us);
+  expect(restored && state() == want, "brightness, pattern, hue speed and tempo come back");
+
+  printf("Wear, %lu saves:\n", saves);
+  EEPROM.hostErase();
+  reboot();
+  for (unsigned long i = 0; i < saves; i++) {
+    set(nth(i));
+    run(Settings::quietMs + 1, 1000);
+    while (pole->settings.saving()) run(4);
+  }
+  unsigned long minWear = ~0UL, maxWear = 0, total = 0;
+  for (uint16_t a = SETTINGS_EEPROM_START; a < SETTINGS_EEPROM_START + SETTINGS_EEPROM_SIZE; a++) {
+    minWear = min(minWear, EEPROM.hostWear(a));
+    maxWear = max(maxWear, EEPROM.hostWear(a));
+    total += EEPROM.hostWear(a);
+  }
+  unsigned long perSlot = (saves + slots - 1) / slots;
+  printf("  %lu saves, %lu bytes written; writes a cell: min %lu, mean %.1f, max %lu (one place would be %lu)\n",
+         pole->settings.stats().saves, total, minWear, total / (double)SETTINGS_EEPROM_SIZE, maxWear, saves);
+  printf("  at 100,000 writes a cell: %.1f million saves before the first cell wears out\n", 100000.0 * saves / maxWear / 1e6);
+  expect(pole->settings.stats().saves == saves, "every change saved");
+  expect(maxWear <= perSlot, "no cell written more than once every slots saves");
+  reboot();
+  expect(restored && state() == nth(saves - 1), "the last of them restored");
+
+  printf("Torn writes:\n");
+  unsigned long torn = 0, tornOk = 0, whole = 0, wholeOk = 0, after = 0;
+  for (unsigned long trial = 0; trial < 64; trial++) {
+    State before = state();
+    State next = nth(saves + trial);
+    unsigned long tearAt = trial % Settings::recordSize + 1;
+    set(next);
+    EEPROM.hostPowerFailAfter(tearAt);
+    run(Settings::quietMs + 100);
+    bool tore = EEPROM.hostPowerFailed();
+    reboot();
+    State got = state();
+    if (tore) { torn++; tornOk += got == before; }
+    else { whole++; wholeOk += got == next; }
+    // and the journal carries on from there
+    State later = nth(saves + 1000 + trial);
+    set(later);
+    run(Settings::quietMs + 100);
+    reboot();
+    after += state() == later;
+  }
+  printf("  64 saves, the power cut during byte 1-8 of each: %lu torn, %lu of those restored the save before;\n"
+         "  %lu finished first (bytes that didn't change aren't written), %lu of those restored\n", torn, tornOk, whole, wholeOk);
+  expect(torn > 0 && tornOk == torn, "a torn save falls back to the one before");
+  expect(wholeOk == whole, "a save the power didn't cut is restored");
+  expect(after == 64, "the next save after a torn one is restored");
+
+  return check && failed ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+//// rate_sim.cpp
+// The frame rate and quality governor (totem/RateGovernor.h) against frames of a set cost
+//
+// Runs the sketch on the virtual clock, each loop() pass 100 us, with
+// FastLED.show() taking its modelled wire time and, on top, a render time
+// put on each frame: --cost us at full quality, 70% of it at reduced and
+// 50% at minimal, as a heavy pattern on a big pole might. Through four
+// phases, light, heavy, heavier and light again, it prints the LogFrameRate
+// records from the serial log as they come, and at the end of each the
+// rate, the quality and the frames rendered a second.
+// --check makes it a test:
+//  - light frames run at FRAME_RATE_MAX at full quality, before and after
+//  - heavy ones lower the quality rather than the rate going under
+//    FRAME_RATE_FLOOR, and the heaviest go under it only at the lowest
+//    quality, and never under FRAME_RATE_MIN
+//  - the frames rendered keep up with the rate chosen
+//  - the status on the UI LEDs (a long press of fn): the rate as a bar,
+//    blinking when the quality's down; and the serial command 's' logs it
+//
+//   rate_sim [--cost US] [--seconds N] [--check]
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "totem.ino"
+#include "log/LogDecoder.h"
+
+static uint32_t renderUs = 0;       // at full quality
+static LogDecoder decoder;
+static unsigned long frameRateRecords = 0;
+static bool underFloor = false;     // under the floor with the quality still to lower
+static uint8_t lowestFps = 255;
+
+static void renderTime(const CLEDController *, uint8_t, uint8_t)
+{
+  static const uint8_t percent[] = {100, 70, 50};
+  host::advanceMicros(renderUs * percent[Control.getQuality()] / 100);
+}
+
+// loop() for ms milliseconds of the virtual clock, 100 us a pass (and the render time of the frames)
+static void run(unsigned long ms)
+{
+  for (unsigned long end = millis() + ms; (long)(millis() - end) < 0; ) {
+    loop();
+    host::advanceMicros(100);
+    uint8_t fps = Control.getFrameRate();
+    if (fps < FRAME_RATE_FLOOR && Control.getQuality() < QualityMinimal) underFloor = true;
+    if (fps < lowestFps) lowestFps = fps;
+    std::string &out = Serial.hostRecorded();
+    if (!out.empty()) {
+      decoder.feed((const uint8_t *)out.data(), out.size(), [](const LogRecord &r) {
+        if (r.id != LogFrameRate) return;
+        frameRateRecords++;
+        printf("  %7lu ms  %s\n", millis(), r.text.c_str());
+      });
+      out.clear();
+    }
+  }
+}
+
+static bool failed = false;
+static void expect(bool ok, const char *what)
+{
+  printf("  %-62s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failed = true;
+}
+
+static const char *qualityName(Quality q) { return q == QualityFull ? "full" : q == QualityReduced ? "reduced" : "minimal"; }
+
+// A phase of seconds at this render time; the frames a second over its last 2 s against the period
+static bool phase(const char *name, uint32_t us, unsigned long seconds)
+{
+  printf("\n%s: %lu us a frame rendering at full quality\n", name, (unsigned long)us);
+  renderUs = us;
+  run((seconds - 2) * 1000);
+  unsigned long frames = Control.getFrameStats().frames;
+  run(2000);
+  double rendered = (Control.getFrameStats().frames - frames) / 2.0;
+  double period = 1000000.0 / Control.getFramePeriod();
+  printf("  %u FPS asked (%.1f fitted to the beat), %.1f rendered, quality %s, %lu us a frame\n", Control.getFrameRate(),
+         period, rendered, qualityName(Control.getQuality()), (unsigned long)Control.getRateGovernor().stats().costUs);
+  return rendered >= period * 0.9;
+}
+
+// The indicator LEDs over a second of the status: how many were lit, and did they blink
+static void watchStatus(uint8_t &lit, bool &blinked)
+{
+  lit = 0;
+  blinked = false;
+  uint8_t first[UI_LEDS];
+  for (uint8_t i = 0; i < UI_LEDS; i++) first[i] = host::getPin(A1 + i);
+  for (int ms = 0; ms < 1000; ms += 10) {
+    run(10);
+    for (uint8_t i = 0; i < UI_LEDS; i++) {
+      if (host::getPin(A1 + i) != first[i]) blinked = true;
+      if (host::getPin(A1 + i) && i + 1 > lit) lit = i + 1;
+    }
+  }
+}
+
+static void holdFn()
+{
+  host::setPin(5, LOW);
+  run(1100);                            // fn's long press is 1 s
+  host::setPin(5, HIGH);
+  run(100);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t cost = 28000;
+  unsigned long seconds = 20;
+  bool check = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--cost") && i + 1 < argc) cost = strtoul(argv[++i], 0, 10);
+    else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = strtoul(argv[++i], 0, 10);
+    else if (!strcmp(argv[i], "--check")) check = true;
+    else { fprintf(stderr, "usage: rate_sim [--cost US] [--seconds N] [--check]\n"); return 2; }
+  }
+  if (seconds < 4) seconds = 4;
+
+  for (uint8_t pin = 2; pin <= 5; pin++) host::setPin(pin, HIGH);
+  Serial.hostRecord(true);
+  setup();
+  FastLED.hostSetShowAdvancesClock(true);
+  FastLED.hostSetShowHook(renderTime);
+  Control.set_tempo(500);
+  printf("Frame rate %u..%u FPS, floor %u, on %dx%d (%lu us on the wire a frame)\n", FRAME_RATE_MIN, FRAME_RATE_MAX,
+         FRAME_RATE_FLOOR, NUM_COLS, NUM_ROWS, (unsigned long)FastLED.hostWireMicros());
+
+  bool keptUp = phase("Light", 0, seconds);
+  expect(Control.getFrameRate() == FRAME_RATE_MAX && Control.getQuality() == QualityFull, "light frames: the top rate, full quality");
+
+  keptUp &= phase("Heavy", cost, seconds);
+  expect(Control.getQuality() > QualityFull && Control.getFrameRate() >= FRAME_RATE_FLOOR,
+         "heavy frames: lower quality, the rate at the floor or over");
+
+  keptUp &= phase("Heavier", cost * 2, seconds);
+  expect(Control.getQuality() == QualityMinimal && Control.getFrameRate() < FRAME_RATE_FLOOR,
+         "heavier: the lowest quality, and only then under the floor");
+  uint8_t lit;
+  bool blinked;
+  holdFn();
+  watchStatus(lit, blinked);
+  printf("  status: %u LED(s) lit, %s\n", lit, blinked ? "blinking" : "steady");
+  expect(lit == 1 && blinked, "status: one LED (under the floor), blinking (quality down)");
+
+  keptUp &= phase("Light again", 0, seconds * 2);
+  expect(Control.getFrameRate() == FRAME_RATE_MAX && Control.getQuality() == QualityFull, "light again: back to the top rate, full quality");
+  holdFn();
+  watchStatus(lit, blinked);
+  printf("  status: %u LED(s) lit, %s\n", lit, blinked ? "blinking" : "steady");
+  expect(lit == 3 && !blinked, "status: three LEDs (the top rate), steady (full quality)");
+
+  printf("\n");
+  unsigned long records = frameRateRecords;
+  Serial.hostInput("s");
+  run(100);
+  expect(frameRateRecords == records + 1, "the serial command 's' logs the rate and quality");
+  expect(!underFloor, "never under the floor with the quality still to lower");
+  expect(lowestFps >= FRAME_RATE_MIN, "never under the minimum");
+  expect(keptUp, "the frames rendered kept up with the rate");
+  return check && failed ? 1 : 0;
+}
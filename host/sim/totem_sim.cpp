@@ -0,0 +1,58 @@
+//// totem_sim.cpp
+// Runs the sketch itself (setup() and loop() from totem.ino) on the host
+//
+// Each loop() pass advances the virtual clock by 100 us and the sketch's log
+// is decoded to stdout as it's sent, so this is the quickest way to see the
+// sketch boot and run. It ends with the profiler's report (serial command
+// 'p'), in host CPU time.
+// --wire makes FastLED.show() block for the modelled WS2812 transmission
+// time, as it does on the pole.
+//
+//   totem_sim [seconds] [--wire]
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "totem.ino"
+#include "log/LogDecoder.h"
+
+int main(int argc, char **argv)
+{
+  unsigned long seconds = 10;
+  bool wire = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--wire")) wire = true;
+    else seconds = strtoul(argv[i], 0, 10);
+  }
+
+  LogDecoder log;
+  log.patternName = [](uint8_t p) { return std::string(Control::getPatternName(p)); };
+  Serial.hostRecord(true);
+  setup();
+  FastLED.hostSetShowAdvancesClock(wire);
+  unsigned long end = micros() + seconds * 1000000UL;
+  bool reported = false;
+  while ((long)(micros() - end) < 0) {
+    if (!reported && (long)(micros() - end) > -100000L) { Serial.hostInput("p"); reported = true; }
+    loop();
+    host::advanceMicros(100);
+    std::string &out = Serial.hostRecorded();
+    if (!out.empty()) {
+      log.feed((const uint8_t *)out.data(), out.size(), [](const LogRecord &r) { printf("%7u ms  %s\n", r.ms, r.text.c_str()); });
+      out.clear();
+    }
+  }
+
+  const FrameStats &fs = Control.getFrameStats();
+  printf("\n%lu s simulated, %lu frames shown (%.2f FPS, period %lu us)\n", seconds, FastLED.hostShowCount(),
+         FastLED.hostShowCount() / (double)seconds, (unsigned long)Control.getFramePeriod());
+  printf("missed %lu, overruns %lu, max late %lu us, jitter %lu us, cost %lu us (max %lu us)\n",
+         fs.missed, fs.overruns, (unsigned long)fs.maxLateUs, (unsigned long)fs.jitterUs,
+         (unsigned long)fs.costUs, (unsigned long)fs.maxCostUs);
+  printf("shows issued %lu, skipped as unchanged %lu\n", Control.getShowStats().issued, Control.getShowStats().skipped);
+  const PowerStats &ps = Control.getPowerStats();
+  printf("power %u mA (average %u, peak %u), brightness %u, %lu frames limited, %u mAh used, %u min of battery left\n",
+         ps.mA, ps.averagemA, ps.peakmA, ps.brightness, ps.limitedFrames, Control.getmAh(), Control.getMinutesLeft());
+  return 0;
+}
@@ -0,0 +1,164 @@
+#include "Arduino.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+HardwareSerial Serial;
+
+/******************************/
+/*       VIRTUAL CLOCK        */
+/******************************/
+static uint32_t clockMicros = 0;
+
+unsigned long millis() { return clockMicros / 1000; }
+unsigned long micros() { return clockMicros; }
+void delay(unsigned long ms) { clockMicros += ms * 1000; }
+void delayMicroseconds(unsigned int us) { clockMicros += us; }
+
+void host::setMicros(uint32_t us) { clockMicros = us; }
+void host::advanceMicros(uint32_t us) { clockMicros += us; }
+void host::advanceMillis(uint32_t ms) { clockMicros += ms * 1000; }
+
+uint32_t host::cpuTicks()
+{
+  auto ns = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(ns).count() / 500;
+}
+
+/******************************/
+/*           PINS             */
+/******************************/
+static uint8_t pinLevel[NUM_DIGITAL_PINS];
+static uint8_t pinModes[NUM_DIGITAL_PINS];
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin >= NUM_DIGITAL_PINS) return;
+  pinModes[pin] = mode;
+  if (mode == INPUT_PULLUP) pinLevel[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  if (pin < NUM_DIGITAL_PINS) pinLevel[pin] = val ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin)
+{
+  return pin < NUM_DIGITAL_PINS ? pinLevel[pin] : LOW;
+}
+
+int analogRead(uint8_t pin)
+{
+  return pin < NUM_DIGITAL_PINS && pinLevel[pin] ? 1023 : 0;
+}
+
+static void (*pinHandler[NUM_DIGITAL_PINS])(void);
+static int pinHandlerMode[NUM_DIGITAL_PINS];
+
+void attachInterrupt(uint8_t interruptNum, void (*handler)(void), int mode)
+{
+  if (interruptNum >= NUM_DIGITAL_PINS) return;
+  pinHandler[interruptNum] = handler;
+  pinHandlerMode[interruptNum] = mode;
+}
+
+void detachInterrupt(uint8_t interruptNum)
+{
+  if (interruptNum < NUM_DIGITAL_PINS) pinHandler[interruptNum] = 0;
+}
+
+void host::setPin(uint8_t pin, uint8_t val)
+{
+  if (pin >= NUM_DIGITAL_PINS) return;
+  uint8_t level = val ? HIGH : LOW;
+  if (level == pinLevel[pin]) return;
+  pinLevel[pin] = level;
+  int mode = pinHandlerMode[pin];
+  if (pinHandler[pin] && (mode == CHANGE || (mode == RISING) == (level == HIGH))) pinHandler[pin]();
+}
+
+uint8_t host::getPin(uint8_t pin) { return pin < NUM_DIGITAL_PINS ? pinLevel[pin] : LOW; }
+uint8_t host::getPinMode(uint8_t pin) { return pin < NUM_DIGITAL_PINS ? pinModes[pin] : INPUT; }
+
+/******************************/
+/*          RANDOM            */
+/******************************/
+static unsigned long randState = 1;
+
+long random(long howbig)
+{
+  if (howbig <= 0) return 0;
+  randState = randState * 1103515245UL + 12345UL;
+  return (long)((randState >> 16) % (unsigned long)howbig);
+}
+
+long random(long howsmall, long howbig)
+{
+  if (howsmall >= howbig) return howsmall;
+  return random(howbig - howsmall) + howsmall;
+}
+
+void randomSeed(unsigned long seed) { if (seed != 0) randState = seed; }
+
+/******************************/
+/*          SERIAL            */
+/******************************/
+int HardwareSerial::availableForWrite()
+{
+  if (!pace_m) return txBufferSize;
+  uint64_t now = micros();
+  if (txBusyUntilUs_m <= now) return txBufferSize;
+  uint64_t pending = ((txBusyUntilUs_m - now) * (baud_m / 10) + 999999) / 1000000;
+  return pending >= txBufferSize ? 0 : txBufferSize - (int)pending;
+}
+
+void HardwareSerial::sent(const uint8_t *buf, size_t n)
+{
+  if (pace_m) {
+    if ((size_t)availableForWrite() < n) stalls_m++;
+    uint64_t now = micros();
+    if (txBusyUntilUs_m < now) txBusyUntilUs_m = now;
+    txBusyUntilUs_m += (uint64_t)n * 10000000 / baud_m;    // 10 bits a byte
+  }
+  written_m += n;
+  if (record_m) recorded_m.append((const char *)buf, n);
+  if (echo_m) fwrite(buf, 1, n, stdout);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  sent(&c, 1);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t n)
+{
+  sent(buf, n);
+  return n;
+}
+
+size_t HardwareSerial::print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+size_t HardwareSerial::print(char c) { return write((uint8_t)c); }
+
+size_t HardwareSerial::print(long n)
+{
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%ld", n);
+  return print(buf);
+}
+
+size_t HardwareSerial::print(unsigned long n)
+{
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lu", n);
+  return print(buf);
+}
+
+size_t HardwareSerial::print(double n, int digits)
+{
+  char buf[40];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return print(buf);
+}
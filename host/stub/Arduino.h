@@ -0,0 +1,149 @@
+//// Arduino.h (host stand-in)
+// Minimal Arduino core for building the totem sketch on Linux
+//
+// Time is virtual: millis()/micros() only move when a host tool calls
+// host::advanceMicros() (or delay()), so runs are repeatable and a
+// benchmark can step the sketch frame by frame.
+// Pins are plain arrays that host tools can drive with host::setPin().
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT         0x0
+#define OUTPUT        0x1
+#define INPUT_PULLUP  0x2
+
+// Pro Micro (ATmega32u4) analog pin numbering
+#define A0 18
+#define A1 19
+#define A2 20
+#define A3 21
+#define A4 22
+#define A5 23
+#define A6 24   // D4
+#define A7 25   // D6
+#define A8 26   // D8
+#define A9 27   // D9
+#define A10 28  // D10
+#define A11 29  // D12
+#define NUM_DIGITAL_PINS 30
+
+// Flash is just memory here
+#define PROGMEM
+#define F(s) (s)
+#define memcpy_P memcpy
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+// Arduino's min/max are macros; functions keep <algorithm> usable alongside them
+template<class A, class B> inline auto min(A a, B b) -> decltype(true ? A() : B()) { return a < b ? a : b; }
+template<class A, class B> inline auto max(A a, B b) -> decltype(true ? A() : B()) { return a > b ? a : b; }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+// External interrupts. On the host every pin can interrupt (its number is
+// the pin's), and host::setPin() runs the handler on a matching edge.
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(p) ((p) < NUM_DIGITAL_PINS ? (int)(p) : NOT_AN_INTERRUPT)
+void attachInterrupt(uint8_t interruptNum, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+class HardwareSerial
+{
+  public:
+    static const uint8_t txBufferSize = 64;
+
+    void begin(unsigned long baud) { baud_m = baud; }
+    operator bool() const { return true; }
+    int available() { return input_m.size() - inputAt_m; }
+    int read() { return inputAt_m < input_m.size() ? (uint8_t)input_m[inputAt_m++] : -1; }
+    int availableForWrite();      // room in the TX buffer, as modelled (see hostPaceTx())
+
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buf, size_t n);
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(long n);
+    size_t print(unsigned long n);
+    size_t print(int n)           { return print((long)n); }
+    size_t print(unsigned int n)  { return print((unsigned long)n); }
+    size_t print(uint8_t n)       { return print((unsigned long)n); }
+    size_t print(double n, int digits = 2);
+    template<class T> size_t println(T v) { size_t n = print(v); return n + print("\r\n"); }
+    size_t println() { return print("\r\n"); }
+
+    // host only: echo to stdout (off by default so benchmarks stay quiet)
+    void hostEcho(bool on) { echo_m = on; }
+    unsigned long hostBytesWritten() const { return written_m; }
+    // model the TX buffer draining at the begin() baud rate on the virtual
+    // clock; writes that wouldn't have fit are counted as stalls, as a real
+    // Serial.write() would have blocked on them
+    void hostPaceTx(bool on) { pace_m = on; }
+    unsigned long hostStalls() const { return stalls_m; }
+    // keep everything written, for tools that decode what the sketch sends
+    void hostRecord(bool on) { record_m = on; }
+    std::string &hostRecorded() { return recorded_m; }
+    // bytes for the sketch to read, as if typed into the serial monitor
+    void hostInput(const std::string &s) { input_m.erase(0, inputAt_m); inputAt_m = 0; input_m += s; }
+  private:
+    void sent(const uint8_t *buf, size_t n);
+    bool echo_m = false;
+    bool pace_m = false;
+    bool record_m = false;
+    unsigned long baud_m = 115200;
+    unsigned long written_m = 0;
+    unsigned long stalls_m = 0;
+    uint64_t txBusyUntilUs_m = 0;   // when the last byte written is out of the buffer
+    std::string recorded_m;
+    std::string input_m;
+    size_t inputAt_m = 0;
+};
+extern HardwareSerial Serial;
+
+/******************************/
+/*     HOST-ONLY CONTROLS     */
+/******************************/
+namespace host
+{
+  void setMicros(uint32_t us);
+  void advanceMicros(uint32_t us);
+  void advanceMillis(uint32_t ms);
+  uint32_t cpuTicks();      // real time, 2 ticks a us, for timing host code (the virtual clock stands still)
+
+  void setPin(uint8_t pin, uint8_t val);    // drive an input pin (runs its interrupt handler, if any)
+  uint8_t getPin(uint8_t pin);              // read back an output pin
+  uint8_t getPinMode(uint8_t pin);
+}
+
+#endif /* HOST_ARDUINO_H */
@@ -0,0 +1,27 @@
+#include "EEPROM.h"
+
+EEPROMClass EEPROM;
+
+void EEPROMClass::write(int idx, uint8_t val)
+{
+  if (idx < 0 || idx >= size) return;
+  if (failing_m) {
+    if (failAfter_m == 0) return;             // no power
+    if (--failAfter_m == 0) { cells_m[idx] = 0xFF; return; }    // erased, then the power went
+  }
+  if (!hostReady()) stalls_m++;
+  cells_m[idx] = val;
+  wear_m[idx]++;
+  writes_m++;
+  busyUntilUs_m = micros() + writeUs;
+}
+
+void EEPROMClass::hostErase()
+{
+  memset(cells_m, 0xFF, sizeof(cells_m));
+  memset(wear_m, 0, sizeof(wear_m));
+  writes_m = reads_m = stalls_m = 0;
+  busyUntilUs_m = micros();
+  failing_m = false;
+  failAfter_m = 0;
+}
@@ -0,0 +1,53 @@
+//// EEPROM.h (host stand-in)
+// The Arduino EEPROM library over 1 KB of memory, as on the ATmega32u4
+//
+// Starts erased (0xFF). Each write keeps the EEPROM busy for writeUs of
+// virtual time, as erase and write do on the AVR; hostReady() says whether
+// it's done (the sketch asks before each write, as it would with
+// eeprom_is_ready()). Writes while busy would have blocked, and are counted
+// as stalls. Every cell's writes are counted, to see the wear, and a power
+// failure can be set up to cut a run of writes short.
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include <Arduino.h>
+
+class EEPROMClass
+{
+  public:
+    static const uint16_t size = 1024;
+    static const uint16_t writeUs = 3400;
+
+    EEPROMClass() { hostErase(); }
+
+    uint8_t read(int idx) const { reads_m++; return idx >= 0 && idx < size ? cells_m[idx] : 0xFF; }
+    void write(int idx, uint8_t val);
+    void update(int idx, uint8_t val) { if (read(idx) != val) write(idx, val); }
+    uint16_t length() const { return size; }
+
+    // host only
+    bool hostReady() const { return (int32_t)((uint32_t)micros() - busyUntilUs_m) >= 0; }
+    void hostErase();                                           // all 0xFF, wear and counts cleared
+    unsigned long hostWear(uint16_t idx) const { return idx < size ? wear_m[idx] : 0; }
+    unsigned long hostWrites() const { return writes_m; }
+    unsigned long hostReads() const { return reads_m; }
+    unsigned long hostStalls() const { return stalls_m; }
+    // the power goes during the nth write from now: it only gets as far as
+    // erasing its cell (0xFF), and nothing after it is written until hostPowerOn()
+    void hostPowerFailAfter(unsigned long n) { failAfter_m = n; failing_m = true; }
+    void hostPowerOn() { failing_m = false; busyUntilUs_m = micros(); }
+    bool hostPowerFailed() const { return failing_m && failAfter_m == 0; }
+
+  private:
+    uint8_t cells_m[size];
+    unsigned long wear_m[size];
+    unsigned long writes_m;
+    mutable unsigned long reads_m;
+    unsigned long stalls_m;
+    uint32_t busyUntilUs_m;
+    bool failing_m;
+    unsigned long failAfter_m;
+};
+extern EEPROMClass EEPROM;
+
+#endif /* HOST_EEPROM_H */
@@ -0,0 +1,304 @@
+#include "FastLED.h"
+
+CFastLED FastLED;
+uint16_t rand16seed = RAND16_SEED;
+
+/******************************/
+/*          LIB8TION          */
+/******************************/
+static const uint8_t b_m16_interleave[] = { 0, 49, 49, 41, 90, 27, 117, 10 };
+
+uint8_t sin8(uint8_t theta)
+{
+  uint8_t offset = theta;
+  if (theta & 0x40) offset = (uint8_t)255 - offset;
+  offset &= 0x3F;
+
+  uint8_t secoffset = offset & 0x0F;
+  if (theta & 0x40) secoffset++;
+
+  uint8_t section = offset >> 4;
+  uint8_t b = b_m16_interleave[section * 2];
+  uint8_t m16 = b_m16_interleave[section * 2 + 1];
+  uint8_t mx = (m16 * secoffset) >> 4;
+
+  int8_t y = mx + b;
+  if (theta & 0x80) y = -y;
+  y += 128;
+  return (uint8_t)y;
+}
+
+int16_t sin16(uint16_t theta)
+{
+  static const uint16_t base[] = { 0, 6393, 12539, 18204, 23170, 27245, 30273, 32137 };
+  static const uint8_t slope[] = { 49, 48, 44, 38, 31, 23, 14, 4 };
+
+  uint16_t offset = (theta & 0x3FFF) >> 3;
+  if (theta & 0x4000) offset = 2047 - offset;
+
+  uint8_t section = offset / 256;
+  uint16_t b = base[section];
+  uint8_t m = slope[section];
+  uint8_t secoffset8 = (uint8_t)(offset) / 2;
+
+  uint16_t mx = m * secoffset8;
+  int16_t y = mx + b;
+  if (theta & 0x8000) y = -y;
+  return y;
+}
+
+/******************************/
+/*          HSV2RGB           */
+/******************************/
+void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb)
+{
+  // FastLED's "rainbow" hue map with the default moderate yellow boost (Y1)
+  const uint8_t K255 = 255, K171 = 171, K170 = 170, K85 = 85;
+
+  uint8_t hue = hsv.hue;
+  uint8_t sat = hsv.sat;
+  uint8_t val = hsv.val;
+
+  uint8_t offset8 = (hue & 0x1F) << 3;
+  uint8_t third = scale8(offset8, (256 / 3));
+  uint8_t r, g, b;
+
+  if (!(hue & 0x80)) {
+    if (!(hue & 0x40)) {
+      if (!(hue & 0x20)) { r = K255 - third; g = third; b = 0; }
+      else               { r = K171; g = K85 + third; b = 0; }
+    } else {
+      if (!(hue & 0x20)) {
+        uint8_t twothirds = scale8(offset8, ((256 * 2) / 3));
+        r = K171 - twothirds; g = K170 + third; b = 0;
+      } else {
+        r = 0; g = K255 - third; b = third;
+      }
+    }
+  } else {
+    if (!(hue & 0x40)) {
+      if (!(hue & 0x20)) {
+        uint8_t twothirds = scale8(offset8, ((256 * 2) / 3));
+        r = 0; g = K171 - twothirds; b = K85 + twothirds;
+      } else {
+        r = third; g = 0; b = K255 - third;
+      }
+    } else {
+      if (!(hue & 0x20)) { r = K85 + third; g = 0; b = K171 - third; }
+      else               { r = K170 + third; g = 0; b = K85 - third; }
+    }
+  }
+
+  if (sat != 255) {
+    if (sat == 0) {
+      r = 255; b = 255; g = 255;
+    } else {
+      uint8_t desat = 255 - sat;
+      desat = scale8_video(desat, desat);
+      uint8_t satscale = 255 - desat;
+      r = scale8(r, satscale);
+      g = scale8(g, satscale);
+      b = scale8(b, satscale);
+      r += desat; g += desat; b += desat;
+    }
+  }
+
+  if (val != 255) {
+    val = scale8_video(val, val);
+    if (val == 0) {
+      r = 0; g = 0; b = 0;
+    } else {
+      r = scale8(r, val);
+      g = scale8(g, val);
+      b = scale8(b, val);
+    }
+  }
+
+  rgb.r = r;
+  rgb.g = g;
+  rgb.b = b;
+}
+
+/******************************/
+/*         PALETTES           */
+/******************************/
+const TProgmemRGBPalette16 CloudColors_p = {
+  CRGB::Blue, CRGB::DarkBlue, CRGB::DarkBlue, CRGB::DarkBlue,
+  CRGB::DarkBlue, CRGB::DarkBlue, CRGB::DarkBlue, CRGB::DarkBlue,
+  CRGB::Blue, CRGB::DarkBlue, CRGB::SkyBlue, CRGB::SkyBlue,
+  CRGB::LightBlue, CRGB::White, CRGB::LightBlue, CRGB::SkyBlue };
+
+const TProgmemRGBPalette16 LavaColors_p = {
+  CRGB::Black, CRGB::Maroon, CRGB::Black, CRGB::Maroon,
+  CRGB::DarkRed, CRGB::DarkRed, CRGB::Maroon, CRGB::DarkRed,
+  CRGB::DarkRed, CRGB::DarkRed, CRGB::Red, CRGB::Orange,
+  CRGB::White, CRGB::Orange, CRGB::Red, CRGB::DarkRed };
+
+const TProgmemRGBPalette16 OceanColors_p = {
+  CRGB::MidnightBlue, CRGB::DarkBlue, CRGB::MidnightBlue, CRGB::Navy,
+  CRGB::DarkBlue, CRGB::MediumBlue, CRGB::SeaGreen, CRGB::Teal,
+  CRGB::CadetBlue, CRGB::Blue, CRGB::DarkCyan, CRGB::CornflowerBlue,
+  CRGB::Aquamarine, CRGB::SeaGreen, CRGB::Aqua, CRGB::LightSkyBlue };
+
+const TProgmemRGBPalette16 ForestColors_p = {
+  CRGB::DarkGreen, CRGB::DarkGreen, CRGB::DarkOliveGreen, CRGB::DarkGreen,
+  CRGB::Green, CRGB::ForestGreen, CRGB::OliveDrab, CRGB::Green,
+  CRGB::SeaGreen, CRGB::MediumAquamarine, CRGB::LimeGreen, CRGB::YellowGreen,
+  CRGB::LightGreen, CRGB::LawnGreen, CRGB::MediumAquamarine, CRGB::ForestGreen };
+
+const TProgmemRGBPalette16 RainbowColors_p = {
+  0xFF0000, 0xD52A00, 0xAB5500, 0xAB7F00, 0xABAB00, 0x56D500, 0x00FF00, 0x00D52A,
+  0x00AB55, 0x0056AA, 0x0000FF, 0x2A00D5, 0x5500AB, 0x7F0081, 0xAB0055, 0xD5002B };
+
+const TProgmemRGBPalette16 PartyColors_p = {
+  0x5500AB, 0x84007C, 0xB5004B, 0xE5001B, 0xE81700, 0xB84700, 0xAB7700, 0xABAB00,
+  0xAB5500, 0xDD2200, 0xF2000E, 0xC2003E, 0x8F0071, 0x5F00A1, 0x2F00D0, 0x0007F9 };
+
+const TProgmemRGBPalette16 HeatColors_p = {
+  0x000000, 0x330000, 0x660000, 0x990000, 0xCC0000, 0xFF0000, 0xFF3300, 0xFF6600,
+  0xFF9900, 0xFFCC00, 0xFFFF00, 0xFFFF33, 0xFFFF66, 0xFFFF99, 0xFFFFCC, 0xFFFFFF };
+
+CRGB ColorFromPalette(const CRGBPalette16 &pal, uint8_t index, uint8_t brightness, TBlendType blendType)
+{
+  uint8_t hi4 = index >> 4;
+  uint8_t lo4 = index & 0x0F;
+  const CRGB *entry = &pal[hi4];
+
+  uint8_t red1 = entry->red;
+  uint8_t green1 = entry->green;
+  uint8_t blue1 = entry->blue;
+
+  if (lo4 && blendType != NOBLEND) {
+    entry = (hi4 == 15) ? &pal[0] : entry + 1;
+    uint8_t f2 = lo4 << 4;
+    uint8_t f1 = 255 - f2;
+    red1   = scale8(red1, f1)   + scale8(entry->red, f2);
+    green1 = scale8(green1, f1) + scale8(entry->green, f2);
+    blue1  = scale8(blue1, f1)  + scale8(entry->blue, f2);
+  }
+
+  if (brightness != 255) {
+    if (brightness) {
+      ++brightness;
+      if (red1)   red1 = scale8(red1, brightness);
+      if (green1) green1 = scale8(green1, brightness);
+      if (blue1)  blue1 = scale8(blue1, brightness);
+    } else {
+      red1 = 0; green1 = 0; blue1 = 0;
+    }
+  }
+  return CRGB(red1, green1, blue1);
+}
+
+/******************************/
+/*     ARRAY COLOUR UTILS     */
+/******************************/
+void fill_solid(CRGB *leds, int numToFill, const CRGB &color)
+{
+  for (int i = 0; i < numToFill; i++) leds[i] = color;
+}
+
+void fill_rainbow(CRGB *pFirstLED, int numToFill, uint8_t initialhue, uint8_t deltahue)
+{
+  CHSV hsv(initialhue, 240, 255);
+  for (int i = 0; i < numToFill; i++) {
+    pFirstLED[i] = hsv;
+    hsv.hue += deltahue;
+  }
+}
+
+void nscale8(CRGB *leds, uint16_t num_leds, uint8_t scale)
+{
+  for (uint16_t i = 0; i < num_leds; i++) leds[i].nscale8(scale);
+}
+
+void nscale8_video(CRGB *leds, uint16_t num_leds, uint8_t scale)
+{
+  for (uint16_t i = 0; i < num_leds; i++) leds[i].nscale8_video(scale);
+}
+
+void fadeToBlackBy(CRGB *leds, uint16_t num_leds, uint8_t fadeBy) { nscale8(leds, num_leds, 255 - fadeBy); }
+void fadeLightBy(CRGB *leds, uint16_t num_leds, uint8_t fadeBy) { nscale8_video(leds, num_leds, 255 - fadeBy); }
+
+CRGB &nblend(CRGB &existing, const CRGB &overlay, fract8 amountOfOverlay)
+{
+  if (amountOfOverlay == 0) return existing;
+  if (amountOfOverlay == 255) { existing = overlay; return existing; }
+  existing.r = blend8(existing.r, overlay.r, amountOfOverlay);
+  existing.g = blend8(existing.g, overlay.g, amountOfOverlay);
+  existing.b = blend8(existing.b, overlay.b, amountOfOverlay);
+  return existing;
+}
+
+CRGB blend(const CRGB &p1, const CRGB &p2, fract8 amountOfP2)
+{
+  CRGB nu(p1);
+  nblend(nu, p2, amountOfP2);
+  return nu;
+}
+
+/******************************/
+/*     CONTROLLER / OUTPUT    */
+/******************************/
+CLEDController &CFastLED::addController(uint8_t pin, CRGB *data, int nLeds)
+{
+  if (nControllers_m == MAX_CONTROLLERS) return controllers_m[MAX_CONTROLLERS - 1];
+  CLEDController &c = controllers_m[nControllers_m++];
+  c.leds_m = data;
+  c.nLeds_m = nLeds;
+  c.dataPin_m = pin;
+  return c;
+}
+
+uint32_t CFastLED::hostWireMicros() const
+{
+  // WS2812 at 800kHz: 24 bits * 1.25us per LED, plus a 50us latch.
+  // FastLED on the AVR writes controllers one after another, so the times
+  // add up; parallel output takes as long as the longest strip.
+  uint32_t us = 0;
+  for (uint8_t i = 0; i < nControllers_m; i++) {
+    uint32_t strip = hostWireMicros(controllers_m[i]);
+    us = parallel_m ? (strip > us ? strip : us) : us + strip;
+  }
+  return us;
+}
+
+void CFastLED::show(uint8_t scale)
+{
+  showCount_m++;
+  if (hook_m) hook_m(controllers_m, nControllers_m, scale);
+  uint32_t us = hostWireMicros();
+  wireTotalUs_m += us;
+  if (showAdvancesClock_m) host::advanceMicros(us);
+}
+
+void CFastLED::sendStrip(const CLEDController &c, uint8_t brightness)
+{
+  stripShowCount_m++;
+  if (hook_m) hook_m(&c, 1, brightness);
+  uint32_t us = hostWireMicros(c);
+  wireTotalUs_m += us;
+  if (showAdvancesClock_m) host::advanceMicros(us);
+}
+
+void CLEDController::showLeds(uint8_t brightness) { FastLED.sendStrip(*this, brightness); }
+
+void CFastLED::clear(bool writeData)
+{
+  for (uint8_t i = 0; i < nControllers_m; i++) fill_solid(controllers_m[i].leds_m, controllers_m[i].nLeds_m, CRGB(0, 0, 0));
+  if (writeData) show(0);
+}
+
+int CFastLED::size() { return nControllers_m ? controllers_m[0].nLeds_m : 0; }
+
+void CFastLED::hostReset()
+{
+  nControllers_m = 0;
+  brightness_m = 255;
+  showCount_m = 0;
+  stripShowCount_m = 0;
+  wireTotalUs_m = 0;
+  showAdvancesClock_m = false;
+  parallel_m = false;
+  hook_m = 0;
+}
@@ -0,0 +1,356 @@
+//// FastLED.h (host stand-in)
+// The subset of FastLED 3.x used by the totem sketch, for Linux builds
+//
+// The 8-bit maths (scale8, sin8, beatsin8, hsv2rgb_rainbow, palettes, ...)
+// follows FastLED's portable C implementations so host output matches the
+// pole. FastLED.show() transmits nothing; it counts calls, models the
+// WS2812 wire time and can hand the frame to a host tool via a hook.
+#ifndef HOST_FASTLED_H
+#define HOST_FASTLED_H
+
+#include "Arduino.h"
+
+typedef uint8_t  fract8;
+typedef uint16_t fract16;
+typedef uint16_t accum88;
+
+#define GET_MILLIS millis
+
+/******************************/
+/*          LIB8TION          */
+/******************************/
+inline uint8_t qadd8(uint8_t i, uint8_t j) { unsigned t = i + j; return t > 255 ? 255 : (uint8_t)t; }
+inline uint8_t qsub8(uint8_t i, uint8_t j) { int t = i - j; return t < 0 ? 0 : (uint8_t)t; }
+inline uint8_t add8(uint8_t i, uint8_t j) { return (uint8_t)(i + j); }
+inline uint8_t sub8(uint8_t i, uint8_t j) { return (uint8_t)(i - j); }
+inline uint8_t avg8(uint8_t i, uint8_t j) { return (uint8_t)((i + j) >> 1); }
+inline uint8_t mul8(uint8_t i, uint8_t j) { return (uint8_t)(i * j); }
+inline uint8_t abs8(int8_t i) { return (uint8_t)(i < 0 ? -i : i); }
+
+// FASTLED_SCALE8_FIXED semantics: scale8(255, 255) == 255
+inline uint8_t scale8(uint8_t i, fract8 scale) { return (uint8_t)(((uint16_t)i * (1 + (uint16_t)scale)) >> 8); }
+inline uint8_t scale8_video(uint8_t i, fract8 scale) { return (uint8_t)((((int)i * (int)scale) >> 8) + ((i && scale) ? 1 : 0)); }
+inline uint16_t scale16(uint16_t i, fract16 scale) { return (uint16_t)(((uint32_t)i * (1 + (uint32_t)scale)) >> 16); }
+inline uint16_t scale16by8(uint16_t i, fract8 scale) { return (uint16_t)((i * (1 + ((uint16_t)scale))) >> 8); }
+
+inline void nscale8x3(uint8_t &r, uint8_t &g, uint8_t &b, fract8 scale)
+{
+  uint16_t s = 1 + (uint16_t)scale;
+  r = (uint8_t)((r * s) >> 8); g = (uint8_t)((g * s) >> 8); b = (uint8_t)((b * s) >> 8);
+}
+inline void nscale8x3_video(uint8_t &r, uint8_t &g, uint8_t &b, fract8 scale)
+{
+  uint8_t nz = scale ? 1 : 0;
+  r = (r == 0) ? 0 : (uint8_t)(((int)r * (int)scale) >> 8) + nz;
+  g = (g == 0) ? 0 : (uint8_t)(((int)g * (int)scale) >> 8) + nz;
+  b = (b == 0) ? 0 : (uint8_t)(((int)b * (int)scale) >> 8) + nz;
+}
+
+inline uint8_t lerp8by8(uint8_t a, uint8_t b, fract8 frac)
+{
+  if (b > a) return a + scale8(b - a, frac);
+  return a - scale8(a - b, frac);
+}
+inline uint8_t blend8(uint8_t a, uint8_t b, uint8_t amountOfB)
+{
+  uint16_t partial = (a << 8) | b;
+  partial += (b * amountOfB);
+  partial -= (a * amountOfB);
+  return (uint8_t)(partial >> 8);
+}
+
+uint8_t sin8(uint8_t theta);
+inline uint8_t cos8(uint8_t theta) { return sin8(theta + 64); }
+int16_t sin16(uint16_t theta);
+inline int16_t cos16(uint16_t theta) { return sin16(theta + 16384); }
+inline uint8_t ease8InOutQuad(uint8_t i)
+{
+  uint8_t j = i;
+  if (j & 0x80) j = 255 - j;
+  uint8_t jj = scale8(j, j);
+  uint8_t jj2 = jj << 1;
+  if (i & 0x80) jj2 = 255 - jj2;
+  return jj2;
+}
+inline uint8_t quadwave8(uint8_t in) { return ease8InOutQuad(in & 0x80 ? 255 - ((in & 0x7F) << 1) : (in << 1)); }
+inline uint8_t triwave8(uint8_t in) { if (in & 0x80) in = 255 - in; return in << 1; }
+
+/******************************/
+/*          RANDOM            */
+/******************************/
+#define RAND16_SEED  1337
+extern uint16_t rand16seed;
+#define FASTLED_RAND16_2053  ((uint16_t)(2053))
+#define FASTLED_RAND16_13849 ((uint16_t)(13849))
+
+inline uint8_t random8()
+{
+  rand16seed = (rand16seed * FASTLED_RAND16_2053) + FASTLED_RAND16_13849;
+  return (uint8_t)(((uint8_t)(rand16seed & 0xFF)) + ((uint8_t)(rand16seed >> 8)));
+}
+inline uint8_t random8(uint8_t lim) { return (uint8_t)((random8() * (uint16_t)lim) >> 8); }
+inline uint8_t random8(uint8_t min, uint8_t lim) { return random8(lim - min) + min; }
+inline uint16_t random16()
+{
+  rand16seed = (rand16seed * FASTLED_RAND16_2053) + FASTLED_RAND16_13849;
+  return rand16seed;
+}
+inline uint16_t random16(uint16_t lim) { return (uint16_t)(((uint32_t)random16() * lim) >> 16); }
+inline uint16_t random16(uint16_t min, uint16_t lim) { return random16(lim - min) + min; }
+inline void random16_set_seed(uint16_t seed) { rand16seed = seed; }
+inline uint16_t random16_get_seed() { return rand16seed; }
+inline void random16_add_entropy(uint16_t entropy) { rand16seed += entropy; }
+
+/******************************/
+/*          BEATS             */
+/******************************/
+inline uint16_t beat88(accum88 beats_per_minute_88, uint32_t timebase = 0)
+{
+  return (uint16_t)(((GET_MILLIS() - timebase) * beats_per_minute_88 * 280) >> 16);
+}
+inline uint16_t beat16(accum88 beats_per_minute, uint32_t timebase = 0)
+{
+  if (beats_per_minute < 256) beats_per_minute <<= 8;
+  return beat88(beats_per_minute, timebase);
+}
+inline uint8_t beat8(accum88 beats_per_minute, uint32_t timebase = 0) { return beat16(beats_per_minute, timebase) >> 8; }
+
+inline uint8_t beatsin8(accum88 beats_per_minute, uint8_t lowest = 0, uint8_t highest = 255,
+                        uint32_t timebase = 0, uint8_t phase_offset = 0)
+{
+  uint8_t beat = beat8(beats_per_minute, timebase);
+  uint8_t beatsin = sin8(beat + phase_offset);
+  uint8_t rangewidth = highest - lowest;
+  return lowest + scale8(beatsin, rangewidth);
+}
+inline uint16_t beatsin16(accum88 beats_per_minute, uint16_t lowest = 0, uint16_t highest = 65535,
+                          uint32_t timebase = 0, uint16_t phase_offset = 0)
+{
+  uint16_t beat = beat16(beats_per_minute, timebase);
+  uint16_t beatsin = (uint16_t)(sin16(beat + phase_offset) + 32768);
+  uint16_t rangewidth = highest - lowest;
+  return lowest + scale16(beatsin, rangewidth);
+}
+
+/******************************/
+/*          COLOURS           */
+/******************************/
+struct CRGB;
+
+struct CHSV
+{
+  union {
+    struct { union { uint8_t hue; uint8_t h; }; union { uint8_t saturation; uint8_t sat; uint8_t s; }; union { uint8_t value; uint8_t val; uint8_t v; }; };
+    uint8_t raw[3];
+  };
+  CHSV() {}
+  CHSV(uint8_t ih, uint8_t is, uint8_t iv) : h(ih), s(is), v(iv) {}
+};
+
+void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb);
+
+struct CRGB
+{
+  union {
+    struct { union { uint8_t r; uint8_t red; }; union { uint8_t g; uint8_t green; }; union { uint8_t b; uint8_t blue; }; };
+    uint8_t raw[3];
+  };
+
+  uint8_t &operator[](uint8_t x) { return raw[x]; }
+  const uint8_t &operator[](uint8_t x) const { return raw[x]; }
+
+  CRGB() {}
+  CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+  CRGB(uint32_t colorcode) : r((colorcode >> 16) & 0xFF), g((colorcode >> 8) & 0xFF), b(colorcode & 0xFF) {}
+  CRGB(const CHSV &rhs) { hsv2rgb_rainbow(rhs, *this); }
+
+  CRGB &operator=(const CHSV &rhs) { hsv2rgb_rainbow(rhs, *this); return *this; }
+  CRGB &operator=(uint32_t colorcode) { r = (colorcode >> 16) & 0xFF; g = (colorcode >> 8) & 0xFF; b = colorcode & 0xFF; return *this; }
+  CRGB &setRGB(uint8_t nr, uint8_t ng, uint8_t nb) { r = nr; g = ng; b = nb; return *this; }
+  CRGB &setHSV(uint8_t hue, uint8_t sat, uint8_t val) { hsv2rgb_rainbow(CHSV(hue, sat, val), *this); return *this; }
+  CRGB &setHue(uint8_t hue) { return setHSV(hue, 255, 255); }
+
+  CRGB &operator+=(const CRGB &rhs) { r = qadd8(r, rhs.r); g = qadd8(g, rhs.g); b = qadd8(b, rhs.b); return *this; }
+  CRGB &operator-=(const CRGB &rhs) { r = qsub8(r, rhs.r); g = qsub8(g, rhs.g); b = qsub8(b, rhs.b); return *this; }
+  CRGB &addToRGB(uint8_t d) { r = qadd8(r, d); g = qadd8(g, d); b = qadd8(b, d); return *this; }
+  CRGB &nscale8(uint8_t scaledown) { nscale8x3(r, g, b, scaledown); return *this; }
+  CRGB &nscale8_video(uint8_t scaledown) { nscale8x3_video(r, g, b, scaledown); return *this; }
+  CRGB &fadeToBlackBy(uint8_t fadefactor) { nscale8x3(r, g, b, 255 - fadefactor); return *this; }
+  CRGB &fadeLightBy(uint8_t fadefactor) { nscale8x3_video(r, g, b, 255 - fadefactor); return *this; }
+  CRGB &operator%=(uint8_t scaledown) { nscale8x3_video(r, g, b, scaledown); return *this; }
+  CRGB &operator|=(const CRGB &rhs) { if (rhs.r > r) r = rhs.r; if (rhs.g > g) g = rhs.g; if (rhs.b > b) b = rhs.b; return *this; }
+
+  explicit operator bool() const { return r || g || b; }
+  uint8_t getAverageLight() const { return (uint8_t)(((uint16_t)r + g + b) / 3); }
+
+  typedef enum {
+    Aqua = 0x00FFFF, Aquamarine = 0x7FFFD4, Black = 0x000000, Blue = 0x0000FF,
+    CadetBlue = 0x5F9EA0, CornflowerBlue = 0x6495ED, DarkBlue = 0x00008B, DarkCyan = 0x008B8B,
+    DarkGreen = 0x006400, DarkOliveGreen = 0x556B2F, DarkOrange = 0xFF8C00, DarkRed = 0x8B0000,
+    ForestGreen = 0x228B22, Gold = 0xFFD700, Green = 0x008000, LawnGreen = 0x7CFC00,
+    LightBlue = 0xADD8E6, LightGreen = 0x90EE90, LightSkyBlue = 0x87CEFA, LimeGreen = 0x32CD32,
+    Maroon = 0x800000, MediumAquamarine = 0x66CDAA, MediumBlue = 0x0000CD, MidnightBlue = 0x191970,
+    Navy = 0x000080, OliveDrab = 0x6B8E23, Orange = 0xFFA500, OrangeRed = 0xFF4500,
+    Purple = 0x800080, Red = 0xFF0000, SeaGreen = 0x2E8B57, SkyBlue = 0x87CEEB,
+    Teal = 0x008080, White = 0xFFFFFF, Yellow = 0xFFFF00, YellowGreen = 0x9ACD32
+  } HTMLColorCode;
+};
+
+inline bool operator==(const CRGB &a, const CRGB &b) { return a.r == b.r && a.g == b.g && a.b == b.b; }
+inline bool operator!=(const CRGB &a, const CRGB &b) { return !(a == b); }
+inline CRGB operator+(const CRGB &a, const CRGB &b) { CRGB t = a; t += b; return t; }
+
+/******************************/
+/*         PALETTES           */
+/******************************/
+typedef uint32_t TProgmemRGBPalette16[16];
+typedef enum { NOBLEND = 0, LINEARBLEND = 1 } TBlendType;
+
+class CRGBPalette16
+{
+  public:
+    CRGB entries[16];
+    CRGBPalette16() {}
+    CRGBPalette16(const TProgmemRGBPalette16 &rhs) { for (uint8_t i = 0; i < 16; i++) entries[i] = CRGB(rhs[i]); }
+    CRGBPalette16 &operator=(const TProgmemRGBPalette16 &rhs) { for (uint8_t i = 0; i < 16; i++) entries[i] = CRGB(rhs[i]); return *this; }
+    CRGB &operator[](uint8_t x) { return entries[x]; }
+    const CRGB &operator[](uint8_t x) const { return entries[x]; }
+    bool operator==(const CRGBPalette16 &rhs) const { return memcmp(entries, rhs.entries, sizeof(entries)) == 0; }
+    bool operator!=(const CRGBPalette16 &rhs) const { return !(*this == rhs); }
+};
+
+extern const TProgmemRGBPalette16 CloudColors_p;
+extern const TProgmemRGBPalette16 LavaColors_p;
+extern const TProgmemRGBPalette16 OceanColors_p;
+extern const TProgmemRGBPalette16 ForestColors_p;
+extern const TProgmemRGBPalette16 RainbowColors_p;
+extern const TProgmemRGBPalette16 PartyColors_p;
+extern const TProgmemRGBPalette16 HeatColors_p;
+
+CRGB ColorFromPalette(const CRGBPalette16 &pal, uint8_t index, uint8_t brightness = 255, TBlendType blendType = LINEARBLEND);
+
+/******************************/
+/*     ARRAY COLOUR UTILS     */
+/******************************/
+void fill_solid(CRGB *leds, int numToFill, const CRGB &color);
+void fill_rainbow(CRGB *pFirstLED, int numToFill, uint8_t initialhue, uint8_t deltahue = 5);
+void nscale8(CRGB *leds, uint16_t num_leds, uint8_t scale);
+void nscale8_video(CRGB *leds, uint16_t num_leds, uint8_t scale);
+void fadeToBlackBy(CRGB *leds, uint16_t num_leds, uint8_t fadeBy);
+void fadeLightBy(CRGB *leds, uint16_t num_leds, uint8_t fadeBy);
+CRGB blend(const CRGB &p1, const CRGB &p2, fract8 amountOfP2);
+CRGB &nblend(CRGB &existing, const CRGB &overlay, fract8 amountOfOverlay);
+
+/******************************/
+/*      TIMING HELPERS        */
+/******************************/
+class CEveryNMillis
+{
+  public:
+    CEveryNMillis(uint32_t period) : prevTrigger_m(GET_MILLIS()), period_m(period) {}
+    bool ready()
+    {
+      bool isReady = (GET_MILLIS() - prevTrigger_m) >= period_m;
+      if (isReady) prevTrigger_m = GET_MILLIS();
+      return isReady;
+    }
+    operator bool() { return ready(); }
+  private:
+    uint32_t prevTrigger_m;
+    uint32_t period_m;
+};
+#define CONCAT_HELPER(x, y) x##y
+#define CONCAT_MACRO(x, y) CONCAT_HELPER(x, y)
+#define EVERY_N_MILLISECONDS(N) EVERY_N_MILLISECONDS_I(CONCAT_MACRO(PER, __COUNTER__), N)
+#define EVERY_N_MILLISECONDS_I(NAME, N) static CEveryNMillis NAME(N); if (NAME)
+#define EVERY_N_MILLIS(N) EVERY_N_MILLISECONDS(N)
+
+/******************************/
+/*     CONTROLLER / OUTPUT    */
+/******************************/
+enum EOrder { RGB = 0012, RBG = 0021, GRB = 0102, GBR = 0120, BRG = 0201, BGR = 0210 };
+
+typedef enum { TypicalSMD5050 = 0xFFB0F0, TypicalLEDStrip = 0xFFB0F0, UncorrectedColor = 0xFFFFFF } LEDColorCorrection;
+typedef enum { OvercastSky = 0xC9E2FF, DirectSunlight = 0xFFFFFF, UncorrectedTemperature = 0xFFFFFF } ColorTemperature;
+
+template<uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2812B {};
+template<uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2812 {};
+template<uint8_t DATA_PIN, EOrder RGB_ORDER> class NEOPIXEL {};
+
+class CLEDController
+{
+  public:
+    CLEDController() : leds_m(0), nLeds_m(0), dataPin_m(0) {}
+    CLEDController &setCorrection(LEDColorCorrection) { return *this; }
+    CLEDController &setCorrection(CRGB) { return *this; }
+    CLEDController &setTemperature(ColorTemperature) { return *this; }
+    CLEDController &setDither(uint8_t = 0) { return *this; }
+    void showLeds(uint8_t brightness = 255);                // sends just this strip
+    CRGB *leds() { return leds_m; }
+    int size() const { return nLeds_m; }
+    uint8_t dataPin() const { return dataPin_m; }
+
+    CRGB *leds_m;
+    int nLeds_m;
+    uint8_t dataPin_m;
+};
+
+// Called from FastLED.show() with the scaled-by-brightness intent left to the tool
+typedef void (*HostShowHook)(const CLEDController *controllers, uint8_t count, uint8_t brightness);
+
+class CFastLED
+{
+  public:
+    static const uint8_t MAX_CONTROLLERS = 8;
+
+    template<template<uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+    CLEDController &addLeds(CRGB *data, int nLedsOrOffset, int nLedsIfOffset = 0)
+    {
+      return addController(DATA_PIN, nLedsIfOffset > 0 ? data + nLedsOrOffset : data,
+                           nLedsIfOffset > 0 ? nLedsIfOffset : nLedsOrOffset);
+    }
+
+    void setBrightness(uint8_t scale) { brightness_m = scale; }
+    uint8_t getBrightness() { return brightness_m; }
+    void setTemperature(ColorTemperature) {}
+    void setCorrection(LEDColorCorrection) {}
+    void setDither(uint8_t = 0) {}
+    void setMaxRefreshRate(uint16_t, bool = false) {}
+
+    void show() { show(brightness_m); }
+    void show(uint8_t scale);
+    void clear(bool writeData = false);
+    int size();
+    int count() { return nControllers_m; }
+    CLEDController &operator[](int x) { return controllers_m[x]; }
+    CRGB *leds() { return nControllers_m ? controllers_m[0].leds_m : 0; }
+
+    // host only
+    void hostReset();                                       // forget controllers and counters
+    void hostSetShowHook(HostShowHook hook) { hook_m = hook; }
+    void hostSetShowAdvancesClock(bool on) { showAdvancesClock_m = on; }  // model blocking transmission
+    void hostSetParallelOutput(bool on) { parallel_m = on; }  // show() sends all strips at once
+    unsigned long hostShowCount() const { return showCount_m; }
+    unsigned long hostStripShowCount() const { return stripShowCount_m; }   // CLEDController::showLeds() calls
+    uint32_t hostWireMicros() const;                        // modelled WS2812 time for one show()
+    uint32_t hostWireMicros(const CLEDController &c) const { return c.nLeds_m * 30UL + 50; }   // and one strip
+    uint64_t hostWireTotalMicros() const { return wireTotalUs_m; }  // spent sending since hostReset()
+
+  private:
+    friend class CLEDController;
+    CLEDController &addController(uint8_t pin, CRGB *data, int nLeds);
+    void sendStrip(const CLEDController &c, uint8_t brightness);
+
+    CLEDController controllers_m[MAX_CONTROLLERS];
+    uint8_t nControllers_m = 0;
+    uint8_t brightness_m = 255;
+    unsigned long showCount_m = 0;
+    unsigned long stripShowCount_m = 0;
+    uint64_t wireTotalUs_m = 0;
+    bool showAdvancesClock_m = false;
+    bool parallel_m = false;
+    HostShowHook hook_m = 0;
+};
+extern CFastLED FastLED;
+
+#endif /* HOST_FASTLED_H */
@@ -0,0 +1,44 @@
+//// Udp.h (host stand-in)
+// The Arduino core's UDP interface, and IPAddress, for code that takes any
+// network library's UDP (WiFiUDP, EthernetUDP, ...)
+#ifndef HOST_UDP_H
+#define HOST_UDP_H
+
+#include <Arduino.h>
+
+class IPAddress
+{
+  public:
+    IPAddress() : addr_m(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr_m(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+    explicit IPAddress(uint32_t addr) : addr_m(addr) {}
+    operator uint32_t() const { return addr_m; }      // network order, as the Arduino one
+    uint8_t operator[](int i) const { return addr_m >> (8 * i); }
+    bool operator==(const IPAddress &o) const { return addr_m == o.addr_m; }
+  private:
+    uint32_t addr_m;
+};
+
+class UDP
+{
+  public:
+    virtual ~UDP() {}
+    virtual uint8_t begin(uint16_t port) = 0;     // 1 if listening
+    virtual void stop() = 0;
+
+    virtual int beginPacket(IPAddress ip, uint16_t port) = 0;
+    virtual int endPacket() = 0;                  // sends it; 1 if it went
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t *buf, size_t n) = 0;
+
+    virtual int parsePacket() = 0;                // size of the next packet waiting, 0 if none
+    virtual int available() = 0;                  // of it, still to read
+    virtual int read() = 0;
+    virtual int read(unsigned char *buf, size_t n) = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;                     // done with the packet
+    virtual IPAddress remoteIP() = 0;
+    virtual uint16_t remotePort() = 0;
+};
+
+#endif /* HOST_UDP_H */
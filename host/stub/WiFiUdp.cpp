@@ -0,0 +1,81 @@
+#include "WiFiUdp.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int WiFiUDP::socket()
+{
+  if (fd_m < 0) {
+    fd_m = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_m >= 0) fcntl(fd_m, F_SETFL, O_NONBLOCK);
+  }
+  return fd_m;
+}
+
+uint8_t WiFiUDP::begin(uint16_t port)
+{
+  stop();
+  if (socket() < 0) return 0;
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd_m, (sockaddr *)&addr, sizeof(addr)) < 0) { stop(); return 0; }
+  return 1;
+}
+
+void WiFiUDP::stop()
+{
+  if (fd_m >= 0) close(fd_m);
+  fd_m = -1;
+  rx_m.clear();
+  at_m = 0;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
+{
+  tx_m.clear();
+  txIP_m = ip;
+  txPort_m = port;
+  return socket() >= 0;
+}
+
+int WiFiUDP::endPacket()
+{
+  if (socket() < 0) return 0;
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(txPort_m);
+  addr.sin_addr.s_addr = (uint32_t)txIP_m;
+  ssize_t n = sendto(fd_m, tx_m.data(), tx_m.size(), 0, (sockaddr *)&addr, sizeof(addr));
+  tx_m.clear();
+  return n >= 0;
+}
+
+int WiFiUDP::parsePacket()
+{
+  rx_m.clear();
+  at_m = 0;
+  if (fd_m < 0) return 0;
+  uint8_t buf[2048];
+  sockaddr_in from = {};
+  socklen_t fromLen = sizeof(from);
+  ssize_t n = recvfrom(fd_m, buf, sizeof(buf), 0, (sockaddr *)&from, &fromLen);
+  if (n <= 0) return 0;
+  rx_m.assign(buf, buf + n);
+  remoteIP_m = IPAddress((uint32_t)from.sin_addr.s_addr);
+  remotePort_m = ntohs(from.sin_port);
+  return n;
+}
+
+int WiFiUDP::read(unsigned char *buf, size_t n)
+{
+  size_t left = rx_m.size() - at_m;
+  if (n > left) n = left;
+  memcpy(buf, rx_m.data() + at_m, n);
+  at_m += n;
+  return n;
+}
@@ -0,0 +1,52 @@
+//// WiFiUdp.h (host stand-in)
+// WiFiUDP on Linux sockets, so OSC can be tried from a real client
+//
+// Works as the Arduino one does (parsePacket() never waits, packets are
+// read a piece at a time), bound to 127.0.0.1 so only local programs (or
+// a host tool playing the phone) can reach it. Unlike the virtual clock,
+// the network is real: packets arrive as fast as they're sent.
+#ifndef HOST_WIFIUDP_H
+#define HOST_WIFIUDP_H
+
+#include "Udp.h"
+
+#include <vector>
+
+class WiFiUDP : public UDP
+{
+  public:
+    WiFiUDP() : fd_m(-1), at_m(0), remotePort_m(0), txPort_m(0) {}
+    ~WiFiUDP() { stop(); }
+
+    uint8_t begin(uint16_t port);
+    void stop();
+
+    int beginPacket(IPAddress ip, uint16_t port);
+    int endPacket();
+    size_t write(uint8_t b) { return write(&b, 1); }
+    size_t write(const uint8_t *buf, size_t n) { tx_m.insert(tx_m.end(), buf, buf + n); return n; }
+
+    int parsePacket();
+    int available() { return rx_m.size() - at_m; }
+    int read() { return at_m < rx_m.size() ? rx_m[at_m++] : -1; }
+    int read(unsigned char *buf, size_t n);
+    int peek() { return at_m < rx_m.size() ? rx_m[at_m] : -1; }
+    void flush() { at_m = rx_m.size(); }
+    IPAddress remoteIP() { return remoteIP_m; }
+    uint16_t remotePort() { return remotePort_m; }
+
+    static IPAddress localhost() { return IPAddress(127, 0, 0, 1); }
+
+  private:
+    int socket();
+    int fd_m;
+    std::vector<uint8_t> rx_m;
+    size_t at_m;
+    IPAddress remoteIP_m;
+    uint16_t remotePort_m;
+    std::vector<uint8_t> tx_m;
+    IPAddress txIP_m;
+    uint16_t txPort_m;
+};
+
+#endif /* HOST_WIFIUDP_H */
@@ -0,0 +1,283 @@
+//// AudioBeat.h
+// Finds the beat in the mic signal, a little at a time
+//
+// The ADC runs free on the mic pin and its interrupt pushes samples into a
+// small ring buffer (about 2.4 kHz, 8 bit). update() works through what has
+// arrived a slice at a time, so a frame is never held up:
+//  - per sample: Goertzel filters pick out three bands (kick, snare, hats)
+//  - per block of 48 samples (~20 ms): the log band energies are compared
+//    with the last block's, and the rises summed into an onset strength
+//  - the onset strength feeds a leaky autocorrelation over the lags for
+//    70..188 BPM, whose (weighted, interpolated) peak is the tempo
+// Onsets are reported with the time they happened, so Control can pull the
+// beat clock onto them. All fixed point; no float, no division per sample.
+#ifndef AUDIOBEAT_H
+#define AUDIOBEAT_H
+
+#include <Arduino.h>
+#include "SpscQueue.h"
+
+class AudioBeat
+{
+  public:
+    static const uint8_t adcDecimation = 4;         // ADC conversions averaged per sample
+    static const uint16_t samplePeriodUs = 416;     // 16 MHz / 128 prescale / 13 cycles / 4 conversions
+    static const uint8_t blockSize = 48;            // samples per onset value
+    static const uint32_t blockUs = (uint32_t)blockSize * samplePeriodUs;
+    static const uint8_t numBands = 3;
+    static const uint8_t minLag = 16;               // blocks per beat: 16 = 188 BPM ..
+    static const uint8_t maxLag = 43;               // .. 43 = 70 BPM
+    static const uint8_t numLags = maxLag - minLag + 1;
+    static const uint8_t sliceSamples = 32;         // most samples worked through per update()
+    static const uint8_t ringSize = 64;             // power of two
+    static const uint8_t silentLevel = 80;          // log2 band power * 8 below which a band is ignored
+
+    AudioBeat() { reset(); }
+
+    void reset()
+    {
+      adcSum_m = 0;
+      adcCount_m = 0;
+      holdUs_m = 0;
+      lastSample_m = 128;
+      fromAdc_m = false;
+      inBlock_m = 0;
+      blocks_m = 0;
+      memset(s1_m, 0, sizeof(s1_m));
+      memset(s2_m, 0, sizeof(s2_m));
+      memset(level_m, 0, sizeof(level_m));
+      memset(history_m, 0, sizeof(history_m));
+      historyHead_m = 0;
+      memset(acc_m, 0, sizeof(acc_m));
+      energy_m = 0;
+      fluxMean16_m = 0;
+      envMean16_m = 0;
+      lastOnsetBlock_m = 0;
+      onsetUs_m = 0;
+      periodUs_m = 0;
+      confidence_m = 0;
+    }
+
+    /******************************/
+    /*   PRODUCER (ISR OR HOST)   */
+    /******************************/
+    // One sample at samplePeriodUs, 128 = silence. Safe from an interrupt.
+    void push(uint8_t sample)
+    {
+      ring_m.push(sample);    // dropped if update() fell behind
+      lastSample_m = sample;
+    }
+
+    // One ADC conversion (left adjusted, ADCH); every adcDecimation make a sample
+    void sampleAdc(uint8_t adch)
+    {
+      adcSum_m += adch;
+      if (++adcCount_m == adcDecimation) {
+        push(adcSum_m / adcDecimation);
+        adcSum_m = 0;
+        adcCount_m = 0;
+      }
+    }
+
+#if defined(__AVR__)
+    // Free running ADC on pin, with the conversion complete interrupt on.
+    // The interrupt handler (in Control.cpp) passes ADCH to sampleAdc().
+    // Nothing else may use analogRead() while this runs.
+    void startSampling(uint8_t pin)
+    {
+      if (pin >= 18) pin -= 18;           // as analogRead() on the 32u4
+      uint8_t channel = analogPinToChannel(pin);
+      ADCSRB = (ADCSRB & ~((1 << MUX5) | 0x07)) | (((channel >> 3) & 0x01) << MUX5);  // free running
+      ADMUX = (1 << REFS0) | (1 << ADLAR) | (channel & 0x07);                         // AVcc, 8 bit in ADCH
+      ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADATE) | (1 << ADIE) | 0x07;         // /128 prescale
+      fromAdc_m = true;
+    }
+#else
+    void startSampling(uint8_t) {}      // host tools push() samples themselves
+#endif
+
+    // FastLED.show() keeps interrupts off for ~30 us per LED, and the ADC
+    // conversions in that time are lost. Hold the last sample over the gap
+    // so the sample count still tracks real time (and so the tempo). us is
+    // the wire time (Shards::wireUs), not micros() around show(): Timer0's
+    // overflow interrupt is held off too, so micros() loses the time.
+    // Called from loop(), so each push is made with the ADC interrupt held
+    // off: the ring has one producer, and the ISR must not push in between.
+    void interruptsOffFor(uint32_t us)
+    {
+      if (!fromAdc_m) return;
+      holdUs_m += us;
+      while (holdUs_m >= samplePeriodUs) {
+        holdUs_m -= samplePeriodUs;
+        noInterrupts();
+        push(lastSample_m);
+        interrupts();
+      }
+    }
+
+    /******************************/
+    /*          CONSUMER          */
+    /******************************/
+    // Call every loop. Works through up to sliceSamples samples; true if an
+    // onset was found, see onsetUs().
+    bool update(unsigned long nowUs)
+    {
+      bool onset = false;
+      uint8_t sample;
+      for (uint8_t n = 0; n < sliceSamples && ring_m.pop(sample); n++) {
+        int16_t x = (int16_t)sample - 128;
+        for (uint8_t b = 0; b < numBands; b++) {
+          int32_t s0 = x + ((coeff(b) * s1_m[b]) >> 14) - s2_m[b];
+          s2_m[b] = s1_m[b];
+          s1_m[b] = s0;
+        }
+        if (++inBlock_m == blockSize) {
+          inBlock_m = 0;
+          if (endBlock()) {
+            // the onset was somewhere in the block just finished, and the samples still queued arrived after it
+            onsetUs_m = nowUs - (uint32_t)(ring_m.size() + blockSize / 2) * samplePeriodUs;
+            onset = true;
+          }
+        }
+      }
+      return onset;
+    }
+
+    unsigned long onsetUs() const { return onsetUs_m; }   // micros() the last onset happened
+    uint32_t periodUs() const { return periodUs_m; }      // tempo found, 0 if none yet
+    uint8_t confidence() const { return confidence_m; }   // 0..255, how clearly periodic the onsets are
+    bool locked() const { return periodUs_m && confidence_m >= 128; }
+    uint16_t bpm() const { return periodUs_m ? (60000000UL + periodUs_m / 2) / periodUs_m : 0; }
+    uint8_t overruns() const { return ring_m.dropped(); } // samples dropped because update() fell behind (wraps)
+    uint16_t blocks() const { return blocks_m; }
+
+  private:
+    // 2 cos(2 pi k / blockSize) in Q14 for bins k = 2, 4, 16: 100, 200 and 800 Hz
+    static int32_t coeff(uint8_t b)
+    {
+      return b == 0 ? 31651L : (b == 1 ? 28378L : -16384L);
+    }
+    static uint8_t bandWeight(uint8_t b) { return b == 0 ? 2 : 1; }   // the kick carries the beat
+
+    // log2(v) * 8, to 1/8 of an octave
+    static uint8_t log2x8(uint32_t v)
+    {
+      if (v == 0) return 0;
+      uint8_t msb = 31;
+      while (!(v & 0x80000000UL)) { v <<= 1; msb--; }
+      return (msb << 3) | ((v >> 28) & 0x07);
+    }
+
+    // Block boundary: band energies, onset strength, autocorrelation, tempo.
+    // True if this block starts an onset.
+    bool endBlock()
+    {
+      uint16_t flux = 0;
+      for (uint8_t b = 0; b < numBands; b++) {
+        int32_t power = s1_m[b] * s1_m[b] + s2_m[b] * s2_m[b] - ((coeff(b) * s1_m[b]) >> 14) * s2_m[b];
+        uint8_t level = power > 0 ? log2x8(power) : 0;
+        if (level < silentLevel) level = silentLevel;
+        if (level > level_m[b]) flux += (level - level_m[b]) * bandWeight(b);
+        level_m[b] = level;
+        s1_m[b] = s2_m[b] = 0;
+      }
+
+      // onset strength is the rise above the running mean
+      uint16_t mean = fluxMean16_m >> 4;
+      fluxMean16_m += (int16_t)(flux - mean);
+      uint8_t env = flux > mean ? (flux - mean > 255 ? 255 : flux - mean) : 0;
+      uint8_t previous = history_m[historyHead_m];
+      if (++historyHead_m > maxLag) historyHead_m = 0;
+      history_m[historyHead_m] = env;
+      blocks_m++;
+
+      // leaky autocorrelation of the onset strength, ~2.5 s memory
+      if (env) {
+        energy_m += (uint16_t)env * env;
+        for (uint8_t l = 0; l < numLags; l++) {
+          uint8_t then = historyHead_m + (maxLag + 1) - (minLag + l);
+          if (then > maxLag) then -= maxLag + 1;
+          acc_m[l] += (uint16_t)env * history_m[then];
+        }
+      }
+      if ((blocks_m & 0x07) == 0) {
+        for (uint8_t l = 0; l < numLags; l++) acc_m[l] -= acc_m[l] >> 4;   // decays by 1/16 every 8 blocks
+        energy_m -= energy_m >> 4;
+        estimateTempo();
+      }
+
+      // an onset is a rise through twice the mean onset strength, with at least a quarter beat between onsets
+      uint16_t envMean = envMean16_m >> 4;
+      envMean16_m += (int16_t)(env - envMean);
+      uint16_t threshold = 2 * envMean + 4;
+      uint16_t gap = periodUs_m ? periodUs_m / (4 * blockUs) : minLag / 4;
+      if (env > threshold && previous <= threshold && (uint16_t)(blocks_m - lastOnsetBlock_m) >= gap) {
+        lastOnsetBlock_m = blocks_m;
+        return true;
+      }
+      return false;
+    }
+
+    void estimateTempo()
+    {
+      // peak of the autocorrelation, leaning gently towards 120 BPM (lag 25) to settle double/half tempo
+      uint32_t best = 0;
+      uint8_t bestLag = 0;
+      for (uint8_t l = 0; l < numLags; l++) {
+        uint8_t distance = l + minLag > 25 ? l + minLag - 25 : 25 - (l + minLag);
+        uint32_t score = (acc_m[l] >> 8) * (256 - 4 * distance);
+        if (score > best) { best = score; bestLag = l; }
+      }
+      // a beat every other onset (kick and snare on alternate beats) peaks at twice the lag: take the
+      // faster tempo if its own peak is at least half as strong
+      uint8_t half = (bestLag + minLag) / 2;
+      if (half > minLag && half < maxLag) {
+        uint8_t h = half - minLag;
+        uint8_t strongest = acc_m[h - 1] > acc_m[h] ? h - 1 : h;
+        if (acc_m[h + 1] > acc_m[strongest]) strongest = h + 1;
+        if (acc_m[strongest] >= acc_m[bestLag] / 2) bestLag = strongest;
+      }
+
+      // how much of the onset strength repeats at that lag: near 1 for a steady beat, low for noise
+      uint32_t peak = acc_m[bestLag];
+      if (peak == 0) { confidence_m = 0; return; }
+      confidence_m = peak >= energy_m ? 255 : (uint8_t)(peak / ((energy_m >> 8) + 1));
+
+      // parabolic interpolation between the neighbouring lags, in 1/16 lag
+      int32_t lag16 = (int32_t)(bestLag + minLag) * 16;
+      if (bestLag > 0 && bestLag < numLags - 1) {
+        int32_t a = acc_m[bestLag - 1] >> 8, b = acc_m[bestLag] >> 8, c = acc_m[bestLag + 1] >> 8;
+        int32_t curve = a - 2 * b + c;
+        if (curve < 0) lag16 += (8 * (a - c)) / curve;
+      }
+      periodUs_m = (uint32_t)lag16 * blockUs / 16;
+    }
+
+    SpscQueue<uint8_t, ringSize> ring_m;    // written by the interrupt
+    uint16_t adcSum_m;
+    uint8_t adcCount_m;
+    uint8_t lastSample_m;
+    uint32_t holdUs_m;      // a 2000 LED strip's gap is over 60 ms
+    bool fromAdc_m;
+
+    // Goertzel state for the block in progress
+    int32_t s1_m[numBands];
+    int32_t s2_m[numBands];
+    uint8_t inBlock_m;
+
+    uint16_t blocks_m;
+    uint8_t level_m[numBands];          // last block's band levels
+    uint16_t fluxMean16_m;              // means in 1/16
+    uint16_t envMean16_m;
+    uint8_t history_m[maxLag + 1];      // onset strength, by block
+    uint8_t historyHead_m;
+    uint32_t acc_m[numLags];            // autocorrelation by lag
+    uint32_t energy_m;                  // and at lag 0
+    uint16_t lastOnsetBlock_m;
+
+    unsigned long onsetUs_m;
+    uint32_t periodUs_m;
+    uint8_t confidence_m;
+};
+
+#endif /* AUDIOBEAT_H */
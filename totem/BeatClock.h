@@ -0,0 +1,201 @@
+//// BeatClock.h
+// Tap tempo beat clock with a continuous beat phase
+//
+// Beats fall on a fixed microsecond timeline (beat n at start + n * period),
+// so the loop's latency never adds to the period. Taps go into a ring
+// buffer of intervals; the tempo is the average of the intervals close to
+// their median, so one fumbled tap doesn't wreck it. Taps that agree with
+// the current tempo only nudge the phase towards them (a phase-locked loop)
+// rather than restarting the beat; a clearly different tempo, or the first
+// tap after a pause, restarts the beat on the tap. follow() does the same
+// more gently for beats found in the music.
+//
+// Beat and bar events are counters: each consumer remembers the last count
+// it saw, so any number of them can watch the beat without stealing it.
+#ifndef BEATCLOCK_H
+#define BEATCLOCK_H
+
+#include <Arduino.h>
+
+class BeatClock
+{
+  public:
+    static const uint8_t numTaps = 8;               // intervals averaged
+    static const uint8_t beatsPerBar = 4;
+    static const uint32_t minPeriodUs = 240000UL;   // 250 BPM, as OSC's /tempo; more wouldn't fit get_BPM()'s byte
+    static const uint32_t maxPeriodUs = 2000000UL;  // 30 BPM, a longer gap starts a new run of taps
+    static const uint8_t maxMissed = 4;             // onsets off the beat in a row before follow() jumps
+
+    BeatClock(uint32_t periodUs = 500000UL) : beatStart_m(0), nowUs_m(0), lastTap_m(0), nTaps_m(0), tapHead_m(0), offTempo_m(0), missed_m(0),
+                                              beats_m(0), bars_m(0), beatInBar_m(0), tapping_m(false)
+    {
+      setPeriod(periodUs);
+    }
+
+    // Call every loop. Fires a beat for every period boundary passed.
+    // A time a little in the past (a tap timestamped by an interrupt) is fine.
+    void update(unsigned long nowUs)
+    {
+      while ((int32_t)(nowUs - beatStart_m) >= (int32_t)periodUs_m) {
+        beatStart_m += periodUs_m;
+        nextBeat();
+      }
+      if ((int32_t)(nowUs - nowUs_m) > 0) nowUs_m = nowUs;
+    }
+
+    // Returns true if the tap restarted the beat (rather than nudging it)
+    bool tap(unsigned long nowUs)
+    {
+      update(nowUs);
+      uint32_t interval = nowUs - lastTap_m;
+      // a bounce or double tap: ignored, and not the tap the next interval is from
+      if (tapping_m && interval < minPeriodUs / 2) return false;
+      lastTap_m = nowUs;
+
+      if (!tapping_m || interval > maxPeriodUs) {
+        // first tap of a run: the beat is now
+        tapping_m = true;
+        nTaps_m = 0;
+        tapHead_m = 0;
+        offTempo_m = 0;
+        restartOn(nowUs);
+        return true;
+      }
+
+      // two off-tempo taps in a row means the tempo changed: forget the old intervals
+      offTempo_m = absDiff(interval, periodUs_m) > periodUs_m / 8 ? offTempo_m + 1 : 0;
+      if (offTempo_m >= 2) {
+        uint32_t previous = taps_m[(tapHead_m + numTaps - 1) % numTaps];
+        nTaps_m = 0;
+        tapHead_m = 0;
+        pushTap(previous);
+      }
+      pushTap(interval);
+
+      uint32_t estimate = tapEstimate();
+      if (absDiff(estimate, periodUs_m) > periodUs_m / 8) {
+        // a new tempo: follow it straight away
+        setPeriod(estimate);
+        restartOn(nowUs);
+        return true;
+      }
+
+      // same tempo: pull the phase half way towards the tap
+      beatStart_m += phaseError(nowUs) / 2;
+      setPeriod(estimate);
+      update(nowUs);
+      return false;
+    }
+
+    // Follow a beat heard rather than tapped (AudioBeat): ease the period
+    // towards periodUs, and the phase towards beatUs if it's near a beat.
+    // Onsets between the beats (hats, off-beat snares) are left alone,
+    // unless nothing has landed near a beat for a while, when the clock
+    // must be out of phase with the music and jumps onto the onset.
+    void follow(unsigned long nowUs, unsigned long beatUs, uint32_t periodUs)
+    {
+      update(nowUs);
+      int32_t error = phaseError(beatUs);
+      if ((uint32_t)(error < 0 ? -error : error) < periodUs_m / 6) {
+        beatStart_m += error / 4;
+        missed_m = 0;
+      } else if (++missed_m >= maxMissed) {
+        beatStart_m += error;
+        missed_m = 0;
+      }
+      setPeriod(periodUs_m - (int32_t)(periodUs_m - periodUs) / 4);
+      update(nowUs);
+    }
+
+    void setPeriod(uint32_t periodUs)
+    {
+      periodUs_m = constrain(periodUs, minPeriodUs, maxPeriodUs);
+      phaseScale_m = 0xFFFFFFFFUL / periodUs_m;
+    }
+    uint32_t periodUs() const { return periodUs_m; }
+    unsigned long nextBeatUs() const { return beatStart_m + periodUs_m; }    // as of the last update()
+
+    // 0..65535 through the current beat, as of the last update()
+    uint16_t phase() const
+    {
+      uint32_t elapsed = nowUs_m - beatStart_m;
+      if (elapsed >= periodUs_m) return 0xFFFF;
+      return (uint16_t)((elapsed * phaseScale_m) >> 16);   // elapsed < period, so this fits in 32 bits
+    }
+    uint16_t beats() const { return beats_m; }        // beat counter, wraps
+    uint8_t bars() const { return bars_m; }           // bar counter, wraps
+    uint8_t beatInBar() const { return beatInBar_m; }
+
+  private:
+    static uint32_t absDiff(uint32_t a, uint32_t b) { return a > b ? a - b : b - a; }
+
+    // how far t is from the nearest beat, -period/2..period/2
+    int32_t phaseError(unsigned long t) const
+    {
+      int32_t error = (int32_t)(t - beatStart_m) % (int32_t)periodUs_m;
+      if (error >= (int32_t)(periodUs_m / 2)) error -= periodUs_m;
+      else if (error < -(int32_t)(periodUs_m / 2)) error += periodUs_m;
+      return error;
+    }
+
+    void pushTap(uint32_t interval)
+    {
+      taps_m[tapHead_m] = interval;
+      tapHead_m = (tapHead_m + 1) % numTaps;
+      if (nTaps_m < numTaps) nTaps_m++;
+    }
+
+    void nextBeat()
+    {
+      beats_m++;
+      if (++beatInBar_m >= beatsPerBar) { beatInBar_m = 0; bars_m++; }
+    }
+
+    // the beat (and the bar) start on this tap
+    void restartOn(unsigned long nowUs)
+    {
+      beatStart_m = nowUs;
+      nowUs_m = nowUs;
+      beats_m++;
+      bars_m++;
+      beatInBar_m = 0;
+    }
+
+    // mean of the tap intervals within 1/4 of their median. taps_m[0..nTaps_m)
+    // are the run's: a new run starts the ring over at 0.
+    uint32_t tapEstimate() const
+    {
+      if (!nTaps_m) return periodUs_m;
+      uint32_t sorted[numTaps];
+      for (uint8_t i = 0; i < nTaps_m; i++) {
+        uint32_t v = taps_m[i];
+        uint8_t j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+      }
+      uint32_t median = sorted[nTaps_m / 2];
+      uint32_t sum = 0;
+      uint8_t n = 0;
+      for (uint8_t i = 0; i < nTaps_m; i++) {
+        if (absDiff(sorted[i], median) <= median / 4) { sum += sorted[i]; n++; }
+      }
+      return n ? sum / n : median;
+    }
+
+    uint32_t periodUs_m;
+    uint32_t phaseScale_m;      // 2^32 / period, so phase() needs no division
+    unsigned long beatStart_m;  // when the current beat started
+    unsigned long nowUs_m;
+    unsigned long lastTap_m;
+    uint32_t taps_m[numTaps];   // ring buffer of tap intervals
+    uint8_t nTaps_m;
+    uint8_t tapHead_m;
+    uint8_t offTempo_m;         // consecutive taps away from the current tempo
+    uint8_t missed_m;           // consecutive onsets away from the beat
+    uint16_t beats_m;
+    uint8_t bars_m;
+    uint8_t beatInBar_m;
+    bool tapping_m;
+};
+
+#endif /* BEATCLOCK_H */
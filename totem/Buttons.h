@@ -0,0 +1,210 @@
+//// Buttons.h
+// Interrupt driven buttons: edges in, press/long-press/repeat events out
+//
+// Pin change interrupts snapshot the button pins with a timestamp into a
+// lock-free queue (SpscQueue), so a press isn't missed however long the
+// loop is busy (FastLED.show() only holds the interrupt off until it's
+// done), and waits in the queue until the loop gets to it. On the Pro
+// Micro only pins 0, 1, 2, 3 and 7 can
+// interrupt, so the others are snapshotted from a 1 kHz tick (Timer0's
+// spare compare interrupt) instead, into the same queue.
+//
+// poll() drains the queue and runs each button through a table driven
+// state machine (see transition() below) - the loop does no pin reads at
+// all until a button moves. Debouncing takes the first edge (so taps are
+// timed from the moment of contact), ignores the bounce after it, then
+// reads the pin once to make sure the final level wasn't missed.
+// The pins, the timings and the state machine's table are all read from
+// flash; a button's state in SRAM is 7 bytes.
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+#include <Arduino.h>
+#include "SpscQueue.h"
+
+enum ButtonEventType : uint8_t {ButtonNone, ButtonPress, ButtonLongPress, ButtonRepeat, ButtonRelease};
+
+struct ButtonEvent
+{
+  uint8_t button;
+  ButtonEventType type;
+  uint16_t heldMs;        // how long it's been down (for long press and repeat)
+  unsigned long ms;       // millis() it happened
+};
+
+// How long a button is held before a long press, and then how often it repeats
+// (a table of them in flash, PROGMEM, one a button)
+struct ButtonTiming
+{
+  uint16_t holdMs;
+  uint16_t repeatMs;
+};
+
+template<uint8_t N>
+class Buttons
+{
+  public:
+    static const uint8_t debounceMs = 20;
+
+    // pins and timing are tables of N in flash (PROGMEM)
+    Buttons(const uint8_t *pins, const ButtonTiming *timing) : pins_m(pins), timing_m(timing), levels_m(0), scanned_m(0), tick_m(false)
+    {
+      memset(state_m, 0, sizeof(state_m));
+    }
+
+    // Pins pulled up (pressed = LOW), interrupts on
+    void begin()
+    {
+      active_s = this;
+      for (uint8_t i = 0; i < N; i++) {
+        pinMode(pin(i), INPUT_PULLUP);
+        int interrupt = digitalPinToInterrupt(pin(i));
+        if (interrupt == NOT_AN_INTERRUPT) tick_m = true;
+        else attachInterrupt(interrupt, &Buttons::isr, CHANGE);
+      }
+      levels_m = scanned_m = readPins();
+#if defined(__AVR__)
+      if (tick_m) {
+        OCR0B = 0x80;               // half way through Timer0's count, clear of millis()' overflow
+        TIMSK0 |= (1 << OCIE0B);
+      }
+#endif
+    }
+
+    // From an interrupt: queue a snapshot of the pins if any changed
+    void scan()
+    {
+      uint8_t levels = readPins();
+      if (levels == scanned_m) return;
+      scanned_m = levels;
+      Edge e = {(uint16_t)millis(), levels};
+      edges_m.push(e);
+    }
+    static void isr() { if (active_s) active_s->scan(); }
+    bool needsTick() const { return tick_m; }
+
+    // Hand each new event to handler(const ButtonEvent &). Call every loop;
+    // it returns straight away unless a button has moved or is held.
+    template<class Handler>
+    void poll(Handler handler)
+    {
+      unsigned long now = millis();
+      ButtonEvent event;
+      Edge e;
+      // edges first, in the order they happened
+      while (edges_m.pop(e)) {
+        uint8_t changed = e.levels ^ levels_m;
+        levels_m = e.levels;
+        for (uint8_t i = 0; i < N; i++) {
+          if (!(changed & (1 << i)) || state_m[i].settling) continue;   // bounce
+          state_m[i].settling = true;
+          state_m[i].edgeMs = e.ms;
+          bool down = !(e.levels & (1 << i));
+          if (down != (bool)state_m[i].down && step(i, down ? InputDown : InputUp, fullMs(now, e.ms), event)) handler(event);
+        }
+      }
+      // then the settled levels, and the hold/repeat timers
+      for (uint8_t i = 0; i < N; i++) {
+        State &s = state_m[i];
+        if (s.settling && (uint16_t)((uint16_t)now - s.edgeMs) >= debounceMs) {
+          s.settling = false;
+          bool down = digitalRead(pin(i)) == LOW;    // the bounce may have hidden the last edge
+          if (down != (bool)s.down && step(i, down ? InputDown : InputUp, now, event)) handler(event);
+        }
+        if (s.machine != Released && (int16_t)((uint16_t)now - s.timerMs) >= 0) {
+          if (step(i, InputTimer, now, event)) handler(event);
+        }
+      }
+    }
+
+    bool isDown(uint8_t button) const { return state_m[button].down; }
+    uint8_t dropped() const { return edges_m.dropped(); }
+
+  private:
+    enum Machine : uint8_t {Released, Pressed, Holding};
+    enum Input : uint8_t {InputDown, InputUp, InputTimer};
+
+    struct Transition
+    {
+      Machine next;
+      ButtonEventType event;
+    };
+    // [state][input]
+    static Transition transition(Machine m, Input in)
+    {
+      static const Transition table[3][3] PROGMEM = {
+        /*              down                      up                        timer */
+        /* Released */ {{Pressed, ButtonPress},   {Released, ButtonNone},   {Released, ButtonNone}},
+        /* Pressed  */ {{Pressed, ButtonNone},    {Released, ButtonRelease}, {Holding, ButtonLongPress}},
+        /* Holding  */ {{Holding, ButtonNone},    {Released, ButtonRelease}, {Holding, ButtonRepeat}},
+      };
+      Transition t;
+      memcpy_P(&t, &table[m][in], sizeof(t));
+      return t;
+    }
+
+    struct Edge
+    {
+      uint16_t ms;
+      uint8_t levels;     // bit per button, 1 = released (pulled up)
+    };
+
+    struct State
+    {
+      uint8_t machine : 2;    // a Machine
+      uint8_t down : 1;
+      uint8_t settling : 1;   // edge taken, ignoring bounce until debounceMs after it
+      uint16_t edgeMs;
+      uint16_t pressMs;
+      uint16_t timerMs;       // next long press/repeat
+    };
+
+    // Run the state machine; true (and event filled in) if it produced an event
+    bool step(uint8_t i, Input in, unsigned long ms, ButtonEvent &event)
+    {
+      State &s = state_m[i];
+      if (in != InputTimer) s.down = in == InputDown;
+      Transition t = transition((Machine)s.machine, in);
+      Machine from = (Machine)s.machine;
+      s.machine = t.next;
+      if (from == Released && t.next == Pressed) {
+        s.pressMs = ms;
+        s.timerMs = ms + pgm_read_word(&timing_m[i].holdMs);
+      } else if (in == InputTimer) {
+        s.timerMs += pgm_read_word(&timing_m[i].repeatMs);
+      }
+      if (t.event == ButtonNone) return false;
+      event.button = i;
+      event.type = t.event;
+      event.heldMs = (uint16_t)ms - s.pressMs;
+      event.ms = ms;
+      return true;
+    }
+
+    // an edge's 16 bit timestamp, back in millis() terms
+    static unsigned long fullMs(unsigned long now, uint16_t ms) { return now - (uint16_t)((uint16_t)now - ms); }
+
+    uint8_t pin(uint8_t i) const { return pgm_read_byte(&pins_m[i]); }
+    uint8_t readPins() const
+    {
+      uint8_t levels = 0;
+      for (uint8_t i = 0; i < N; i++) {
+        if (digitalRead(pin(i))) levels |= 1 << i;
+      }
+      return levels;
+    }
+
+    static Buttons *active_s;     // the one the interrupts feed
+
+    const uint8_t *pins_m;            // in flash
+    const ButtonTiming *timing_m;     // in flash
+    SpscQueue<Edge, 16> edges_m;
+    uint8_t levels_m;             // last snapshot taken off the queue
+    volatile uint8_t scanned_m;   // last snapshot queued (interrupt side)
+    bool tick_m;
+    State state_m[N];
+};
+
+template<uint8_t N> Buttons<N> *Buttons<N>::active_s = 0;
+
+#endif /* BUTTONS_H */
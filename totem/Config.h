@@ -0,0 +1,118 @@
+//// Config.h
+// Hardware configuration of the totem pole
+//
+// The LED matrix and pins, shared by Control, the patterns and the UI
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <FastLED.h>
+#include "Geometry.h"
+#include "Shards.h"
+
+// Information about the LED strip itself
+#define LED_PIN     9
+#ifndef NUM_COLS      // overridable so the host build can bench other matrix sizes
+#define NUM_COLS    8
+#endif
+#ifndef NUM_ROWS
+#define NUM_ROWS    8
+#endif
+#define NUM_LEDS    (NUM_COLS * NUM_ROWS) //using an 8x8 matrix of LEDS eventually...
+//#define NUM_LEDS    8
+const bool MatrixSerpentineLayout = false; //if LEDs are snaking or not (most likely, yes)
+// Big matrices are split by columns into NUM_SHARDS strips, each on its own
+// data pin (see Shards.h). On the AVR they're sent one at a time, skipping
+// strips that didn't change; define SHARDS_PARALLEL on boards where FastLED
+// sends several pins at once (ESP32 RMT/I2S, Teensy 4)
+#ifndef NUM_SHARDS
+#define NUM_SHARDS  1
+#endif
+#define LED_PINS    LED_PIN, 10, 16, 14   //data pin of each shard, in column order
+//#define SHARDS_PARALLEL
+#define CHIPSET     WS2812B
+#define COLOR_ORDER GRB
+#define TEMPERATURE OvercastSky
+
+// Frame rate (RateGovernor.h): the highest the measured render + show time
+// allows, up to FRAME_RATE_MAX. Rather than going under FRAME_RATE_FLOOR the
+// patterns drop to a lower quality tier, and only once they're at the
+// lowest does it go on down, to FRAME_RATE_MIN at the least
+#define FRAME_RATE_MAX    60
+#define FRAME_RATE_FLOOR  30
+#define FRAME_RATE_MIN    15
+
+// The Pro Micro has 2.5 KB of SRAM: on the AVR the noise cache and the
+// palette table are cut down from what the host builds use, an octave
+// cached (256 bytes on the 8x8, not 768) and a table of 64 (192 bytes, not
+// 768). The rest of the octaves are worked out each frame, and colours step
+// every 4 palette indexes. TOTEM_AVR_MODEL gives a host build the same,
+// for memory_report (host/memory)
+#if defined(__AVR__) || defined(TOTEM_AVR_MODEL)
+#ifndef NOISE_CACHED_OCTAVES
+#define NOISE_CACHED_OCTAVES  1
+#endif
+#ifndef PALETTE_LUT_SIZE
+#define PALETTE_LUT_SIZE  64
+#endif
+#endif
+
+// Particles a particle pattern can have alive at once (Particles.h): 9 bytes
+// each, in the pattern state, which is kept three times over (showing,
+// outgoing in a transition and staged by a playlist)
+#ifndef MAX_PARTICLES
+#define MAX_PARTICLES 16
+#endif
+
+// Noise patterns (Noise.h): octaves drawn, and how many of them are cached
+// between frames, each 4 bytes a pixel of SRAM (768 bytes for 3 on the 8x8);
+// the rest are worked out in full every frame
+#define NOISE_OCTAVES         3
+#ifndef NOISE_CACHED_OCTAVES
+#define NOISE_CACHED_OCTAVES  3
+#endif
+
+// Palette patterns (Palette.h): entries in the table the palette showing is
+// expanded into, 3 bytes each of SRAM. At 256 every colour index has its own,
+// the colour ColorFromPalette would give it; 128 or 64 share one between
+// neighbouring indexes, for boards short of SRAM
+#ifndef PALETTE_LUT_SIZE
+#define PALETTE_LUT_SIZE  256
+#endif
+
+// Power: 2 A boost converter off one 18650 (~3000 mAh at 3.7 V, ~2000 mAh at 5 V after the boost)
+#define POWER_BUDGET_MA   2000  //LED current is held under this
+#define BASELOAD_MA       50    //Pro Micro, mic amp and UI LEDs
+#define BATTERY_MAH       2000  //at 5 V, for the time left estimate
+
+// Event log (Log.h): binary records out of Serial, decoded on the host
+#define LOGGING
+
+// Profiler (Profiler.h): time spent in each stage of the loop, reported
+// through the log on the serial command 'p'. About 200 bytes of SRAM.
+#define PROFILING
+
+// Frame capture (FrameCapture.h): the frames shown stream out of Serial as
+// keyframes and deltas. Costs a frame plus a ring buffer of SRAM.
+//#define FRAME_CAPTURE
+#define CAPTURE_BYTES_PER_SEC 11520   //what the link carries: 115200 baud
+
+// OSC remote control (Osc.h), e.g. from TouchOSC on a phone. Needs a network
+// board whose library has an Arduino UDP class (OSC_UDP, from OSC_UDP_H)
+//#define OSC
+#define OSC_UDP           WiFiUDP
+#define OSC_UDP_H         <WiFiUdp.h>
+#define OSC_PORT          8000  //we listen here
+#define OSC_FEEDBACK_PORT 9000  //state goes back to the sender here
+
+// Settings kept in EEPROM (Settings.h): the part of it the journal wears over
+#define SETTINGS_EEPROM_START 0
+#define SETTINGS_EEPROM_SIZE  1024  //all of the 32u4's
+
+#define TAP_PIN           A0    //for tap tempo
+#define MIC_PIN           A7    //mic amp output (biased to Vcc/2), pin 6 on the Pro Micro
+
+// row/col <-> index tables and row/column/diagonal views for this wiring
+typedef MatrixGeometry<NUM_COLS, NUM_ROWS, MatrixSerpentineLayout> Geometry;
+typedef MatrixShards<Geometry, NUM_SHARDS> Shards;
+
+#endif /* CONFIG_H */
@@ -1,21 +1,56 @@
 #include "Control.h"
 
+Logger Log;     // see Log.h
+SerialShare SerialOut;  // see Log.h
+NoiseField Noise;   // see Noise.h
+PaletteTable Palettes;  // see Palette.h
+#ifdef PROFILING
+Profiler Profile;   // see Profiler.h
+#endif
+
+#if defined(__AVR__)
+// Free running ADC on the mic pin, see AudioBeat::startSampling()
+static AudioBeat *micInput = 0;
+ISR(ADC_vect)
+{
+  uint8_t sample = ADCH;
+  if (micInput) micInput->sampleAdc(sample);
+}
+#endif
+
 /********************************/
 /*  Control Implementation      */
 /********************************/
 // constructor
-Control::Control(CRGB *l, uint8_t nLeds) 
-  : brightness_m(96), newPattern_m(true), lastUpdate(0), currentPatternNumber(0), hue_m(0), beatNow(false)
+Control::Control(CRGB *l, uint16_t nLeds) 
+  : scheduler_m(FRAME_RATE_MAX), rate_m(FRAME_RATE_MIN, FRAME_RATE_FLOOR, FRAME_RATE_MAX), brightness_m(96), speed_m(20), frameBuffer_m(l), power_m(POWER_BUDGET_MA, BASELOAD_MA, NUM_LEDS), hue_m(0), hueMs_m(0), stagedReady_m(false), stagedDrawn_m(false), drawnAhead_m(false), beatClock_m(500000UL), indicatorBeat(0), indicatorTimeout(0),
+    audioSync_m(true), audioHoldUntil_m(0), audioLocked_m(false)
+#ifdef FRAME_CAPTURE
+    , capture_m(CAPTURE_BYTES_PER_SEC)
+#endif
 { 
   leds_m = l;
   nLeds_m = nLeds;
+  scheduler_m.lockToBeat(beatClock_m.periodUs());
+  pattern_m.start(0, context());
 }
 
 void Control::setupControl()
 {
-  FastLED.addLeds<CHIPSET, LED_PIN, COLOR_ORDER>(leds_m, nLeds_m).setCorrection( TypicalSMD5050 );
-  FastLED.setBrightness( brightness_m );
+  // one strip per shard, each showing its slice of the front buffer
+  Shards::addLeds<CHIPSET, COLOR_ORDER, LED_PINS>(frameBuffer_m.front(), TypicalSMD5050);
   FastLED.setTemperature( TEMPERATURE );
+
+#if defined(__AVR__)
+  micInput = &audio_m;
+#endif
+  audio_m.startSampling(MIC_PIN);
+#ifdef PROFILING
+  Profile.begin();
+#endif
+#ifdef FRAME_CAPTURE
+  capture_m.start(micros());    // built in to capture, so capture from the start
+#endif
 }
   
 void Control::handleControl() 
@@ -23,242 +58,209 @@ void Control::handleControl()
   // Monitors for UI input???
   // Updates UI components??? (done in UI - could reconsolidate)
 
+  updateAudio();  // a slice of mic samples, which may pull the beat clock onto the music
+  updateTap();    // advance the beat clock first so patterns see the current phase
+  updatePlaylist();   // and a step due on this beat comes in on its first frame
+
   // Calls patterns once to render if ready for it, then updates LEDs
-  unsigned long lastInterval = millis() - lastUpdate;      //essetnailly currentMillis - lastUpdate
-  if (lastInterval >= (1000/FPS))
+  // Deadlines advance by a fixed period, so a late frame doesn't delay the ones after it
+  if (scheduler_m.frameDue(micros()))
   {
-    lastUpdate = millis();
-    // Call the current pattern function once, updating the 'leds' array
-    (this->*patterns_m[currentPatternNumber])();
+    // Draw the current pattern once, updating the 'leds' array
+    bool changed;
+    {
+      PROFILE(ProfPattern);
+      PatternContext ctx = context();
+      Palettes.frame();
+      if (drawnAhead_m) drawnAhead_m = false;   // a playlist step's first frame, drawn when it was staged
+      else              pattern_m.draw(ctx);
 
-    //update the leds
-    FastLED.show();
-  }
+      if (transition_m.active()) {
+        // the pattern we're leaving draws into the transition's buffer, and the two are blended on the way out
+        if (!transition_m.held()) {
+          ctx.leds = transition_m.outgoing();
+          outgoing_m.draw(ctx);
+        }
+        transition_m.update(millis());
+        changed = frameBuffer_m.copyFrom(transition_m);
+      } else {
+        changed = frameBuffer_m.copy();
+      }
+    }
+    output(changed);
+    if (rate_m.frameDone(scheduler_m.frameDone(micros()))) {
+      // a new rate (or quality): the period from it, fitted to the beat again
+      scheduler_m.setFPS(rate_m.fps());
+      scheduler_m.lockToBeat(beatClock_m.periodUs());
+      logFrameRate();
+    }
 
-  updateTap();    // update tap tempo display
-  
-  EVERY_N_MILLISECONDS( 20 ) { hue_m++; }
-}
+    // the frame's out: if the next one is on the beat the next step comes in on, its pattern
+    // is started and drawn now, in the slack, rather than on that frame's time
+    if (!stagedReady_m && playlist_m.stageDue(beatClock_m.beats()) &&
+        (long)(scheduler_m.deadline() + scheduler_m.periodUs() / 2 - beatClock_m.nextBeatUs()) >= 0) stageNext();
+  }
+#ifdef FRAME_CAPTURE
+  capture_m.service();    // as much of the capture as Serial has room for
+#endif
 
-void Control::inc_pattern(){
-  currentPatternNumber = (currentPatternNumber + 1) % numPatterns;
-}
-void Control::dec_pattern(){
-  if (currentPatternNumber == 0) {currentPatternNumber = numPatterns - 1;}
-  else                           {currentPatternNumber--;}
+  if (speed_m && millis() - hueMs_m >= speed_m) { hueMs_m = millis(); hue_m++; }
 }
 
-void Control::incHueSpeed(){
-  //
-}
-void Control::decHueSpeed() {
-  //
-}
-
-/******************************/
-/*   LED HELPER FUNCTIONS     */
-/******************************/
-void Control::selectRow(uint8_t row,CRGB *leds[NUM_COLS]) 
+void Control::logFrameRate()
 {
-  // pass it a pointer to a CRGB pointer array[NUM_COLS], and it'll populate it with the pointers to leds in the column of the selected row
-  // MUST PASS A SIZE NUM_COL ARRAY OF POINTERS
-  for (uint8_t col = 0; col < NUM_ROWS; col++){
-    leds[col] = &leds_m[ atRowCol(row,col) ];
-//    DEBUG("Led number in array:\t");
-//    DEBUG_L(row + i*8);
-  }
+  LOG(LogFrameRate, rate_m.fps(), (uint8_t)rate_m.quality(), (uint16_t)min(rate_m.stats().costUs, 65535UL));
 }
 
-CRGB * Control::selectRow2(uint8_t row) 
+void Control::output(bool changed)
 {
-  CRGB *leds[NUM_COLS];
-  for (uint8_t col = 0; col < NUM_ROWS; col++) {
-    leds[col] = &leds_m[ atRowCol(row,col)]; 
-  }
-  return *leds;
-}
+  // as bright as asked, unless the frame would draw more than the supply can give
+  uint8_t brightness = power_m.limit(brightness_m, frameBuffer_m.load());
+  FastLED.setBrightness(brightness);
+  changed = frameBuffer_m.present(brightness, changed);
 
-void Control::selectCol(uint8_t col,CRGB *leds[NUM_ROWS]) 
-{
-  // pass it a pointer to a CRGB pointer array[8], and it'll populate it with the pointers of the selected col
-  // MUST PASS A SIZE NUM_ROWS ARRAY OF POINTERS
-  for (uint8_t row = 0; row < NUM_ROWS; row++) {
-    // i = number in row
-    
-    leds[row] = &leds_m[atRowCol(row, col)];
-//    DEBUG("Led number in array:\t");
-//    DEBUG_L(col*8 + i);
+  //update the leds, if anything changed
+  if (changed) {
+    showFrame(brightness);
+#ifdef FRAME_CAPTURE
+    capture_m.frame(frameBuffer_m.front(), micros(), beatClock_m.beats(), beatClock_m.bars(), beatClock_m.phase(), brightness);
+#endif
   }
+  power_m.account(micros());
 }
 
-CRGB * Control::selectCol2(uint8_t col) 
+void Control::replayFrame(const CRGB *frame)
 {
-  CRGB *leds[NUM_ROWS];
-  for (uint8_t row = 0; row < NUM_ROWS; row++) {
-    leds[row] = &leds_m[ atRowCol(row,col)]; 
-  }
-  return *leds;
+  FrameSource<Geometry> src = {frame};
+  output(frameBuffer_m.copyFrom(src));
 }
 
-uint8_t Control::atRowCol(uint8_t row, uint8_t col) 
+void Control::showFrame(uint8_t brightness)
 {
-  // returns the index of the led at row/col
-  uint8_t i;
-
-  if (MatrixSerpentineLayout == false) {
-    i = (col * NUM_ROWS) + row;
+  PROFILE(ProfShow);
+#if NUM_SHARDS > 1 && !defined(SHARDS_PARALLEL)
+  // a strip at a time, leaving out the ones that didn't change. Interrupts are
+  // only off for one strip, and the mic gets a look in between strips.
+  for (uint8_t s = 0; s < Shards::count; s++) {
+    if (!frameBuffer_m.columnsDue(Shards::firstCol(s), Shards::colsPerShard)) continue;
+    FastLED[s].showLeds(brightness);
+    audio_m.interruptsOffFor(Shards::wireUs);   // the mic samples lost while sending
+    updateAudio();
   }
-  
-  if (MatrixSerpentineLayout == true) {
-    
-    if (col & 0x01) {
-      //odd columns run backwards
-      uint8_t reverseRow = (NUM_ROWS - 1) - row;
-      i = (col * NUM_ROWS) + reverseRow;
-    } else {
-      // Even rows run forwards
-      i = (col * NUM_ROWS) + row;
-    }
-  }
-  
-  return i; 
+#else
+  // one strip, or strips FastLED sends in parallel
+  FastLED.show();
+  audio_m.interruptsOffFor(Shards::wireUs);   // in parallel, as long as the longest
+#endif
+  frameBuffer_m.clearDirty();
 }
 
-void Control::addGlitter( fract8 chanceOfGlitter = 80)
+void Control::set_pattern(uint8_t pattern)
 {
-  if( random8() < chanceOfGlitter) {
-    leds_m[ random16(NUM_LEDS) ] += CRGB::White;
-  }
+  leavePattern();
+  pattern_m.start(pattern, context());
+  LOG(LogPattern, pattern);
 }
 
-void Control::pulseToBeat()
+void Control::leavePattern()
 {
-  // helper function, called every update to pulse lights to beat
-  //offset by 90 so peak is at start
-  uint8_t wave_bright = beatsin8(get_BPM(), brightness_m/6, brightness_m, 0, 90);   
-  leds_m.setBrightness(wave_bright); 
+  // the outgoing pattern carries on, with its state and its last frame, until the transition is done;
+  // if one's still running, it goes on from the blend it's got to, and the pattern it was leaving is let go
+  if (!transition_m.active()) outgoing_m = pattern_m;
+  transition_m.begin(leds_m, millis());
+  stagedDrawn_m = drawnAhead_m = false;   // the transition's buffer is in use, and leds_m is the old pattern's
 }
 
+void Control::inc_pattern(){
+  set_pattern((pattern_m.index() + 1) % numPatterns);
+}
+void Control::dec_pattern(){
+  if (pattern_m.index() == 0) {set_pattern(numPatterns - 1);}
+  else                        {set_pattern(pattern_m.index() - 1);}
+}
 
 /******************************/
-/*        PATTERNS            */
+/*         PLAYLISTS          */
 /******************************/
-// Patterns
-void Control::BPM_boogie()
+void Control::setPlaylist(uint8_t list)
 {
-  // all strips pulsing at a defined BPM, no ofset
-  CRGBPalette16 palette = PartyColors_p;
-  uint8_t beat = beatsin8( this->get_BPM(), 64, 255, 0, 90);
-  for( int i = 0; i < nLeds_m; i++) { //9948
-    leds_m[i] = ColorFromPalette(palette, hue_m+(i*2), beat/*-hue_m*/+(i*10));
-  }
+  if (list < numPlaylists) playlist_m.start(list, beatClock_m.beats());
+  else                     playlist_m.stop();
+  stagedReady_m = stagedDrawn_m = false;
+  LOG(LogPlaylist, (uint8_t)playlist_m.playing(), list);
 }
 
-void Control::scroll_rows() 
-{
-  // scrolls through each of the rows to the top, then back down
-  fadeToBlackBy( leds_m, NUM_LEDS, 20);
-  uint8_t pos = beatsin16( this->get_BPM()/NUM_ROWS, 0, NUM_ROWS);  //rises up rows one row per beat
-  for (uint8_t col = 0; col < NUM_COLS; col++){
-    CRGB *col_leds[8];
-    selectCol(col, col_leds); //col_leds now contains pointers to LEDS
-    *col_leds[pos] += CHSV( hue_m+15*col, 255, 192);
-  }
-}
-void Control::rolling_rows()
+void Control::nextPlaylist()
 {
-  // scrolls through each of the rows to the top, then starts from the bottom again
-  static uint8_t currentRow = NUM_ROWS; //since we pre-increment
-  
-//  fadeToBlackBy( leds_m, NUM_LEDS, 20);
-  //if ( millis() >= timeoutTime + 1000/FPS ) {
-    // only run if we are on the beat (give leeway as we only check every once every FPS)
-  if (beatNow) {
-    // set every time we have a beat
-    beatNow = false;
-    currentRow = (currentRow + 1) % NUM_ROWS; // select next row and wrap around if at top
-    for (uint8_t col = 0; col < NUM_COLS; col++) {
-//      CRGB *col_leds[8];
-//      selectCol(col, col_leds);
-//      *col_leds[currentRow] += CHSV( hue_m+15*col, 255, 192);  
-      leds_m[atRowCol(currentRow, col)] += CHSV( hue_m+15*col, 255, 192);  
-    }
-    
-  }
-  // fade every led except current row (not efficient, but I guess the fastled code would do this anyway...)
-  for (uint8_t row = 0; row < NUM_ROWS; row++) {
-    for (uint8_t col = 0; col < NUM_COLS; col++) {
-      if ( row != currentRow) {
-        leds_m[atRowCol(row,col)].fadeToBlackBy (10);
-      }
-    }
-  }
+  uint8_t list = playlist_m.list();
+  setPlaylist(list == PlaylistPlayer::off ? 0 : list + 1);
 }
-void Control::rolling_rows_diag()
+
+void Control::updatePlaylist()
 {
-  // scrolls through each of the rows to the top, then starts from the bottom again, in a diagnoal
-  static uint8_t currentRow = NUM_ROWS; //since we pre-increment
-  
-//  fadeToBlackBy( leds_m, NUM_LEDS, 20);
-  //if ( millis() >= timeoutTime + 1000/FPS ) {
-    // only run if we are on the beat (give leeway as we only check every once every FPS)
-  if (beatNow) {
-    // set every time we have a beat
-    beatNow = false;
-    currentRow = (currentRow + 1) % NUM_ROWS; // select next row and wrap around if at top
-    for (uint8_t col = 0; col < NUM_COLS; col++) {
-      CRGB *col_leds[8];
-      selectCol(col, col_leds);
-      *col_leds[(currentRow+col)%NUM_ROWS] += CHSV( hue_m+15*col, 255, 192);  
-    }
-    
-  }
-  // fade every led except current row (not efficient, but I guess the fastled code would do this anyway...)
-  for (uint8_t row = 0; row < NUM_ROWS; row++) {
-    for (uint8_t col = 0; col < NUM_COLS; col++) {
-      if ( ((row+col)%NUM_ROWS) != currentRow) {
-//        if (leds_m[atRowCol(row,col)] > CHSV (0,256,brightness_m/5)) {
-          leds_m[atRowCol(row,col)].fadeToBlackBy (10);
-          
-//        }
-      }
-    }
+  if (!playlist_m.due(beatClock_m.beats())) return;
+  PlaylistStep step = playlist_m.next();
+  bool staged = stagedReady_m && staged_m.index() == step.pattern;
+
+  if (step.hueSpeed) speed_m = step.hueSpeed;
+  TransitionType type = transition_m.type();    // the step's transition is for this switch only
+  transition_m.setType(step.transition());
+  if (staged && stagedDrawn_m && !transition_m.active()) {
+    // its first frame is drawn: into leds_m with it, and the outgoing frame into the transition's buffer to blend from
+    swapSpan(leds_m, transition_m.outgoing(), NUM_LEDS);
+    outgoing_m = pattern_m;
+    transition_m.begin(leds_m, millis(), true);
+    drawnAhead_m = true;
+  } else {
+    leavePattern();
   }
-}
+  transition_m.setType(type);
+  if (staged) pattern_m = staged_m;
+  else        pattern_m.start(step.pattern, context());
+  stagedReady_m = stagedDrawn_m = false;
 
-void Control::rainbow()
-{
-  // Classic rainbow, maybe have the width represent the speed or something?
-  uint8_t width = 7; 
-  fill_rainbow( leds_m, NUM_LEDS, gHue, width);
-  
-  // could also have it pulse according to beat 
-  pulseToBeat();
+  playlist_m.advance(step, beatClock_m.beats(), beatClock_m.periodUs(), staged);
+  LOG(LogPattern, step.pattern);
 }
 
-void Control::confetti()
+void Control::stageNext()
 {
-  // randomo coloured speckles that blink in and fade smoothly
-  fadeToBlackBy( leds_m, NUM_LEDS, 10);
-  uint8_t pos = random16(NUM_LEDS); 
-  led[pos] += CHSV( hue_m + random8(64), 200, 255);
-}
-
+  // as it'll be on the switch frame: the start of the next beat
+  PatternContext ctx = context();
+  ctx.beats++;
+  ctx.phase = 0;
+  if (beatClock_m.beatInBar() == BeatClock::beatsPerBar - 1) ctx.bars++;
+  staged_m.start(playlist_m.next().pattern, ctx);
+  stagedReady_m = true;
+  if (transition_m.active()) return;    // its buffer's busy: the first frame is drawn on the switch, as without a playlist
 
+  // and its first frame, into the transition's buffer, onto the frame showing (as on the switch it'd draw
+  // onto the outgoing pattern's); it's staying, so the palette table is its to fill now, not then
+  ctx.leds = transition_m.outgoing();
+  memcpy(ctx.leds, leds_m, NUM_LEDS * sizeof(CRGB));
+  Palettes.handOver();
+  staged_m.draw(ctx);
+  stagedDrawn_m = true;
+}
 
+void Control::incHueSpeed(){
+  //
+}
+void Control::decHueSpeed() {
+  //
+}
 
 /******************************/
 /*        TAP TEMPO           */
 /******************************/
 void Control::updateTap() 
 {
-  /* check for timer timeout */
-  if( millis() >= timeoutTime ) {
-    /* timeout happened.  clock tick! */
-    beatNow = true;
-    indicatorTimeout = millis() + 30;  /* this sets the time when LED 13 goes off */
-    /* and reschedule the timer to keep the pace */
-    rescheduleTimer();
+  PROFILE(ProfTap);
+  beatClock_m.update(micros());
+  if (beatClock_m.beats() != indicatorBeat) {
+    /* clock tick! */
+    indicatorBeat = beatClock_m.beats();
+    indicatorTimeout = millis() + 30;  /* this sets the time when the indicator goes off */
   }
   
   //display tap tempo
@@ -269,43 +271,30 @@ void Control::updateTap()
   }
 }
 
-void Control::tap()
+void Control::tap(unsigned long atUs)
 {
-  /* we keep two of these around to average together later */
-  currentTimer[1] = currentTimer[0];
-  currentTimer[0] = millis() - lastTap;
-  lastTap = millis();
-  timeoutTime = 0; /* force the trigger to happen immediately - sync and blink! */
-  
-  // only update tempo if we have two valid taps, greater than 6BPM
-//  if ( (currentTimer[0] + currentTimer[1])/2 < 10000) ) {
-    tempo_m = (currentTimer[0] + currentTimer[1])/2;
-//  }
-  DEBUG("\tmsec b/w beats:\t");
-  DEBUG(this->get_tempo());
-  DEBUG("\tBPM:\t");
-  DEBUG_L(this->get_BPM());
-
-  CRGB *row[NUM_COLS];
-  this->selectCol(2, row);
-  DEBUG("Col");
-  #ifdef DEBUG
-  for (uint8_t i = 0; i < NUM_COLS; i++){
-    DEBUG(i);
-    DEBUG(":\tR:"); DEBUG(row[i]->r);
-    DEBUG("\tG:");  DEBUG(row[i]->g);
-    DEBUG("\tB:");  DEBUG_L(row[i]->b);
+  audioHoldUntil_m = millis() + tapHoldMs;    // the tapped tempo wins over the music for a while
+  if (beatClock_m.tap(atUs)) {
+    scheduler_m.syncTo(atUs);   /* the beat restarted on the tap - put a frame on it */
   }
-  #endif
+  scheduler_m.lockToBeat(beatClock_m.periodUs());
+
+  LOG(LogTap, (uint16_t)get_tempo(), get_BPM());
 }
 
-void Control::rescheduleTimer()
+/******************************/
+/*      AUDIO BEAT SYNC       */
+/******************************/
+void Control::updateAudio()
 {
-    /* set the timer to go off again when the time reaches the 
-       timeout.  The timeout is all of the "currentTimer" values averaged
-       together, then added onto the current time.  When that time has been
-       reached, the next tick will happen...
-    */
-    timeoutTime = millis() + ((currentTimer[0] + currentTimer[1])/2);
-}
+  if (!audio_m.update(micros())) return;    // no onset heard in this slice
+  if (audio_m.locked() != audioLocked_m) {
+    audioLocked_m = audio_m.locked();
+    LOG(LogAudioLock, (uint8_t)audioLocked_m, audio_m.bpm(), audio_m.confidence());
+  }
+  if (!audioSync_m || !audio_m.locked()) return;
+  if ((long)(millis() - audioHoldUntil_m) < 0) return;
 
+  beatClock_m.follow(micros(), audio_m.onsetUs(), audio_m.periodUs());
+  scheduler_m.lockToBeat(beatClock_m.periodUs());
+}
@@ -6,43 +6,32 @@
 #ifndef CONTROL_H
 #define CONTROL_H
 
-#define DEBUG
-#ifdef DEBUG
-  #define DEBUG(x)    Serial.print(x)
-  #define DEBUG_L(x)  Serial.println(x)
-#else
-  #define DEBUG(x)
-#endif
-#define DISPLAY
-#ifdef DISPLAY
-  #define DISPLAY(x)    Serial.print(x)
-  #define DISPLAY_L(x)  Serial.println(x)
-#endif
-
 #include <FastLED.h>
-
-// Information about the LED strip itself
-#define LED_PIN     9
-#define NUM_COLS    8
-#define NUM_ROWS    8
-#define NUM_LEDS    (NUM_COLS * NUM_ROWS) //using an 8x8 matrix of LEDS eventually...
-//#define NUM_LEDS    8
-const bool MatrixSerpentineLayout = false; //if LEDs are snaking or not (most likely, yes)
-#define CHIPSET     WS2812B
-#define COLOR_ORDER GRB
-#define TEMPERATURE OvercastSky
-
-#define TAP_PIN           A0    //for tap tempo
+#include "Config.h"
+#include "FrameScheduler.h"
+#include "FrameBuffer.h"
+#include "Patterns.h"
+#include "Transition.h"
+#include "Playlist.h"
+#include "BeatClock.h"
+#include "AudioBeat.h"
+#include "PowerGovernor.h"
+#include "RateGovernor.h"
+#include "Log.h"
+#include "Profiler.h"
+#ifdef FRAME_CAPTURE
+#include "FrameCapture.h"
+#endif
 
 // todo MORE PATTERNS
-// sync all patterns to BPM using bool beatNow (see rolling_rows() for example)
+// sync all patterns to BPM using newBeat() (see RollingRows in Patterns.h for example)
 // implement hue speed changes
 
 class Control
 {
   public:
     //Pass the led array to control for management
-    Control(CRGB *l, uint8_t nLeds);
+    Control(CRGB *l, uint16_t nLeds);
     
     void setupControl();
     
@@ -53,50 +42,93 @@ class Control
       // Updates UI components
       // Calls render if ready for it, then updates LEDs
 
-    void set_brightness(uint8_t brightness) {brightness_m = constrain(brightness,0,255); FastLED.setBrightness(brightness_m);}
-    void decBrightness(uint8_t i = 3) {brightness_m = max(brightness_m - i, 0);   FastLED.setBrightness(brightness_m);}
-    void incBrightness(uint8_t i = 3) {brightness_m = min(brightness_m + i, 255); FastLED.setBrightness(brightness_m);}
+    // the brightness asked for; what's shown may be lower to keep within the power budget
+    void set_brightness(uint8_t brightness) {brightness_m = constrain(brightness,0,255);}
+    void decBrightness(uint8_t i = 3) {brightness_m = max(brightness_m - i, 0);}
+    void incBrightness(uint8_t i = 3) {brightness_m = min(brightness_m + i, 255);}
     uint8_t getBrightness() {return brightness_m;};
     
-    void set_pattern(uint8_t pattern) {currentPatternNumber = pattern;}
-    string getPattern(uint8_t
+    void set_pattern(uint8_t pattern);
+    uint8_t getPattern() {return pattern_m.index();}
+    static uint8_t getNumPatterns() {return numPatterns;}
+    static const char * getPatternName(uint8_t pattern) {return TotemPatterns::name(pattern % numPatterns);}   // in flash (PROGMEM)
     void inc_pattern();
     void dec_pattern();
-    void setHueSpeed(uint8_t speeed) {speed_m = speeed;}    // control speed at which hue changes
+    void setTransition(TransitionType type, uint16_t ms) {transition_m.setType(type); transition_m.setDuration(ms);}
+    bool inTransition() {return transition_m.active();}
+    void setHueSpeed(uint8_t speeed) {speed_m = speeed;}    // control speed at which hue changes: ms a step, 0 holds it
+    uint8_t getHueSpeed() {return speed_m;}
     void incHueSpeed();
     void decHueSpeed();
-    void set_tempo(unsigned short tempo) {tempo_m = tempo;}
+
+    //playlists: patterns changing on the beat by themselves (see Playlist.h)
+    void setPlaylist(uint8_t list);     // PlaylistPlayer::off to stop
+    void nextPlaylist();                // off, the first, the second ... then off again
+    uint8_t getPlaylist() {return playlist_m.list();}
+    static uint8_t getNumPlaylists() {return numPlaylists;}
+    const PlaylistStats &getPlaylistStats() {return playlist_m.stats();}
+
+    void set_tempo(unsigned short tempo) {beatClock_m.setPeriod(tempo * 1000UL); scheduler_m.lockToBeat(beatClock_m.periodUs());}
 
     //tap tempo functions
-    unsigned short get_tempo() {return constrain(tempo_m, 200, 2000) ; }
-    uint8_t get_BPM() {return (60000/tempo_m);}
-    void tap();
+    unsigned short get_tempo() {return beatClock_m.periodUs() / 1000; }   // msec between beats e.g. 120BPM = 500msec
+    uint8_t get_BPM() {return (60000000UL/beatClock_m.periodUs());}   // at most 250: BeatClock::minPeriodUs
+    void tap() {tap(micros());}
+    void tap(unsigned long atUs);   // a tap that happened at micros() atUs
+    const BeatClock &getBeatClock() {return beatClock_m;}
+
+    //audio beat detection (the tempo follows the music unless it's been tapped recently)
+    void setAudioSync(bool on) {audioSync_m = on;}
+    bool getAudioSync() {return audioSync_m;}
+    AudioBeat &getAudio() {return audio_m;}    // the ADC interrupt, or a host tool, feeds the mic samples in here
+
+    const FrameStats &getFrameStats() {return scheduler_m.stats();}
+    uint32_t getFramePeriod() {return scheduler_m.periodUs();}    // usec, adjusted to fit the beat
+
+    //frame rate and pattern quality, from what frames cost (see RateGovernor.h)
+    uint8_t getFrameRate() {return rate_m.fps();}                 // before fitting it to the beat
+    Quality getQuality() {return rate_m.quality();}
+    const RateGovernor &getRateGovernor() {return rate_m;}
+    void logFrameRate();                                          // a LogFrameRate record of them now
+    const ShowStats &getShowStats() {return frameBuffer_m.stats();}
+
+    //power estimate and limiting
+    void setPowerBudget(uint16_t mA) {power_m.setBudget(mA);}
+    const PowerStats &getPowerStats() {return power_m.stats();}
+    uint16_t getmAh() {return power_m.mAh();}                                 // consumed since power on
+    uint16_t getMinutesLeft() {return power_m.minutesLeft(BATTERY_MAH);}      // at the average draw
+
+    // Show a frame from elsewhere (e.g. a capture being replayed) in place of the
+    // pattern's, through the same brightness, power limit and output as a rendered one
+    void replayFrame(const CRGB *frame);
+
+#ifdef FRAME_CAPTURE
+    //frames shown, out of Serial (see FrameCapture.h)
+    void setCapture(bool on) {if (on) capture_m.start(micros()); else capture_m.stop();}
+    bool getCapture() {return capture_m.capturing();}
+    const CaptureStats &getCaptureStats() {return capture_m.stats();}
+#endif
 
   private:
     //Varibles for FPS
-    const uint8_t FPS = 60; 
-    unsigned long lastUpdate;
+    FrameScheduler scheduler_m;   // deadlines on a fixed usec timeline, locked to the beat
+    RateGovernor rate_m;          // the frame rate and quality it can keep up
 
     //UI related variables
     uint8_t brightness_m;
     uint8_t speed_m; 
-    uint8_t currentPatternNumber;
-    unsigned short tempo_m; // recorded as the miliseconds between two beats e.g. 120BPM = 500msec between beats
 
     //LEDS and helper functions
-    CRGB *leds_m;
-    uint8_t nLeds_m;
+    CRGB *leds_m;     // back buffer, patterns draw here
+    uint16_t nLeds_m;
+    FrameBuffer<Geometry> frameBuffer_m;    // front buffer is what FastLED sends
+    PowerGovernor power_m;                  // global brightness to show each frame at
+    void output(bool changed);              // front buffer out to the LEDs at a brightness within budget
+    void showFrame(uint8_t brightness);     // sends the front buffer, strip by strip when sharded
     //LEDS are arranged in an 8X8 design around a globe
     //array has bottom to top, clockwise fashion. 
     // e.g. 0-7 is 12o'clock, bottom to top, 8-15 is next column (~1.20o'clock) bottom to top, etc. 
-    void selectRow(uint8_t row, CRGB *leds[8]);   // for manipulating a whole row at once
-    CRGB * selectRow2(uint8_t row);
-    void selectCol(uint8_t col, CRGB *leds[8]);   // for manipulating a whole column at once
-    CRGB * selectCol2(uint8_t col);
-    uint8_t atRowCol(uint8_t row, uint8_t col);     // returns index i of led at row & col (accounting for Serpentine order)
-
-    void addGlitter(fract8 chanceOfGlitter = 80);
-    void pulseToBeat(); 
+    // (Geometry has the row/col <-> index tables and row/column/diagonal views)
 
 
     /******************************/
@@ -104,37 +136,53 @@ class Control
     /******************************/
     //Pattern variables
     uint8_t hue_m;      //rotating 'base colour' used by patterns
-    bool newPattern_m;    //used to initialise new patterns
-    
-    //Pattern array
-    static const uint8_t numPatterns = 6;
-    typedef void (Control::*PatternList[numPatterns])();
-    PatternList patterns_m = { &rainbow, &confetti, &rolling_rows_diag, &rolling_rows, &scroll_rows, &BPM_boogie  };;   // BPM_boogie, scroll_rows
-    // Pattern names for display
-    static string patternNames[numPatterns] = { "Rainbow", "Confetti", "Roll Rows (D)", "Roll Rows", "Scroll Rows", "BPM Boogie" };
-    
-    //Patterns
-    void BPM_boogie();
-    void scroll_rows();
-    void rolling_rows();
-    void rolling_rows_diag();
-    void rainbow();
-    void confetti();
+    unsigned long hueMs_m;    // when it last stepped
+
+    // Patterns are types listed in TotemPatterns (Patterns.h), each with its own state
+    static const uint8_t numPatterns = TotemPatterns::count;
+    PatternSlot<TotemPatterns> pattern_m;
+    PatternSlot<TotemPatterns> outgoing_m;    // keeps drawing while we blend away from it
+    Transition<Geometry> transition_m;
+    void leavePattern();        // pattern_m out through a transition, before the next is started in it
+    PatternContext context() {
+      PatternContext ctx = {leds_m, hue_m, get_BPM(), beatClock_m.beats(), beatClock_m.phase(), beatClock_m.bars(), rate_m.quality()};
+      return ctx;
+    }
+
+    /******************************/
+    /*         PLAYLISTS          */
+    /******************************/
+    PlaylistPlayer playlist_m;
+    PatternSlot<TotemPatterns> staged_m;    // the next step's pattern, started the frame before its switch
+    bool stagedReady_m;
+    bool stagedDrawn_m;         // and its first frame drawn, waiting in transition_m.outgoing()
+    bool drawnAhead_m;          // switched to it: leds_m holds the next frame already
+    void updatePlaylist();      // the next step, if it's due on this beat
+    void stageNext();
 
     /******************************/
     /*      TAP TEMPO CONTROL     */
     /******************************/
     //variables
-    int lastTapState = LOW;  /* the last tap button state */
-    bool beatNow = false;
-    unsigned long currentTimer[2] = { 500, 500 };  /* array of most recent tap counts */
-    unsigned long timeoutTime = 0;  /* this is when the timer will trigger next */
-
+    BeatClock beatClock_m;    // beats on a fixed timeline, taps nudge its phase
+    uint16_t indicatorBeat;   /* last beat the indicator blinked for */
     unsigned long indicatorTimeout; /* for our fancy "blink" tempo indicator */
-    unsigned long lastTap = 0; /* when the last tap happened */
     //functions
     void updateTap();
-    void rescheduleTimer();
+
+    /******************************/
+    /*     AUDIO BEAT CONTROL     */
+    /******************************/
+    static const uint16_t tapHoldMs = 10000;    // after a tap, ignore the music for this long
+    AudioBeat audio_m;
+    bool audioSync_m;
+    unsigned long audioHoldUntil_m;
+    bool audioLocked_m;       // as last logged
+    void updateAudio();
+
+#ifdef FRAME_CAPTURE
+    FrameCapture<Geometry> capture_m;
+#endif
 };
 
 #endif /* LEDControl_H */
@@ -0,0 +1,135 @@
+//// FrameBuffer.h
+// Front/back buffer pair that only lets FastLED.show() through when the frame changed
+//
+// Patterns render into the back buffer (leds_m). FastLED is registered on
+// the front buffer, which always holds what is on the LEDs. commit() copies
+// the back buffer across column by column, marking the columns that
+// changed; if nothing changed (and neither did the brightness) there's no
+// need to spend ~30us per LED with interrupts off re-sending the same frame.
+// A keep-alive refresh still goes out every so often in case a glitch
+// corrupted the strip.
+// The current the front buffer draws (PowerGovernor::load) is kept up a
+// column at a time as columns change, for the power governor.
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <FastLED.h>
+#include "PowerGovernor.h"
+
+struct ShowStats
+{
+  unsigned long issued;     // FastLED.show() calls let through
+  unsigned long skipped;    // frames identical to what's already on the LEDs
+  unsigned long stripsSkipped;  // strips left out of a show as unchanged (sharded output)
+};
+
+// A whole frame held elsewhere (laid out like the back buffer), as a commitFrom() source
+template<class G>
+struct FrameSource
+{
+  const CRGB *leds;
+  const CRGB *column(uint8_t c, CRGB *) { return leds + c * G::numRows; }
+};
+
+template<class G>
+class FrameBuffer
+{
+  public:
+    static const uint8_t keepAliveFrames = 120;   // resend at least this often (~2 sec at 60 FPS)
+
+    FrameBuffer(CRGB *back) : back_m(back), load_m(0), brightness_m(0), idleFrames_m(0), forceShow_m(true), resendAll_m(true)
+    {
+      fill_solid(front_m, G::numLeds, CRGB(0, 0, 0));
+      memset(dirty_m, 0, sizeof(dirty_m));
+      memset(columnLoad_m, 0, sizeof(columnLoad_m));
+      memset(&stats_m, 0, sizeof(stats_m));
+    }
+
+    CRGB *front() { return front_m; }
+    CRGB *back() { return back_m; }
+
+    // Copy changed columns to the front buffer. True if the frame needs showing.
+    bool commit(uint8_t brightness) { return present(brightness, copyFrom(*this)); }
+
+    // As commit(), but the frame comes from src.column(c, scratch), which
+    // returns the pixels of column c (in memory order), optionally built in
+    // scratch. Lets a transition blend straight into the front buffer.
+    template<class Source>
+    bool commitFrom(uint8_t brightness, Source &src) { return present(brightness, copyFrom(src)); }
+
+    // commit() in two halves, for when the brightness depends on the frame:
+    // copyFrom() brings the front buffer (and its load) up to date and says
+    // if any pixel changed, present() says if the frame needs showing
+    bool copy() { return copyFrom(*this); }
+    template<class Source>
+    bool copyFrom(Source &src)
+    {
+      CRGB scratch[G::numRows];
+      bool changed = false;
+      for (uint8_t c = 0; c < G::numCols; c++) {
+        const CRGB *col = src.column(c, scratch);
+        CRGB *dst = front_m + c * G::numRows;
+        if (memcmp(col, dst, G::numRows * sizeof(CRGB)) != 0) {
+          memcpy(dst, col, G::numRows * sizeof(CRGB));
+          dirty_m[c >> 3] |= (1 << (c & 0x07));
+          load_m -= columnLoad_m[c];
+          columnLoad_m[c] = PowerGovernor::load(dst, G::numRows);
+          load_m += columnLoad_m[c];
+          changed = true;
+        }
+      }
+      return changed;
+    }
+    bool present(uint8_t brightness, bool changed)
+    {
+      // these change every pixel on the wire, not just the dirty columns
+      if (brightness != brightness_m) { brightness_m = brightness; resendAll_m = true; }
+      if (++idleFrames_m >= keepAliveFrames) resendAll_m = true;
+      if (forceShow_m) resendAll_m = true;
+
+      if (changed || resendAll_m) {
+        forceShow_m = false;
+        idleFrames_m = 0;
+        stats_m.issued++;
+        return true;
+      }
+      stats_m.skipped++;
+      return false;
+    }
+
+    // columns are contiguous whatever the wiring, serpentine just reverses them
+    const CRGB *column(uint8_t c, CRGB *) { return back_m + c * G::numRows; }
+
+    // Columns changed since clearDirty(), e.g. for outputs that can send part of a frame
+    bool columnDirty(uint8_t c) const { return dirty_m[c >> 3] & (1 << (c & 0x07)); }
+    // For outputs split into strips: whether the strip holding n columns from
+    // first needs sending (a brightness change or keep-alive resends them all)
+    bool columnsDue(uint8_t first, uint8_t n)
+    {
+      if (resendAll_m) return true;
+      for (uint8_t c = first; c < first + n; c++) {
+        if (columnDirty(c)) return true;
+      }
+      stats_m.stripsSkipped++;
+      return false;
+    }
+    void clearDirty() { memset(dirty_m, 0, sizeof(dirty_m)); resendAll_m = false; }
+
+    void invalidate() { forceShow_m = true; }     // next commit() shows no matter what
+    uint32_t load() const { return load_m; }      // of the front buffer, see PowerGovernor::load()
+    const ShowStats &stats() const { return stats_m; }
+
+  private:
+    CRGB *back_m;
+    CRGB front_m[G::numLeds];
+    uint8_t dirty_m[(G::numCols + 7) / 8];
+    uint32_t columnLoad_m[G::numCols];
+    uint32_t load_m;
+    uint8_t brightness_m;
+    uint8_t idleFrames_m;
+    bool forceShow_m;
+    bool resendAll_m;         // every column goes out on the next show
+    ShowStats stats_m;
+};
+
+#endif /* FRAMEBUFFER_H */
@@ -0,0 +1,225 @@
+//// FrameCapture.h
+// Streams the frames shown out of Serial in a compact binary form
+//
+// Each frame is XORed with the last one captured and the result run length
+// coded: runs of unchanged bytes cost one byte per 128, changed bytes go out
+// as literals. A keyframe is the same coding against black, so a decoder
+// can join the stream at any keyframe (one every keyframeFrames, and
+// whenever capture starts).
+// Records go into a ring buffer and out of Serial only as fast as its TX
+// buffer takes them (availableForWrite()), so capture never blocks the loop.
+// Output is also paced to bytesPerSec, what the link can carry (115200 baud
+// is 11520 bytes/s: 192 a frame at 60 FPS, an 8x8 keyframe). A frame that
+// doesn't fit in the time or the ring is skipped and counted, and the next
+// delta is against the last frame actually sent, so the stream stays valid.
+// Serial is shared with the log a record at a time (SerialShare, Log.h).
+//
+// Record: 0xA5, type, payload length (2 bytes), payload, CRC-8 of type and payload.
+// Every multi-byte value is little endian. Payloads:
+//   'K' keyframe: cols, rows, frame header, RLE data
+//   'D' delta:    frame header, RLE data
+// Frame header (10 bytes): flags (bit 0 new beat, bit 1 new bar), frames
+// skipped before this one, millis() (4), beats (2), beat phase (high byte),
+// brightness the frame was shown at.
+// RLE control byte c: c & 0x80 is a run of (c & 0x7F) + 1 zero bytes,
+// otherwise c + 1 literal bytes follow. Data is the frame in LED order, GRB
+// as in memory (r, g, b per CRGB).
+// host/capture/frame_capture decodes and replays the stream.
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "Log.h"
+
+struct CaptureStats
+{
+  unsigned long frames;       // frames sent
+  unsigned long keyframes;    // of which keyframes
+  unsigned long skipped;      // frames that didn't fit the budget
+  unsigned long bytes;        // bytes handed to Serial
+};
+
+// RING must hold a keyframe: by default one frame plus a little, 256 bytes for 8x8
+template<class G, uint16_t RING = G::numLeds * 3 + 64>
+class FrameCapture
+{
+  public:
+    static const uint8_t sync = 0xA5;
+    static const uint8_t keyframeFrames = 120;    // a keyframe at least this often
+
+    FrameCapture(uint16_t bytesPerSec) : bytesPerSec_m(bytesPerSec), on_m(false), sending_m(0) { reset(); }
+
+    void start(unsigned long nowUs)
+    {
+      reset();
+      on_m = true;
+      lastUs_m = nowUs;
+    }
+    void stop() { on_m = false; }
+    bool capturing() const { return on_m; }
+
+    // Record a frame, if there's room for it
+    void frame(const CRGB *leds, unsigned long nowUs, uint16_t beats, uint8_t bars, uint16_t phase, uint8_t brightness)
+    {
+      if (!on_m) return;
+      refill(nowUs);
+
+      uint8_t flags = (beats != lastBeats_m ? 0x01 : 0) | (bars != lastBars_m ? 0x02 : 0);    // since the last frame sent
+      bool key = sinceKey_m >= keyframeFrames;
+      uint16_t size = encode(leds, key, flags, beats, phase, brightness);
+      if (size == 0 || size > credit_m) {
+        if (skippedRun_m < 255) skippedRun_m++;
+        stats_m.skipped++;
+        return;
+      }
+      // sent: commit the record, and it's the reference for the next delta
+      head_m = (head_m + size) % RING;
+      used_m += size;
+      credit_m -= size;
+      memcpy(reference_m, leds, sizeof(reference_m));
+      sinceKey_m = key ? 0 : sinceKey_m + 1;
+      stats_m.frames++;
+      if (key) stats_m.keyframes++;
+      skippedRun_m = 0;
+      lastBeats_m = beats;
+      lastBars_m = bars;
+    }
+
+    // Call every loop: hands Serial as much as its TX buffer has room for
+    void service()
+    {
+      while (used_m) {
+        int room = Serial.availableForWrite();
+        if (room <= 0) return;
+        if (!sending_m) {
+          // the start of a record: its payload length, and the sync, type and CRC around it
+          if (!SerialOut.take(SerialShare::captureWriter)) return;
+          sending_m = (ring_m[(tail_m + 2) % RING] | (ring_m[(tail_m + 3) % RING] << 8)) + 5;
+        }
+        uint16_t n = used_m;
+        if (n > (uint16_t)room) n = room;
+        if (n > RING - tail_m) n = RING - tail_m;     // up to the end of the ring, the rest next time round
+        if (n > sending_m) n = sending_m;
+        Serial.write(ring_m + tail_m, n);
+        tail_m = (tail_m + n) % RING;
+        used_m -= n;
+        sending_m -= n;
+        stats_m.bytes += n;
+        if (!sending_m && SerialOut.release(SerialShare::captureWriter)) return;   // the log's turn
+      }
+    }
+
+    const CaptureStats &stats() const { return stats_m; }
+
+  private:
+    void reset()
+    {
+      fill_solid(reference_m, G::numLeds, CRGB(0, 0, 0));
+      memset(&stats_m, 0, sizeof(stats_m));
+      head_m = tail_m = used_m = 0;
+      if (sending_m) SerialOut.release(SerialShare::captureWriter);   // that record's torn: the decoder skips it
+      sending_m = 0;
+      credit_m = RING;
+      sinceKey_m = keyframeFrames;    // start with a keyframe
+      skippedRun_m = 0;
+      lastBeats_m = 0xFFFF;
+      lastBars_m = 0xFF;
+    }
+
+    // budget earned since the last frame, at most a ring full
+    void refill(unsigned long nowUs)
+    {
+      uint32_t us = nowUs - lastUs_m;
+      uint32_t earned = us / (1000000UL / bytesPerSec_m);
+      lastUs_m += earned * (1000000UL / bytesPerSec_m);
+      credit_m = credit_m + earned > RING ? RING : credit_m + earned;
+    }
+
+    /******************************/
+    /*          ENCODER           */
+    /******************************/
+    // Writes a record after head_m without committing it. Its size, or 0 if
+    // it didn't fit in the ring.
+    uint16_t encode(const CRGB *leds, bool key, uint8_t flags, uint16_t beats, uint16_t phase, uint8_t brightness)
+    {
+      free_m = RING - used_m;
+      at_m = head_m;
+      written_m = 0;
+      crc_m = 0;
+      put(sync, false);
+      put(key ? 'K' : 'D');
+      uint16_t lengthAt = at_m;
+      put(0, false);    // length, filled in below
+      put(0, false);
+      uint16_t start = written_m;
+      if (key) { put(G::numCols); put(G::numRows); }
+      put(flags);
+      put(skippedRun_m);
+      unsigned long ms = millis();
+      for (uint8_t i = 0; i < 4; i++) put(ms >> (8 * i));
+      put(beats); put(beats >> 8);
+      put(phase >> 8);
+      put(brightness);
+
+      const uint8_t *cur = leds[0].raw;
+      const uint8_t *ref = reference_m[0].raw;
+      const uint16_t n = G::numLeds * 3;
+      for (uint16_t i = 0; i < n; ) {
+        if (delta(cur, ref, i, key) == 0) {
+          uint8_t run = 1;
+          while (i + run < n && run < 128 && delta(cur, ref, i + run, key) == 0) run++;
+          put(0x80 | (run - 1));
+          i += run;
+        } else {
+          // literals until two unchanged bytes in a row (one is cheaper to send than to break off for)
+          uint8_t len = 1;
+          while (i + len < n && len < 128 &&
+                 !(delta(cur, ref, i + len, key) == 0 && (i + len + 1 >= n || delta(cur, ref, i + len + 1, key) == 0))) len++;
+          put(len - 1);
+          for (uint8_t k = 0; k < len; k++) put(delta(cur, ref, i + k, key));
+          i += len;
+        }
+        if (overflow()) return 0;
+      }
+      uint16_t length = written_m - start;
+      put(crc_m, false);
+      if (overflow()) return 0;
+      ring_m[lengthAt] = length;
+      ring_m[lengthAt + 1 == RING ? 0 : lengthAt + 1] = length >> 8;
+      return written_m;
+    }
+
+    static uint8_t delta(const uint8_t *cur, const uint8_t *ref, uint16_t i, bool key) { return key ? cur[i] : cur[i] ^ ref[i]; }
+
+    void put(uint8_t b, bool checked = true)
+    {
+      if (written_m < free_m) ring_m[at_m] = b;
+      if (++at_m == RING) at_m = 0;
+      written_m++;
+      if (checked) {
+        crc_m ^= b;
+        for (uint8_t k = 0; k < 8; k++) crc_m = crc_m & 0x80 ? (crc_m << 1) ^ 0x07 : crc_m << 1;
+      }
+    }
+    bool overflow() const { return written_m > free_m; }
+
+    uint16_t bytesPerSec_m;
+    bool on_m;
+    CRGB reference_m[G::numLeds];     // the last frame sent
+    uint8_t ring_m[RING];
+    uint16_t head_m, tail_m, used_m;
+    uint16_t sending_m;               // bytes left of the record going out
+    uint16_t credit_m;                // bytes we may still send, see refill()
+    unsigned long lastUs_m;
+    uint8_t sinceKey_m;
+    uint8_t skippedRun_m;
+    uint16_t lastBeats_m;             // of the last frame sent
+    uint8_t lastBars_m;
+    // encoder state
+    uint16_t at_m, free_m, written_m;
+    uint8_t crc_m;
+    CaptureStats stats_m;
+};
+
+#endif /* FRAMECAPTURE_H */
@@ -0,0 +1,97 @@
+//// FrameScheduler.h
+// Deadline based frame timing on a fixed microsecond timeline
+//
+// Frames are due at deadline, deadline + period, deadline + 2*period...
+// regardless of when the previous frame actually ran, so a late frame
+// doesn't push every later frame back (no drift). If we're late by less
+// than a period the frame is rendered straight away (catch up); whole
+// periods that have already gone by are dropped and counted as missed,
+// as a stale frame is no use to anyone.
+// The period can be locked to the beat so a whole number of frames fit in
+// each beat and frames land on the beat.
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <Arduino.h>
+
+struct FrameStats
+{
+  unsigned long frames;     // frames rendered
+  unsigned long missed;     // deadlines dropped because we were more than a period late
+  unsigned long overruns;   // frames whose render + show took longer than a period
+  uint32_t maxLateUs;       // worst lateness of a rendered frame
+  uint32_t jitterUs;        // smoothed lateness of rendered frames (1/16 EWMA)
+  uint32_t costUs;          // smoothed render + show time (1/16 EWMA)
+  uint32_t maxCostUs;       // worst render + show time
+};
+
+class FrameScheduler
+{
+  public:
+    FrameScheduler(uint8_t fps) : nominalUs_m(1000000UL / fps), periodUs_m(1000000UL / fps), deadline_m(0),
+                                  frameStart_m(0), maxCatchUp_m(0), started_m(false) { resetStats(); }
+
+    // Call every loop. True if a frame should be rendered now.
+    bool frameDue(unsigned long nowUs)
+    {
+      if (!started_m) { deadline_m = nowUs; started_m = true; }
+      long late = (long)(nowUs - deadline_m);
+      if (late < 0) return false;
+
+      // drop the deadlines we've completely missed, keeping to the timeline
+      uint32_t behind = (uint32_t)late / periodUs_m;
+      if (behind > maxCatchUp_m) {
+        uint32_t drop = behind - maxCatchUp_m;
+        stats_m.missed += drop;
+        deadline_m += drop * periodUs_m;
+        late -= drop * periodUs_m;
+      }
+
+      if ((uint32_t)late > stats_m.maxLateUs) stats_m.maxLateUs = late;
+      stats_m.jitterUs += ((int32_t)late - (int32_t)stats_m.jitterUs) / 16;
+      stats_m.frames++;
+      deadline_m += periodUs_m;
+      frameStart_m = nowUs;
+      return true;
+    }
+
+    // Call once the frame has been rendered and shown; its render + show time
+    uint32_t frameDone(unsigned long nowUs)
+    {
+      uint32_t cost = nowUs - frameStart_m;
+      if (cost > periodUs_m) stats_m.overruns++;
+      if (cost > stats_m.maxCostUs) stats_m.maxCostUs = cost;
+      stats_m.costUs += ((int32_t)cost - (int32_t)stats_m.costUs) / 16;
+      return cost;
+    }
+
+    // Adjust the period so a whole number of frames fit in one beat
+    void lockToBeat(uint32_t beatUs)
+    {
+      if (beatUs == 0) { periodUs_m = nominalUs_m; return; }
+      uint32_t framesPerBeat = (beatUs + nominalUs_m / 2) / nominalUs_m;
+      if (framesPerBeat == 0) framesPerBeat = 1;
+      periodUs_m = beatUs / framesPerBeat;
+    }
+    // Restart the timeline so the next frame is due at nowUs (e.g. on a tap)
+    void syncTo(unsigned long nowUs) { deadline_m = nowUs; started_m = true; }
+
+    void setFPS(uint8_t fps) { nominalUs_m = periodUs_m = 1000000UL / fps; }
+    void setMaxCatchUp(uint8_t frames) { maxCatchUp_m = frames; }    // late frames rendered back to back before dropping
+    uint32_t periodUs() const { return periodUs_m; }
+    uint32_t nominalPeriodUs() const { return nominalUs_m; }
+    unsigned long deadline() const { return deadline_m; }     // when the next frame is due
+    const FrameStats &stats() const { return stats_m; }
+    void resetStats() { memset(&stats_m, 0, sizeof(stats_m)); }
+
+  private:
+    uint32_t nominalUs_m;       // period asked for
+    uint32_t periodUs_m;        // period in use (nominal, adjusted to fit the beat)
+    unsigned long deadline_m;   // when the next frame is due
+    unsigned long frameStart_m;
+    uint8_t maxCatchUp_m;
+    bool started_m;
+    FrameStats stats_m;
+};
+
+#endif /* FRAMESCHEDULER_H */
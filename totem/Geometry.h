@@ -0,0 +1,191 @@
+//// Geometry.h
+// Compile time description of how the LEDs are wired around the globe
+//
+// LEDs run bottom to top, column by column, clockwise. With serpentine
+// wiring every odd column runs top to bottom instead.
+// The row/col -> index and index -> row/col tables are built by the
+// compiler for the chosen layout, and patterns get light weight views of a
+// row, column or diagonal to iterate over instead of doing index maths per pixel.
+// The tables are in flash (PROGMEM), 4 bytes an LED that would otherwise
+// be SRAM on the AVR; a lookup is a pgm_read, a cycle more than a load.
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <FastLED.h>
+
+/******************************/
+/*     COMPILE TIME TABLES    */
+/******************************/
+// IndexList<0, 1, ... N-1>, built in log(N) steps so large matrices stay
+// well inside the compiler's template depth limit
+template<unsigned... I> struct IndexList {};
+
+template<class A, class B> struct ConcatIndexList;
+template<unsigned... I, unsigned... J>
+struct ConcatIndexList<IndexList<I...>, IndexList<J...> >
+{
+  typedef IndexList<I..., (sizeof...(I) + J)...> type;
+};
+
+template<unsigned N> struct MakeIndexList
+  : ConcatIndexList<typename MakeIndexList<N / 2>::type, typename MakeIndexList<N - N / 2>::type> {};
+template<> struct MakeIndexList<0> { typedef IndexList<> type; };
+template<> struct MakeIndexList<1> { typedef IndexList<0> type; };
+
+template<bool B, class T, class F> struct Conditional { typedef T type; };
+template<class T, class F> struct Conditional<false, T, F> { typedef F type; };
+
+// An entry of an index table in flash
+inline uint8_t loadIndex(const uint8_t *p) { return pgm_read_byte(p); }
+inline uint16_t loadIndex(const uint16_t *p) { return pgm_read_word(p); }
+
+/******************************/
+/*           VIEWS            */
+/******************************/
+// Every pixel a fixed distance from the one before (a column, or a row when
+// the wiring isn't serpentine)
+class StridedView
+{
+  public:
+    class iterator
+    {
+      public:
+        iterator(CRGB *p, int16_t stride) : p_m(p), stride_m(stride) {}
+        CRGB &operator*() const { return *p_m; }
+        iterator &operator++() { p_m += stride_m; return *this; }
+        bool operator!=(const iterator &rhs) const { return p_m != rhs.p_m; }
+      private:
+        CRGB *p_m;
+        int16_t stride_m;
+    };
+
+    StridedView(CRGB *first, int16_t stride, uint8_t count) : first_m(first), stride_m(stride), count_m(count) {}
+    CRGB &operator[](uint8_t i) const { return first_m[i * stride_m]; }
+    uint8_t size() const { return count_m; }
+    iterator begin() const { return iterator(first_m, stride_m); }
+    iterator end() const { return iterator(first_m + count_m * stride_m, stride_m); }
+
+  private:
+    CRGB *first_m;
+    int16_t stride_m;
+    uint8_t count_m;
+};
+
+// Pixels picked out by a precomputed index table in flash (serpentine rows,
+// diagonals). Index is uint8_t up to 256 LEDs, uint16_t beyond.
+template<class Index>
+class IndexedView
+{
+  public:
+    class iterator
+    {
+      public:
+        iterator(CRGB *leds, const Index *idx) : leds_m(leds), idx_m(idx) {}
+        CRGB &operator*() const { return leds_m[loadIndex(idx_m)]; }
+        iterator &operator++() { ++idx_m; return *this; }
+        bool operator!=(const iterator &rhs) const { return idx_m != rhs.idx_m; }
+      private:
+        CRGB *leds_m;
+        const Index *idx_m;
+    };
+
+    IndexedView(CRGB *leds, const Index *idx, uint8_t count) : leds_m(leds), idx_m(idx), count_m(count) {}
+    CRGB &operator[](uint8_t i) const { return leds_m[loadIndex(idx_m + i)]; }
+    uint8_t size() const { return count_m; }
+    iterator begin() const { return iterator(leds_m, idx_m); }
+    iterator end() const { return iterator(leds_m, idx_m + count_m); }
+
+  private:
+    CRGB *leds_m;
+    const Index *idx_m;
+    uint8_t count_m;
+};
+
+/******************************/
+/*          GEOMETRY          */
+/******************************/
+template<uint8_t COLS, uint8_t ROWS, bool SERPENTINE,
+         class Seq = typename MakeIndexList<COLS * ROWS>::type>
+struct MatrixGeometry;
+
+template<uint8_t COLS, uint8_t ROWS, bool SERPENTINE, unsigned... I>
+struct MatrixGeometry<COLS, ROWS, SERPENTINE, IndexList<I...> >
+{
+    static const uint8_t numCols = COLS;
+    static const uint8_t numRows = ROWS;
+    static const uint16_t numLeds = COLS * ROWS;
+
+    // Smallest type that can index every LED: a byte for the 8x8 globe,
+    // 16 bits for big poles (up to 255 x 255)
+    typedef typename Conditional<(COLS * ROWS <= 256), uint8_t, uint16_t>::type Index;
+
+    // Rows of a serpentine matrix zig-zag, so they need the index table
+    typedef typename Conditional<SERPENTINE, IndexedView<Index>, StridedView>::type RowView;
+    typedef StridedView ColView;
+    typedef IndexedView<Index> DiagView;
+
+    // index of the led at row & col, usable in constant expressions
+    static constexpr Index ledIndex(unsigned row, unsigned col)
+    {
+      return (SERPENTINE && (col & 0x01)) ? col * ROWS + (ROWS - 1 - row) : col * ROWS + row;
+    }
+
+    static Index at(uint8_t row, uint8_t col) { return loadIndex(&xy[row * COLS + col]); }
+    static uint8_t rowOf(Index i) { return pgm_read_byte(&rowOfIndex[i]); }
+    static uint8_t colOf(Index i) { return pgm_read_byte(&colOfIndex[i]); }
+
+    // The matrix is wrapped around a pole, so columns wrap: column -1 is
+    // the last one, column COLS is column 0 again
+    static uint8_t wrapCol(int16_t c) { return c >= 0 ? c % COLS : COLS - 1 - (-1 - c) % COLS; }
+    static Index atWrapped(uint8_t row, int16_t col) { return at(row, wrapCol(col)); }
+    // shortest way round from column a to column b, -COLS/2..COLS/2
+    static int16_t colDelta(uint8_t a, uint8_t b)
+    {
+      int16_t d = (int16_t)b - a;
+      if (d > COLS / 2) d -= COLS;
+      else if (d < -(COLS / 2)) d += COLS;
+      return d;
+    }
+
+    static RowView row(CRGB *leds, uint8_t r) { return makeRow(leds, r, Conditional<SERPENTINE, IndexedView<Index>, StridedView>()); }
+    static ColView col(CRGB *leds, uint8_t c)
+    {
+      // odd serpentine columns run top to bottom, so walk them backwards
+      return (SERPENTINE && (c & 0x01)) ? StridedView(leds + c * ROWS + ROWS - 1, -1, ROWS)
+                                        : StridedView(leds + c * ROWS, 1, ROWS);
+    }
+    // diagonal d climbs one row per column: the pixel in column c is at row (d + c) % ROWS
+    static DiagView diag(CRGB *leds, uint8_t d) { return DiagView(leds, &diagonal[d * COLS], COLS); }
+
+    // in flash: through at(), rowOf(), colOf() and the views
+    static const Index xy[COLS * ROWS];              // [row * COLS + col] -> led index
+    static const uint8_t rowOfIndex[COLS * ROWS];    // led index -> row
+    static const uint8_t colOfIndex[COLS * ROWS];    // led index -> col
+    static const Index diagonal[COLS * ROWS];        // [d * COLS + col] -> led index
+
+  private:
+    static constexpr uint8_t rowAt(unsigned i) { return (SERPENTINE && ((i / ROWS) & 0x01)) ? ROWS - 1 - i % ROWS : i % ROWS; }
+
+    static IndexedView<Index> makeRow(CRGB *leds, uint8_t r, Conditional<true, IndexedView<Index>, StridedView>) { return IndexedView<Index>(leds, &xy[r * COLS], COLS); }
+    static StridedView makeRow(CRGB *leds, uint8_t r, Conditional<false, IndexedView<Index>, StridedView>) { return StridedView(leds + r, ROWS, COLS); }
+};
+
+template<uint8_t COLS, uint8_t ROWS, bool SERPENTINE, unsigned... I>
+const typename MatrixGeometry<COLS, ROWS, SERPENTINE, IndexList<I...> >::Index
+MatrixGeometry<COLS, ROWS, SERPENTINE, IndexList<I...> >::xy[COLS * ROWS] PROGMEM =
+  { ledIndex(I / COLS, I % COLS)... };
+
+template<uint8_t COLS, uint8_t ROWS, bool SERPENTINE, unsigned... I>
+const uint8_t MatrixGeometry<COLS, ROWS, SERPENTINE, IndexList<I...> >::rowOfIndex[COLS * ROWS] PROGMEM =
+  { rowAt(I)... };
+
+template<uint8_t COLS, uint8_t ROWS, bool SERPENTINE, unsigned... I>
+const uint8_t MatrixGeometry<COLS, ROWS, SERPENTINE, IndexList<I...> >::colOfIndex[COLS * ROWS] PROGMEM =
+  { (uint8_t)(I / ROWS)... };
+
+template<uint8_t COLS, uint8_t ROWS, bool SERPENTINE, unsigned... I>
+const typename MatrixGeometry<COLS, ROWS, SERPENTINE, IndexList<I...> >::Index
+MatrixGeometry<COLS, ROWS, SERPENTINE, IndexList<I...> >::diagonal[COLS * ROWS] PROGMEM =
+  { ledIndex((I / COLS + I % COLS) % ROWS, I % COLS)... };
+
+#endif /* GEOMETRY_H */
@@ -0,0 +1,166 @@
+//// Kernels.h
+// Colour operations over many pixels at once: fade, scale, saturating add,
+// hue gradients, and fades that leave some pixels out
+//
+// The ...Span ones work on pixels next to each other in memory, as a run
+// of bytes (CRGB is 3 bytes, r g b): one loop over the bytes with nothing
+// in it but the arithmetic, which the host compiler turns into SSE/AVX,
+// and on the AVR a pixel's 3 bytes a pass, so the loop's own cost is a
+// third. The ...Set ones take a Geometry view (a row, column or diagonal)
+// and do the same a pixel at a time, with no index maths in the loop.
+// fadeSpanExcept() fades a whole frame bar one view: the view is put
+// aside, the frame faded in one span, and the view put back, rather than
+// testing every pixel for whether it's in it.
+// Hues come from a table of the 256 fully saturated colours, made by the
+// compiler and kept in flash (768 bytes), rather than through hsv2rgb for
+// every pixel; saturation and value are then put on over the span.
+// Each gives exactly what FastLED's per pixel operation would
+// (fadeToBlackBy, nscale8, nscale8_video, +=, CHSV): patterns can move
+// over without a pixel changing.
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <FastLED.h>
+#include "Config.h"
+
+// Every byte of n pixels through op
+template<class Op>
+inline void eachByte(CRGB *leds, uint16_t n, Op op)
+{
+  uint8_t *p = leds[0].raw;
+#if defined(__AVR__)
+  for (uint8_t *end = p + n * 3; p != end; p += 3) {
+    p[0] = op(p[0]);
+    p[1] = op(p[1]);
+    p[2] = op(p[2]);
+  }
+#else
+  for (uint32_t i = 0; i < n * 3UL; i++) p[i] = op(p[i]);    // n * 3 passes 65535 on a big install
+#endif
+}
+
+// As nscale8
+inline void scaleSpan(CRGB *leds, uint16_t n, uint8_t scale)
+{
+  eachByte(leds, n, [scale](uint8_t x) { return scale8(x, scale); });
+}
+
+// As nscale8_video: never scales a lit channel down to nothing
+inline void scaleSpanVideo(CRGB *leds, uint16_t n, uint8_t scale)
+{
+  eachByte(leds, n, [scale](uint8_t x) { return scale8_video(x, scale); });
+}
+
+// As fadeToBlackBy
+inline void fadeSpan(CRGB *leds, uint16_t n, uint8_t fadeBy)
+{
+  scaleSpan(leds, n, 255 - fadeBy);
+}
+
+// a[i] <-> b[i]
+inline void swapSpan(CRGB *a, CRGB *b, uint16_t n)
+{
+  for (uint16_t i = 0; i < n; i++) { CRGB t = a[i]; a[i] = b[i]; b[i] = t; }
+}
+
+// leds[i] += add[i], saturating
+inline void addSpan(CRGB *leds, const CRGB *add, uint16_t n)
+{
+  uint8_t *p = leds[0].raw;
+  const uint8_t *q = add[0].raw;
+  for (uint32_t i = 0; i < n * 3UL; i++) p[i] = qadd8(p[i], q[i]);
+}
+
+// Pixels made with CHSV(hue, 255, 255) as they'd be with CHSV(hue, sat,
+// val). hsv2rgb_rainbow picks the colour from the hue, then desaturates
+// and dims it channel by channel: the first part a pixel at a time, this
+// over the span.
+inline void satValSpan(CRGB *leds, uint16_t n, uint8_t sat, uint8_t val = 255)
+{
+  if (sat != 255) {
+    if (sat == 0) {
+      fill_solid(leds, n, CRGB::White);
+    } else {
+      uint8_t desat = scale8_video(255 - sat, 255 - sat);
+      uint8_t satscale = 255 - desat;
+      eachByte(leds, n, [=](uint8_t x) { return (uint8_t)(scale8(x, satscale) + desat); });
+    }
+  }
+  if (val != 255) scaleSpan(leds, n, scale8_video(val, val));
+}
+
+// CHSV(hue, 255, 255) of every hue, worked out by the compiler as
+// hsv2rgb_rainbow does it (with the yellow boost), kept in flash: r g b
+// for hue 0, then hue 1...
+template<class Seq = typename MakeIndexList<256 * 3>::type> struct RainbowTable;
+template<unsigned... I>
+struct RainbowTable<IndexList<I...> >
+{
+    static const uint8_t rgb[256 * 3];
+
+  private:
+    static constexpr uint8_t part(unsigned h, unsigned parts) { return (((h & 0x1F) << 3) * (1 + 256 * parts / 3)) >> 8; }
+    static constexpr uint8_t channel(unsigned h, unsigned c)
+    {
+      return (h >> 5) == 0 ? (c == 0 ? 255 - part(h, 1) : c == 1 ? part(h, 1) : 0)
+           : (h >> 5) == 1 ? (c == 0 ? 171 : c == 1 ? 85 + part(h, 1) : 0)
+           : (h >> 5) == 2 ? (c == 0 ? 171 - part(h, 2) : c == 1 ? 170 + part(h, 1) : 0)
+           : (h >> 5) == 3 ? (c == 0 ? 0 : c == 1 ? 255 - part(h, 1) : part(h, 1))
+           : (h >> 5) == 4 ? (c == 0 ? 0 : c == 1 ? 171 - part(h, 2) : 85 + part(h, 2))
+           : (h >> 5) == 5 ? (c == 0 ? part(h, 1) : c == 1 ? 0 : 255 - part(h, 1))
+           : (h >> 5) == 6 ? (c == 0 ? 85 + part(h, 1) : c == 1 ? 0 : 171 - part(h, 1))
+           :                 (c == 0 ? 170 + part(h, 1) : c == 1 ? 0 : 85 - part(h, 1));
+    }
+};
+
+template<unsigned... I>
+const uint8_t RainbowTable<IndexList<I...> >::rgb[256 * 3] PROGMEM = { channel(I / 3, I % 3)... };
+
+// led = CHSV(hue, 255, 255), from the table
+inline void rainbowHue(CRGB &led, uint8_t hue)
+{
+  memcpy_P(led.raw, &RainbowTable<>::rgb[hue * 3], 3);
+}
+
+// leds[i] = CHSV(hue + i * step, sat, val), with no hsv2rgb a pixel
+inline void hueSpan(CRGB *leds, uint16_t n, uint8_t hue, uint8_t step, uint8_t sat = 255, uint8_t val = 255)
+{
+  for (uint16_t i = 0; i < n; i++, hue += step) rainbowHue(leds[i], hue);
+  satValSpan(leds, n, sat, val);
+}
+
+// Every pixel of the view (a Geometry row, column or diagonal) faded, as fadeToBlackBy
+template<class View>
+inline void fadeSet(const View &view, uint8_t fadeBy)
+{
+  uint8_t scale = 255 - fadeBy;
+  for (CRGB &led : view) {
+    led.r = scale8(led.r, scale);
+    led.g = scale8(led.g, scale);
+    led.b = scale8(led.b, scale);
+  }
+}
+
+// view[i] += CHSV(hue + i * step, sat, val): the gradient's made as a span, then added
+template<class View>
+inline void addHueSet(const View &view, uint8_t hue, uint8_t step, uint8_t sat = 255, uint8_t val = 255)
+{
+  CRGB gradient[NUM_COLS > NUM_ROWS ? NUM_COLS : NUM_ROWS];
+  hueSpan(gradient, view.size(), hue, step, sat, val);
+  uint8_t i = 0;
+  for (CRGB &led : view) led += gradient[i++];
+}
+
+// All n pixels faded bar the ones in the view, which are left as they were
+template<class View>
+inline void fadeSpanExcept(CRGB *leds, uint16_t n, const View &keep, uint8_t fadeBy)
+{
+  CRGB kept[NUM_COLS > NUM_ROWS ? NUM_COLS : NUM_ROWS];
+  uint8_t i = 0;
+  for (CRGB &led : keep) kept[i++] = led;
+  fadeSpan(leds, n, fadeBy);
+  i = 0;
+  for (CRGB &led : keep) led = kept[i++];
+}
+
+#endif /* KERNELS_H */
@@ -0,0 +1,207 @@
+//// Log.h
+// Compact binary event log, sent out of Serial without ever holding up the loop
+//
+// LOG(LogTap, periodMs, bpm) puts a record in a small ring buffer: an event
+// id and the raw bytes of its arguments. There are no format strings on the
+// pole; the text for each event lives in LOG_EVENTS below and is only used
+// by the host decoder (host/log/log_decode). Logger::service(), called
+// every loop, sends what it can without blocking: no more than the Serial
+// TX buffer has room for, and only for up to serviceBudgetUs. When the ring
+// is full records are dropped and counted, and a LogDropped record says how
+// many once there's room again.
+//
+// Record: 0xC3, id, argument bytes n, millis() (low 16 bits), n bytes of
+// arguments (as in memory, little endian), then the 8 bit sum of id to the
+// last argument byte.
+// Serial is shared with the frame capture (FrameCapture.h) a record at a
+// time, through SerialShare: neither cuts into the other's records, and the
+// host decoders each skip the other's.
+//
+// Undefine LOGGING in Config.h and LOG() compiles to nothing.
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+
+// X(id, text): {u8} {u16} {u32} {i8} {i16} {i32} stand for the arguments in
+// order, {u8:a,b,c} names a u8 by its value, {pattern} is a pattern number
+// and {stage} a profiler stage (Profiler.h), both a u8
+#define LOG_EVENTS(X) \
+  X(LogDropped,    "{u16} log records dropped") \
+  X(LogBoot,       "setup complete: {u16} LEDs on {u8} strips") \
+  X(LogButton,     "button {u8:toggle,inc,dec,fn} {u8:-,press,long press,repeat,release} (held {u16} ms)") \
+  X(LogUIState,    "UI state {u8:pattern,brightness,speed}") \
+  X(LogPattern,    "pattern {pattern}") \
+  X(LogBrightness, "brightness {u8}") \
+  X(LogTap,        "tap: {u16} ms between beats, {u8} BPM") \
+  X(LogAudioLock,  "audio {u8:lost,locked} at {u16} BPM, confidence {u8}") \
+  X(LogSettings,   "settings {u8:restored from,saved to} record {u16}, slot {u16}") \
+  X(LogProfile,    "profile {stage}: {u16} times, min {u16} mean {u16} max {u16} us;" \
+                   " from <8 us, doubling: {u16} {u16} {u16} {u16} {u16} {u16} {u16} {u16} {u16} {u16} {u16} {u16}") \
+  X(LogPlaylist,   "playlist {u8:off,on} {u8}") \
+  X(LogFrameRate,  "frame rate {u8} FPS, quality {u8:full,reduced,minimal}, {u16} us a frame")
+
+#define LOG_EVENT_ID(id, text) id,
+enum LogEvent : uint8_t { LOG_EVENTS(LOG_EVENT_ID) numLogEvents };
+#undef LOG_EVENT_ID
+
+// Who has Serial. A binary stream takes it at the start of a record and
+// gives it back at the end; if the other stream wanted it meanwhile, it
+// should stop there and let that one have a turn.
+class SerialShare
+{
+  public:
+    enum Writer : uint8_t {logWriter = 1, captureWriter = 2};
+
+    constexpr SerialShare() : owner_m(0), waiting_m(0) {}
+
+    // True if w has the port (already, or now)
+    bool take(Writer w)
+    {
+      if (owner_m == w) return true;
+      if (owner_m) { waiting_m |= w; return false; }
+      owner_m = w;
+      waiting_m &= ~w;
+      return true;
+    }
+    // At the end of w's record: true if the other is waiting for the port
+    bool release(Writer w)
+    {
+      if (owner_m == w) owner_m = 0;
+      return waiting_m & ~w;
+    }
+
+  private:
+    uint8_t owner_m;
+    uint8_t waiting_m;
+};
+
+extern SerialShare SerialOut;   // in Control.cpp
+
+struct LogStats
+{
+  unsigned long records;    // put in the ring
+  unsigned long dropped;    // lost to a full ring
+  unsigned long bytes;      // sent
+};
+
+class Logger
+{
+  public:
+    static const uint8_t sync = 0xC3;
+    static const uint8_t ringSize = 128;            // power of two
+    static const uint8_t headerSize = 5;            // sync, id, length, ms (2)
+    static const uint16_t serviceBudgetUs = 200;    // most time service() spends a loop
+
+    Logger() : head_m(0), tail_m(0), sending_m(0), pendingDrops_m(0) { memset(&stats_m, 0, sizeof(stats_m)); }
+
+    template<class... Args>
+    void event(LogEvent id, Args... args)
+    {
+      uint8_t bytes[ArgBytes<Args...>::value + 1];
+      uint8_t n = 0;
+      pack(bytes, n, args...);
+      record(id, bytes, n);
+    }
+
+    // Call every loop: sends what Serial has room for, within serviceBudgetUs
+    void service()
+    {
+      if (pendingDrops_m) reportDrops();    // as soon as there's room, not at the next event
+      unsigned long start = micros();
+      while (head_m != tail_m && (micros() - start) < serviceBudgetUs) {
+        int room = Serial.availableForWrite();
+        if (room <= 0) return;
+        if (!sending_m) {
+          // the start of a record: the ring only ever holds whole ones
+          if (!SerialOut.take(SerialShare::logWriter)) return;
+          sending_m = headerSize + ring_m[(tail_m + 2) & (ringSize - 1)] + 1;
+        }
+        uint8_t used = (head_m - tail_m) & (ringSize - 1);
+        uint8_t n = tail_m > head_m ? ringSize - tail_m : used;     // up to the end of the ring
+        if (n > room) n = room;
+        if (n > sending_m) n = sending_m;
+        Serial.write(ring_m + tail_m, n);
+        tail_m = (tail_m + n) & (ringSize - 1);
+        sending_m -= n;
+        stats_m.bytes += n;
+        if (!sending_m && SerialOut.release(SerialShare::logWriter)) return;   // the capture's turn
+      }
+    }
+
+    // Whether an event with n argument bytes would go in the ring now
+    bool fits(uint8_t n) const
+    {
+      uint8_t free = (tail_m - head_m - 1) & (ringSize - 1);
+      uint8_t need = headerSize + n + 1 + (pendingDrops_m ? headerSize + sizeof(pendingDrops_m) + 1 : 0);
+      return free >= need;
+    }
+
+    const LogStats &stats() const { return stats_m; }
+
+  private:
+    void record(LogEvent id, const uint8_t *args, uint8_t n)
+    {
+      if (pendingDrops_m && !reportDrops()) { dropped(); return; }
+      if (!put(id, args, n)) dropped();
+    }
+
+    bool reportDrops()
+    {
+      uint16_t drops = pendingDrops_m;
+      if (!put(LogDropped, (const uint8_t *)&drops, sizeof(drops))) return false;
+      pendingDrops_m = 0;
+      return true;
+    }
+
+    bool put(LogEvent id, const uint8_t *args, uint8_t n)
+    {
+      uint8_t free = (tail_m - head_m - 1) & (ringSize - 1);
+      if (free < headerSize + n + 1) return false;
+      uint16_t ms = millis();
+      uint8_t sum = id + n + (ms & 0xFF) + (ms >> 8);
+      push(sync);
+      push(id);
+      push(n);
+      push(ms);
+      push(ms >> 8);
+      for (uint8_t i = 0; i < n; i++) { push(args[i]); sum += args[i]; }
+      push(sum);
+      stats_m.records++;
+      return true;
+    }
+    void push(uint8_t b) { ring_m[head_m] = b; head_m = (head_m + 1) & (ringSize - 1); }
+    void dropped()
+    {
+      stats_m.dropped++;
+      if (pendingDrops_m < 0xFFFF) pendingDrops_m++;
+    }
+
+    template<class... T> struct ArgBytes { static const uint8_t value = 0; };
+    template<class T, class... Rest> struct ArgBytes<T, Rest...> { static const uint8_t value = sizeof(T) + ArgBytes<Rest...>::value; };
+    static void pack(uint8_t *, uint8_t &) {}
+    template<class T, class... Rest>
+    static void pack(uint8_t *out, uint8_t &n, T v, Rest... rest)
+    {
+      memcpy(out + n, &v, sizeof(T));
+      n += sizeof(T);
+      pack(out, n, rest...);
+    }
+
+    uint8_t ring_m[ringSize];
+    uint8_t head_m;
+    uint8_t tail_m;
+    uint8_t sending_m;          // bytes left of the record going out
+    uint16_t pendingDrops_m;    // not yet reported with a LogDropped record
+    LogStats stats_m;
+};
+
+extern Logger Log;      // in Control.cpp
+
+#ifdef LOGGING
+  #define LOG(...)    Log.event(__VA_ARGS__)
+#else
+  #define LOG(...)
+#endif
+
+#endif /* LOG_H */
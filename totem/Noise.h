@@ -0,0 +1,176 @@
+//// Noise.h
+// 3D gradient noise over the globe, for lava, plasma and fire
+//
+// Fixed point Perlin noise: x around the globe (the lattice wraps with the
+// columns, so there's no seam), y up the rows and z through time, moving
+// with the beat clock. Each octave has twice the cells of the one before
+// and half the amplitude.
+// Between two lattice planes in z, what a pixel gets from the four corners
+// around it in x and y doesn't change, only how far it is from each plane.
+// So each plane a pixel sits between is kept, per octave, as two numbers
+// (the x/y part, and the slope in z), and a frame is two multiply-adds and
+// a lerp a pixel an octave. When time crosses into the next cell the top
+// plane becomes the bottom one and only the new top is worked out; the
+// octaves are staggered so they don't all cross on the same frame.
+//
+// The cache is one NoiseField (Noise, in Control.cpp) shared by the noise
+// patterns: NOISE_CACHED_OCTAVES x 4 bytes a pixel of SRAM. It's filled for
+// the NoiseParams it was last used with, so during a transition between
+// two noise patterns both refill it every frame, at about the cost of not
+// caching. Octaves past NOISE_CACHED_OCTAVES are worked out every frame.
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <FastLED.h>
+#include "Config.h"
+
+// How a pattern samples the field. Keep them static const PROGMEM: they're
+// read from flash, and the cache knows them by address.
+struct NoiseParams
+{
+  uint8_t cellsAround;    // lattice cells around the globe, first octave
+  uint8_t cellsPerRow;    // 1/256 cells a row, first octave
+  uint8_t cellsPerBeat;   // 1/256 cells through time a beat, first octave
+  uint8_t seed;
+};
+
+struct NoiseStats
+{
+  unsigned long frames;
+  unsigned long planes;     // planes of an octave worked out for the cache
+};
+
+class NoiseField
+{
+  public:
+    static const uint8_t maxOctaves = 4;
+
+    // f(led, value) for every pixel, value 0..255 around 128, with the
+    // first 'octaves' octaves of the field at this beat and phase
+    template<class F>
+    void render(const NoiseParams &params, uint16_t beats, uint16_t phase, uint8_t octaves, F f)
+    {
+      NoiseParams p;
+      memcpy_P(&p, &params, sizeof(p));
+      if (octaves > maxOctaves) octaves = maxOctaves;
+      uint8_t cached = octaves < cached_m ? octaves : cached_m;
+      if (owner_m != &params) { owner_m = &params; memset(cell_m, 0, sizeof(cell_m)); memset(valid_m, 0, sizeof(valid_m)); }
+
+      uint8_t fz[maxOctaves], wz[maxOctaves], zi[maxOctaves];
+      for (uint8_t o = 0; o < octaves; o++) {
+        uint16_t z = timeAt(p, beats, phase, o);
+        zi[o] = z >> 8;
+        fz[o] = z;
+        wz[o] = fade(fz[o]);
+        if (o < cached) advance(p, o, zi[o]);
+      }
+      stats_m.frames++;
+
+      for (uint16_t i = 0; i < NUM_LEDS; i++) {
+        int16_t sum = 0;
+        for (uint8_t o = 0; o < octaves; o++) {
+          int8_t sb, gb, st, gt;
+          if (o < cached) {
+            uint8_t b = bottom_m[o];
+            sb = s_m[o][b][i]; gb = g_m[o][b][i];
+            st = s_m[o][b ^ 1][i]; gt = g_m[o][b ^ 1][i];
+          } else {
+            plane(p, o, Geometry::colOf(i), Geometry::rowOf(i), zi[o], sb, gb);
+            plane(p, o, Geometry::colOf(i), Geometry::rowOf(i), zi[o] + 1, st, gt);
+          }
+          int16_t below = sb + ((fz[o] * gb) >> 8);
+          int16_t above = st + (((fz[o] - 256) * gt) >> 8);
+          sum += (below + (((above - below) * wz[o]) >> 8)) >> o;
+        }
+        int16_t v = 128 + sum * 2;
+        f(i, (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v));
+      }
+    }
+
+    // For the bench: how many octaves come from the cache (up to NOISE_CACHED_OCTAVES)
+    void setCached(uint8_t n) { cached_m = n < NOISE_CACHED_OCTAVES ? n : NOISE_CACHED_OCTAVES; owner_m = 0; }
+    const NoiseStats &stats() const { return stats_m; }
+
+  private:
+    // z of octave o, 8.8 cells: wraps at 256 cells, as the lattice does
+    static uint16_t timeAt(const NoiseParams &p, uint16_t beats, uint16_t phase, uint8_t o)
+    {
+      uint16_t z = beats * p.cellsPerBeat + (((uint32_t)phase * p.cellsPerBeat) >> 16);
+      return (z << o) + o * 85;     // a third of a cell apart, so they cross at different times
+    }
+
+    // The planes of octave o for time cell zi: the old top plane becomes the bottom
+    void advance(const NoiseParams &p, uint8_t o, uint8_t zi)
+    {
+      if (valid_m[o] && zi == cell_m[o]) return;
+      if (valid_m[o] && zi == (uint8_t)(cell_m[o] + 1)) {
+        bottom_m[o] ^= 1;
+        fill(p, o, bottom_m[o] ^ 1, zi + 1);
+      } else {
+        bottom_m[o] = 0;
+        fill(p, o, 0, zi);
+        fill(p, o, 1, zi + 1);
+      }
+      cell_m[o] = zi;
+      valid_m[o] = true;
+    }
+
+    void fill(const NoiseParams &p, uint8_t o, uint8_t which, uint8_t zl)
+    {
+      for (uint16_t i = 0; i < NUM_LEDS; i++) plane(p, o, Geometry::colOf(i), Geometry::rowOf(i), zl, s_m[o][which][i], g_m[o][which][i]);
+      stats_m.planes++;
+    }
+
+    // What the four lattice corners on plane zl around pixel (col, row) give
+    // it: s, the x/y part, and g, the slope in z; both 1/64 cells
+    static void plane(const NoiseParams &p, uint8_t o, uint8_t col, uint8_t row, uint8_t zl, int8_t &s, int8_t &g)
+    {
+      uint8_t around = p.cellsAround << o;
+      uint16_t x = ((uint32_t)col * around << 8) / NUM_COLS;
+      uint8_t x0 = x >> 8, fx = x;
+      uint8_t x1 = x0 + 1 == around ? 0 : x0 + 1;
+      uint16_t y = row * ((uint16_t)p.cellsPerRow << o);
+      uint8_t y0 = y >> 8, fy = y;
+      uint8_t seed = p.seed + o * 101;
+
+      uint8_t g00 = gradient(x0, y0, zl, seed), g10 = gradient(x1, y0, zl, seed);
+      uint8_t g01 = gradient(x0, y0 + 1, zl, seed), g11 = gradient(x1, y0 + 1, zl, seed);
+      uint8_t wx = fade(fx), wy = fade(fy);
+      int16_t dx = fx, dy = fy;
+      int16_t s0 = lerp(dot(g00, dx, dy), dot(g10, dx - 256, dy), wx);
+      int16_t s1 = lerp(dot(g01, dx, dy - 256), dot(g11, dx - 256, dy - 256), wx);
+      int16_t g0 = lerp(dz(g00), dz(g10), wx);
+      int16_t g1 = lerp(dz(g01), dz(g11), wx);
+      s = lerp(s0, s1, wy) >> 2;
+      g = lerp(g0, g1, wy) >> 2;
+    }
+
+    // Perlin's gradients, the 12 edges of a cube (4 twice), 2 bits an axis
+    static uint8_t gradient(uint8_t x, uint8_t y, uint8_t z, uint8_t seed)
+    {
+      static const uint8_t edges[16] PROGMEM = {
+        0x1A, 0x18, 0x12, 0x10, 0x26, 0x24, 0x06, 0x04,   // (gx+1) | (gy+1) << 2 | (gz+1) << 4
+        0x29, 0x21, 0x09, 0x01, 0x1A, 0x21, 0x18, 0x01 };
+      uint8_t h = x * 151 + seed;
+      h = (h ^ y) * 101 + 73;
+      h = (h ^ z) * 197 + (h >> 4);
+      return pgm_read_byte(&edges[(h ^ (h >> 5)) & 15]);
+    }
+    static int16_t dot(uint8_t g, int16_t dx, int16_t dy) { return ((g & 3) - 1) * dx + (((g >> 2) & 3) - 1) * dy; }
+    static int16_t dz(uint8_t g) { return (((g >> 4) & 3) - 1) * 256; }
+    static int16_t lerp(int16_t a, int16_t b, uint8_t w) { return a + (((int32_t)(b - a) * w) >> 8); }
+    static uint8_t fade(uint8_t t) { return ((uint32_t)t * t * (768 - 2 * t)) >> 16; }     // 3t^2 - 2t^3
+
+    const NoiseParams *owner_m = 0;
+    uint8_t cached_m = NOISE_CACHED_OCTAVES;
+    uint8_t cell_m[maxOctaves];
+    uint8_t bottom_m[maxOctaves];
+    bool valid_m[maxOctaves];
+    int8_t s_m[NOISE_CACHED_OCTAVES][2][NUM_LEDS];
+    int8_t g_m[NOISE_CACHED_OCTAVES][2][NUM_LEDS];
+    NoiseStats stats_m = NoiseStats();
+};
+
+extern NoiseField Noise;    // in Control.cpp
+
+#endif /* NOISE_H */
@@ -0,0 +1,301 @@
+//// Osc.h
+// Remote control over OSC (Open Sound Control) on UDP, e.g. TouchOSC on a phone
+//
+// Messages are parsed in place in one small buffer: the address and any
+// string arguments are pointers into it and numbers are read out of it when
+// they're asked for, so there's no heap and no copying beyond the UDP
+// library's read(). Bundles aren't taken apart (phone apps send plain
+// messages); they're dropped and counted along with malformed packets.
+//
+//   /pattern i          pattern by number (a float is truncated)
+//   /pattern/next       and /pattern/prev
+//   /brightness f|i     0-1 as a float (a fader), 0-255 as an int
+//   /tempo f|i          BPM
+//   /tap [f|i]          a tap, unless the argument is 0 (a button let go)
+//
+// service() takes at most maxPacketsPerService packets a loop and leaves the
+// rest in the network stack (which drops what it can't hold), so a burst of
+// messages costs a frame no more than a few small parses.
+// The state goes back to whoever last sent us something, on the feedback
+// port: /pattern, /pattern/name, /brightness (0-1) and /tempo, only what
+// changed since it was last sent (by OSC or the buttons), at most every
+// feedbackMs.
+#ifndef OSC_H
+#define OSC_H
+
+#include <Arduino.h>
+#include <Udp.h>
+#include "Control.h"
+#include "Profiler.h"
+
+/******************************/
+/*          MESSAGES          */
+/******************************/
+// One OSC message, parsed where it lies; valid for as long as the buffer is
+class OscMessage
+{
+  public:
+    static const uint8_t maxArgs = 4;
+
+    OscMessage() : buf_m(0), address_m(""), types_m(""), count_m(0) {}
+
+    // Checks the whole message and finds its arguments; false if it isn't one
+    bool parse(const uint8_t *buf, uint16_t len)
+    {
+      buf_m = buf;
+      address_m = "";
+      types_m = "";
+      count_m = 0;
+      if (len < 8 || (len & 3) || buf[0] != '/') return false;
+      uint32_t at = skipString(buf, 0, len);
+      if (at == 0 || at >= len || buf[at] != ',') return false;
+      const char *types = (const char *)buf + at + 1;
+      at = skipString(buf, at, len);
+      if (at == 0) return false;
+      for (const char *t = types; *t; t++) {
+        if (count_m == maxArgs) return false;
+        argAt_m[count_m++] = at;
+        switch (*t) {
+          case 'i': case 'f': case 'c': case 'r': case 'm': at += 4; break;
+          case 'h': case 't': case 'd': at += 8; break;
+          case 's': case 'S': at = at < len ? skipString(buf, at, len) : 0; if (at == 0) return false; break;
+          case 'b': if (at + 4 > len) return false; at += 4 + ((be32(buf + at) + 3) & ~3UL); break;
+          case 'T': case 'F': case 'N': case 'I': break;
+          default: return false;
+        }
+        if (at > len) return false;
+      }
+      address_m = (const char *)buf;
+      types_m = types;
+      return true;
+    }
+
+    const char *address() const { return address_m; }
+    bool is(const char *address) const { return strcmp(address_m, address) == 0; }
+    uint8_t count() const { return count_m; }
+    char type(uint8_t i) const { return i < count_m ? types_m[i] : 0; }
+
+    // Numbers as either type: floats truncate, T is 1, anything else 0
+    int32_t asInt(uint8_t i) const
+    {
+      switch (type(i)) {
+        case 'i': return (int32_t)be32(buf_m + argAt_m[i]);
+        case 'f': return (int32_t)asFloat(i);
+        case 'T': return 1;
+        default:  return 0;
+      }
+    }
+    float asFloat(uint8_t i) const
+    {
+      switch (type(i)) {
+        case 'f': { uint32_t bits = be32(buf_m + argAt_m[i]); float f; memcpy(&f, &bits, sizeof(f)); return f; }
+        case 'i': return (float)(int32_t)be32(buf_m + argAt_m[i]);
+        case 'T': return 1;
+        default:  return 0;
+      }
+    }
+    const char *asString(uint8_t i) const { return type(i) == 's' || type(i) == 'S' ? (const char *)buf_m + argAt_m[i] : ""; }
+
+    static uint32_t be32(const uint8_t *p) { return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]; }
+
+  private:
+    // Past the string at 'at' and its padding to 4 bytes; 0 if it isn't ended within len
+    static uint32_t skipString(const uint8_t *buf, uint32_t at, uint16_t len)
+    {
+      while (at < len && buf[at]) at++;
+      if (at >= len) return 0;
+      return (at + 4) & ~3UL;
+    }
+
+    const uint8_t *buf_m;
+    const char *address_m;
+    const char *types_m;
+    uint16_t argAt_m[maxArgs];
+    uint8_t count_m;
+};
+
+// Writes one OSC message into a buffer: address(), then the arguments in
+// the order of the type tags given
+class OscWriter
+{
+  public:
+    OscWriter(uint8_t *buf, uint16_t size) : buf_m(buf), size_m(size), len_m(0), ok_m(true) {}
+
+    OscWriter &address(const char *address, const char *types)
+    {
+      len_m = 0;
+      ok_m = true;
+      string(address);
+      put(',');
+      string(types);
+      return *this;
+    }
+    OscWriter &add(int32_t v) { return add32(v); }
+    OscWriter &add(float v) { uint32_t bits; memcpy(&bits, &v, sizeof(bits)); return add32(bits); }
+    OscWriter &add(const char *s) { string(s); return *this; }
+    OscWriter &addP(const char *s) { stringP(s); return *this; }     // a string in flash (PROGMEM)
+
+    bool ok() const { return ok_m; }
+    uint16_t length() const { return len_m; }
+
+  private:
+    OscWriter &add32(uint32_t v)
+    {
+      for (int8_t s = 24; s >= 0; s -= 8) put(v >> s);
+      return *this;
+    }
+    // the string and its terminator, padded to 4 bytes (the ',' of the types counts as part of it)
+    void string(const char *s)
+    {
+      while (*s) put(*s++);
+      do put(0); while (len_m & 3);
+    }
+    void stringP(const char *s)
+    {
+      for (char c; (c = pgm_read_byte(s)); s++) put(c);
+      do put(0); while (len_m & 3);
+    }
+    void put(uint8_t b)
+    {
+      if (len_m < size_m) buf_m[len_m++] = b;
+      else ok_m = false;
+    }
+
+    uint8_t *buf_m;
+    uint16_t size_m;
+    uint16_t len_m;
+    bool ok_m;
+};
+
+/******************************/
+/*          ENDPOINT          */
+/******************************/
+struct OscStats
+{
+  unsigned long packets;        // taken from the network
+  unsigned long handled;        // messages acted on
+  unsigned long bad;            // malformed, bundles, too big for the buffer
+  unsigned long unknown;        // well formed, but not an address we know
+  unsigned long feedback;       // messages sent back
+};
+
+class OscEndpoint
+{
+  public:
+    static const uint8_t bufSize = 64;                // biggest message taken, and feedback is built here too
+    static const uint8_t maxPacketsPerService = 4;
+    static const uint16_t feedbackMs = 100;
+
+    OscEndpoint(Control *c, UDP &udp) : control_m(c), udp_m(udp), feedbackPort_m(0), hasPeer_m(false), lastFeedbackMs_m(0)
+    {
+      memset(&stats_m, 0, sizeof(stats_m));
+      forgetSent();
+    }
+
+    // Listen on port; feedback goes to the sender's address on feedbackPort
+    bool begin(uint16_t port, uint16_t feedbackPort)
+    {
+      feedbackPort_m = feedbackPort;
+      return udp_m.begin(port);
+    }
+
+    // Call every loop
+    void service()
+    {
+      PROFILE(ProfOsc);
+      for (uint8_t i = 0; i < maxPacketsPerService; i++) {
+        int size = udp_m.parsePacket();
+        if (size <= 0) break;
+        stats_m.packets++;
+        if (!hasPeer_m || udp_m.remoteIP() != peer_m) forgetSent();     // someone new: send them everything
+        peer_m = udp_m.remoteIP();
+        hasPeer_m = true;
+        if (size > bufSize) { udp_m.flush(); stats_m.bad++; continue; }
+        int n = udp_m.read(buf_m, size);
+        udp_m.flush();
+        OscMessage m;
+        if (!m.parse(buf_m, n)) { stats_m.bad++; continue; }
+        if (handle(m)) stats_m.handled++;
+        else stats_m.unknown++;
+      }
+      if (hasPeer_m && millis() - lastFeedbackMs_m >= feedbackMs) {
+        lastFeedbackMs_m = millis();
+        feedback();
+      }
+    }
+
+    const OscStats &stats() const { return stats_m; }
+
+  private:
+    bool handle(const OscMessage &m)
+    {
+      if (m.is("/pattern")) {
+        if (m.count() == 0) return false;
+        int32_t p = m.asInt(0);
+        if (p >= 0 && p < Control::getNumPatterns() && p != control_m->getPattern()) control_m->set_pattern(p);
+      } else if (m.is("/pattern/next")) {
+        if (m.count() == 0 || m.asFloat(0) != 0) control_m->inc_pattern();
+      } else if (m.is("/pattern/prev")) {
+        if (m.count() == 0 || m.asFloat(0) != 0) control_m->dec_pattern();
+      } else if (m.is("/brightness")) {
+        if (m.type(0) == 'f') control_m->set_brightness(constrain(m.asFloat(0), 0.0f, 1.0f) * 255 + 0.5f);
+        else if (m.count()) control_m->set_brightness(constrain(m.asInt(0), 0L, 255L));
+        else return false;
+      } else if (m.is("/tempo")) {
+        float bpm = m.asFloat(0);
+        if (bpm < minBpm || bpm > maxBpm) return false;
+        control_m->set_tempo(60000.0f / bpm + 0.5f);
+      } else if (m.is("/tap")) {
+        if (m.count() == 0 || m.asFloat(0) != 0) control_m->tap();
+      } else {
+        return false;
+      }
+      return true;
+    }
+
+    // What changed since it was last sent, to the peer
+    void feedback()
+    {
+      uint8_t pattern = control_m->getPattern();
+      if (pattern != sentPattern_m) {
+        if (send(OscWriter(buf_m, bufSize).address("/pattern", "i").add((int32_t)pattern)) &&
+            send(OscWriter(buf_m, bufSize).address("/pattern/name", "s").addP(Control::getPatternName(pattern)))) sentPattern_m = pattern;
+      }
+      uint8_t brightness = control_m->getBrightness();
+      if (brightness != sentBrightness_m &&
+          send(OscWriter(buf_m, bufSize).address("/brightness", "f").add(brightness / 255.0f))) sentBrightness_m = brightness;
+      uint8_t bpm = control_m->get_BPM();
+      if (bpm != sentBpm_m && send(OscWriter(buf_m, bufSize).address("/tempo", "f").add((float)bpm))) sentBpm_m = bpm;
+    }
+
+    bool send(const OscWriter &w)
+    {
+      if (!w.ok() || !udp_m.beginPacket(peer_m, feedbackPort_m)) return false;
+      udp_m.write(buf_m, w.length());
+      if (!udp_m.endPacket()) return false;
+      stats_m.feedback++;
+      return true;
+    }
+
+    void forgetSent()
+    {
+      sentPattern_m = 0xFF;
+      sentBrightness_m = ~control_m->getBrightness();   // anything it isn't
+      sentBpm_m = 0;
+    }
+
+    static const uint8_t minBpm = 30;
+    static const uint8_t maxBpm = 250;
+
+    Control *control_m;
+    UDP &udp_m;
+    uint16_t feedbackPort_m;
+    IPAddress peer_m;
+    bool hasPeer_m;
+    unsigned long lastFeedbackMs_m;
+    uint8_t sentPattern_m, sentBrightness_m, sentBpm_m;    // as last sent to the peer
+    uint8_t buf_m[bufSize];       // the message being parsed, or feedback being sent
+    OscStats stats_m;
+};
+
+#endif /* OSC_H */
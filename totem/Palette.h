@@ -0,0 +1,159 @@
+//// Palette.h
+// Palettes expanded once into a table of colours, and blended a slice a frame
+//
+// ColorFromPalette works a colour out from the two palette entries either
+// side of its index, for every pixel every frame. The PaletteTable
+// (Palettes, in Control.cpp) does that once for each index when a palette
+// comes in, and a pixel is then a load from the table (and a scale, with a
+// brightness). Nothing is worked out again until the palette changes.
+// A pattern can move to another palette over a number of frames: each
+// frame the 16 entries are blended on from the old palette towards the new
+// one, and every 4th index of the table (a different quarter each frame)
+// is expanded again from them. So a frame of a blend costs a quarter of an
+// expansion whatever the LED count, and the table is never more than 3
+// frames behind the blend.
+// There's one table, shared by the palette patterns, kept by the pattern
+// that last had it while it goes on drawing. During a transition between
+// two of them the other gets its colours worked out from its palette as
+// before, and has the table once the first has stopped.
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <FastLED.h>
+#include "Config.h"
+
+// Colour indexes sharing a table entry, as a shift
+const uint8_t PaletteLutShift = PALETTE_LUT_SIZE >= 256 ? 0 : PALETTE_LUT_SIZE >= 128 ? 1 : PALETTE_LUT_SIZE >= 64 ? 2 : 3;
+
+// A palette's colours for a frame, from the table or worked out
+class PaletteLookup
+{
+  public:
+    explicit PaletteLookup(const CRGB *lut) : lut_m(lut) {}
+    explicit PaletteLookup(const TProgmemRGBPalette16 &p) : lut_m(0), palette_m(p) {}
+
+    CRGB operator()(uint8_t index) const
+    {
+      return lut_m ? lut_m[index >> PaletteLutShift] : ColorFromPalette(palette_m, index);
+    }
+
+    // As ColorFromPalette(palette, index, brightness)
+    CRGB operator()(uint8_t index, uint8_t brightness) const
+    {
+      if (!lut_m) return ColorFromPalette(palette_m, index, brightness);
+      CRGB c = lut_m[index >> PaletteLutShift];
+      if (brightness != 255) {
+        if (!brightness) return CRGB::Black;
+        ++brightness;
+        if (c.r) c.r = scale8(c.r, brightness);
+        if (c.g) c.g = scale8(c.g, brightness);
+        if (c.b) c.b = scale8(c.b, brightness);
+      }
+      return c;
+    }
+
+    bool fromTable() const { return lut_m != 0; }
+
+  private:
+    const CRGB *lut_m;
+    CRGBPalette16 palette_m;    // only without the table
+};
+
+struct PaletteStats
+{
+  unsigned long entries;      // table entries expanded
+  unsigned long worked;       // lookups handed out without the table
+};
+
+class PaletteTable
+{
+  public:
+    static const uint16_t size = PALETTE_LUT_SIZE;
+    static const uint8_t stride = 4;      // a blend expands every 4th entry a frame
+
+    // Once a frame, before the patterns draw: a blend a frame on
+    void frame()
+    {
+      frame_m++;
+      if (!blending_m) return;
+      step_m++;
+      CRGBPalette16 now;
+      blended(now);
+      expand(now, step_m % stride, stride);
+      // past the end, at the new palette, until every entry has been done again
+      if (step_m >= frames_m + stride - 1) { from_m = now; blending_m = false; }
+    }
+
+    // The next other pattern to use() the table may take it, though its
+    // owner used it this frame: a pattern drawn ahead, that's staying
+    void handOver() { used_m = frame_m - 2; }
+
+    // Palette p's colours for the pattern called user (its name()). If the
+    // pattern has the table and p is a new palette, it's blended to over
+    // blendFrames frames (0, straight away); the first time, it's expanded.
+    PaletteLookup use(const char *user, const TProgmemRGBPalette16 &p, uint8_t blendFrames = 0)
+    {
+      if (user != owner_m) {
+        // drawn this frame or the last (a byte of frames: wrapping, it's wrong for two in 256)
+        if (owner_m && (uint8_t)(frame_m - used_m) <= 1) { stats_m.worked++; return PaletteLookup(p); }
+        owner_m = user;
+        palette_m = 0;
+      }
+      used_m = frame_m;
+      if (&p != palette_m) {
+        if (!palette_m || !blendFrames) set(p);
+        else blendTo(p, blendFrames);
+      }
+      return PaletteLookup(lut_m);
+    }
+
+    bool blending() const { return blending_m; }
+    const PaletteStats &stats() const { return stats_m; }
+
+  private:
+    void set(const TProgmemRGBPalette16 &p)
+    {
+      palette_m = &p;
+      from_m = p;
+      blending_m = false;
+      expand(from_m, 0, 1);
+    }
+
+    // From wherever the table is now (part way through a blend, maybe)
+    void blendTo(const TProgmemRGBPalette16 &p, uint8_t frames)
+    {
+      if (blending_m) blended(from_m);
+      palette_m = &p;
+      frames_m = frames;
+      step_m = 0;
+      blending_m = true;
+    }
+
+    // The 16 entries step_m frames into the blend
+    void blended(CRGBPalette16 &now) const
+    {
+      CRGBPalette16 to = *palette_m;
+      uint8_t amount = step_m >= frames_m ? 255 : (uint16_t)step_m * 255 / frames_m;
+      for (uint8_t k = 0; k < 16; k++) now.entries[k] = blend(from_m.entries[k], to.entries[k], amount);
+    }
+
+    void expand(const CRGBPalette16 &p, uint16_t first, uint8_t every)
+    {
+      for (uint16_t i = first; i < size; i += every) lut_m[i] = ColorFromPalette(p, i << PaletteLutShift);
+      stats_m.entries += (size - first + every - 1) / every;
+    }
+
+    const char *owner_m = 0;
+    const TProgmemRGBPalette16 *palette_m = 0;    // showing, or being blended to
+    uint8_t frame_m = 0, used_m = 0;
+    bool blending_m = false;
+    uint8_t frames_m = 0;
+    uint16_t step_m = 0;
+    CRGBPalette16 from_m;     // showing, or being blended from
+    CRGB lut_m[size];
+    PaletteStats stats_m = PaletteStats();
+};
+
+extern PaletteTable Palettes;   // in Control.cpp
+
+#endif /* PALETTE_H */
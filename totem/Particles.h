@@ -0,0 +1,133 @@
+//// Particles.h
+// A fixed pool of moving, fading points of light on the globe
+//
+// ParticlePool<N> holds up to N particles, each field in an array of its own
+// (structure of arrays) so update() and render() walk them in order. There's
+// no heap: the pool is part of the pattern's state. Live particles are
+// packed at the front; one that dies has the last live one moved into its
+// place, so spawning and dying are O(1) and a frame only touches the
+// particles alive in it, not the whole buffer.
+// Positions are 8.8 fixed point pixels: x around the globe, wrapping past
+// the last column, y up the rows; a particle that leaves the rows is gone.
+// Velocities are 1/256 pixel a frame. Each one is drawn shared between the
+// four pixels around it, so it moves smoothly between them, as bright as
+// the life it has left.
+// A pattern built on the pool draws with erase(), update(), render(): the
+// frame holds the particles and nothing else, and it costs nothing for the
+// pixels with none on them. 9 bytes a particle.
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <FastLED.h>
+#include "Config.h"
+
+template<uint8_t N>
+class ParticlePool
+{
+  public:
+    static const uint8_t capacity = N;
+    static const uint16_t width = NUM_COLS * 256;             // x wraps here
+    static const int16_t top = (NUM_ROWS - 1) * 256;          // highest y, on the top row
+    static const uint8_t bytesEach = 9;
+
+    uint8_t live() const { return live_m; }
+    bool full() const { return live_m == N; }
+
+    // A new particle at full life, losing fade of it a frame; false if the pool's full
+    bool spawn(uint16_t x, int16_t y, int8_t vx, int8_t vy, uint8_t hue, uint8_t fade)
+    {
+      if (live_m == N) return false;
+      uint8_t i = live_m++;
+      x_m[i] = x % width;
+      y_m[i] = y;
+      vx_m[i] = vx;
+      vy_m[i] = vy;
+      hue_m[i] = hue;
+      life_m[i] = 255;
+      fade_m[i] = fade;
+      return true;
+    }
+
+    // Zeroes the pixels render() lit last frame. The first time, the whole
+    // frame: it still has whatever the pattern before left in it.
+    void erase(CRGB *leds)
+    {
+      if (!drawn_m) { fill_solid(leds, NUM_LEDS, CRGB::Black); drawn_m = true; return; }
+      for (uint8_t i = 0; i < live_m; i++) {
+        uint8_t col = x_m[i] >> 8, row = y_m[i] >> 8;
+        uint8_t next = Geometry::wrapCol(col + 1);
+        leds[Geometry::at(row, col)] = CRGB::Black;
+        leds[Geometry::at(row, next)] = CRGB::Black;
+        if (row + 1 < NUM_ROWS) {
+          leds[Geometry::at(row + 1, col)] = CRGB::Black;
+          leds[Geometry::at(row + 1, next)] = CRGB::Black;
+        }
+      }
+    }
+
+    // A frame on: moves and ages each live particle, gravity (1/256 pixel a
+    // frame, a frame) pulling on vy, and lets go of the ones that are done
+    void update(int8_t gravity = 0)
+    {
+      uint8_t i = 0;
+      while (i < live_m) {
+        int16_t y = y_m[i] + vy_m[i];
+        if (life_m[i] <= fade_m[i] || y < 0 || y > top) { kill(i); continue; }
+        life_m[i] -= fade_m[i];
+        y_m[i] = y;
+        int16_t vy = vy_m[i] + gravity;
+        vy_m[i] = vy > 127 ? 127 : vy < -128 ? -128 : vy;
+        int32_t x = (int32_t)x_m[i] + vx_m[i];
+        x_m[i] = x < 0 ? x + width : x >= width ? x - width : x;
+        i++;
+      }
+    }
+
+    // Adds each live particle into leds, split between the four pixels around it
+    void render(CRGB *leds, uint8_t saturation = 255) const
+    {
+      for (uint8_t i = 0; i < live_m; i++) {
+        CRGB c = CHSV(hue_m[i], saturation, life_m[i]);
+        uint8_t col = x_m[i] >> 8, row = y_m[i] >> 8;
+        uint8_t fx = x_m[i], fy = y_m[i];
+        uint8_t next = Geometry::wrapCol(col + 1);
+        // weights of the four pixels, summing to 255
+        uint8_t wNextUp = scale8(fx, fy);
+        uint8_t wNext = fx - wNextUp;
+        uint8_t wUp = fy - wNextUp;
+        uint8_t wHere = 255 - qadd8(fx, wUp);
+        leds[Geometry::at(row, col)] += CRGB(c).nscale8(wHere);
+        leds[Geometry::at(row, next)] += CRGB(c).nscale8(wNext);
+        if (row + 1 < NUM_ROWS) {
+          leds[Geometry::at(row + 1, col)] += CRGB(c).nscale8(wUp);
+          leds[Geometry::at(row + 1, next)] += CRGB(c).nscale8(wNextUp);
+        }
+      }
+    }
+
+  private:
+    void kill(uint8_t i)
+    {
+      uint8_t last = --live_m;
+      x_m[i] = x_m[last];
+      y_m[i] = y_m[last];
+      vx_m[i] = vx_m[last];
+      vy_m[i] = vy_m[last];
+      hue_m[i] = hue_m[last];
+      life_m[i] = life_m[last];
+      fade_m[i] = fade_m[last];
+    }
+
+    // no constructor: zeroed, it's empty (see Patterns.h)
+    uint8_t live_m;
+    bool drawn_m;       // erase() has cleared the frame
+    uint16_t x_m[N];
+    int16_t y_m[N];
+    int8_t vx_m[N];
+    int8_t vy_m[N];
+    uint8_t hue_m[N];
+    uint8_t life_m[N];
+    uint8_t fade_m[N];
+};
+
+#endif /* PARTICLES_H */
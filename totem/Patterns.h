@@ -1 +1,348 @@
+//// Patterns.h
+// The light patterns, and the compile time table Control picks them from
+//
+// Each pattern is a plain struct holding its own state, with
+//   static const char *name()               name for display, in flash (PROGMEM)
+//   void init(const PatternContext &ctx)    called when switching to it, after its state is zeroed
+//   void draw(const PatternContext &ctx)    renders one frame into ctx.leds
+// To add a pattern, write the struct and add it to TotemPatterns at the bottom.
+// When frames cost more than the frame rate floor allows, ctx.quality goes
+// down a tier (RateGovernor.h): a pattern with work it can do without leaves
+// it out (noiseOctaves(), particleRoom(), addGlitter() see to the usual ones).
+// No constructors: all the patterns share one block of storage.
+// Names and other constant tables (noise parameters, palette lists) go in
+// flash, as static const ... PROGMEM in name() or draw(): SRAM on the AVR is
+// for frames and state.
+#ifndef PATTERNS_H
+#define PATTERNS_H
 
+#include <FastLED.h>
+#include "Config.h"
+#include "Particles.h"
+#include "Noise.h"
+#include "Palette.h"
+#include "Kernels.h"
+#include "RateGovernor.h"
+
+// Everything a pattern gets to know about the world for one frame
+struct PatternContext
+{
+  CRGB *leds;       // where to draw (NUM_LEDS, laid out per Geometry)
+  uint8_t hue;      // rotating 'base colour' used by patterns
+  uint8_t bpm;
+  uint16_t beats;   // counts up once per beat (and wraps), see newBeat()
+  uint16_t phase;   // 0..65535 through the current beat
+  uint8_t bars;     // counts up once per bar (and wraps), see newBar()
+  uint8_t quality;  // a Quality: QualityFull, or lower when frames are costing too much
+};
+
+/******************************/
+/*          HELPERS           */
+/******************************/
+// True once for each beat. Every pattern keeps its own lastBeat, so one
+// pattern seeing the beat doesn't hide it from another.
+inline bool newBeat(const PatternContext &ctx, uint16_t &lastBeat)
+{
+  bool beat = ctx.beats != lastBeat;
+  lastBeat = ctx.beats;
+  return beat;
+}
+
+inline bool newBar(const PatternContext &ctx, uint8_t &lastBar)
+{
+  bool bar = ctx.bars != lastBar;
+  lastBar = ctx.bars;
+  return bar;
+}
+
+// sin8 of the beat phase (plus an offset), scaled to lowest..highest - beatsin8() locked to the beat clock
+inline uint8_t beatSin8(const PatternContext &ctx, uint8_t lowest, uint8_t highest, uint8_t phase_offset = 0)
+{
+  return lowest + scale8(sin8((ctx.phase >> 8) + phase_offset), highest - lowest);
+}
+
+// Octaves of noise to draw: one fewer a quality tier down, never none
+inline uint8_t noiseOctaves(const PatternContext &ctx)
+{
+  return NOISE_OCTAVES > ctx.quality ? NOISE_OCTAVES - ctx.quality : 1;
+}
+
+// Room for another particle: a quality tier down, half as many as the pool
+// holds. At full quality it's left to spawn(), so frames draw as they always have.
+template <class Pool>
+inline bool particleRoom(const PatternContext &ctx, const Pool &pool)
+{
+  return ctx.quality == QualityFull || pool.live() < (Pool::capacity >> ctx.quality);
+}
+
+// Only at full quality
+inline void addGlitter(const PatternContext &ctx, fract8 chanceOfGlitter = 80)
+{
+  if( ctx.quality == QualityFull && random8() < chanceOfGlitter) {
+    ctx.leds[ random16(NUM_LEDS) ] += CRGB::White;
+  }
+}
+
+inline void pulseToBeat(const PatternContext &ctx)
+{
+  // pulse lights to beat, offset by 90 so peak is at start
+  // scales the frame rather than FastLED's brightness, which belongs to the user (global brightness still applies on top)
+  uint8_t wave_bright = beatSin8(ctx, 255/6, 255, 90);
+  scaleSpanVideo(ctx.leds, NUM_LEDS, wave_bright);
+}
+
+/******************************/
+/*        PATTERNS            */
+/******************************/
+struct Rainbow
+{
+  static const char *name() { static const char n[] PROGMEM = "Rainbow"; return n; }
+  void init(const PatternContext &) {}
+  void draw(const PatternContext &ctx)
+  {
+    // Classic rainbow, maybe have the width represent the speed or something?
+    uint8_t width = 7;
+    hueSpan( ctx.leds, NUM_LEDS, ctx.hue, width, 240);
+
+    // could also have it pulse according to beat
+    pulseToBeat(ctx);
+  }
+};
+
+struct Confetti
+{
+  ParticlePool<MAX_PARTICLES> particles;
+
+  static const char *name() { static const char n[] PROGMEM = "Confetti"; return n; }
+  void init(const PatternContext &) {}
+  void draw(const PatternContext &ctx)
+  {
+    // randomo coloured speckles that blink in on a pixel, drift a little and fade smoothly
+    particles.erase(ctx.leds);
+    particles.update();
+    if (random8() < 96 && particleRoom(ctx, particles)) {
+      particles.spawn(random8(NUM_COLS) << 8, random8(NUM_ROWS) << 8, random8(17) - 8, random8(17) - 8, ctx.hue + random8(64), 6);
+    }
+    particles.render(ctx.leds, 200);
+  }
+};
+
+struct RollingRowsDiag
+{
+  uint8_t currentRow;
+  uint16_t lastBeat;
+
+  static const char *name() { static const char n[] PROGMEM = "Roll Rows (D)"; return n; }
+  void init(const PatternContext &ctx) { currentRow = NUM_ROWS - 1; lastBeat = ctx.beats; }
+  void draw(const PatternContext &ctx)
+  {
+    // scrolls through each of the rows to the top, then starts from the bottom again, in a diagnoal
+    if (newBeat(ctx, lastBeat)) {
+      currentRow = (currentRow + 1) % NUM_ROWS; // select next row and wrap around if at top
+      addHueSet(Geometry::diag(ctx.leds, currentRow), ctx.hue, 15, 255, 192);
+    }
+    // fade every led except the current diagonal
+    fadeSpanExcept(ctx.leds, NUM_LEDS, Geometry::diag(ctx.leds, currentRow), 10);
+  }
+};
+
+struct RollingRows
+{
+  uint8_t currentRow;
+  uint16_t lastBeat;
+
+  static const char *name() { static const char n[] PROGMEM = "Roll Rows"; return n; }
+  void init(const PatternContext &ctx) { currentRow = NUM_ROWS - 1; lastBeat = ctx.beats; }
+  void draw(const PatternContext &ctx)
+  {
+    // scrolls through each of the rows to the top, then starts from the bottom again
+    if (newBeat(ctx, lastBeat)) {
+      currentRow = (currentRow + 1) % NUM_ROWS; // select next row and wrap around if at top
+      addHueSet(Geometry::row(ctx.leds, currentRow), ctx.hue, 15, 255, 192);
+    }
+    // fade every led except current row
+    fadeSpanExcept(ctx.leds, NUM_LEDS, Geometry::row(ctx.leds, currentRow), 10);
+  }
+};
+
+struct ScrollRows
+{
+  static const char *name() { static const char n[] PROGMEM = "Scroll Rows"; return n; }
+  void init(const PatternContext &) {}
+  void draw(const PatternContext &ctx)
+  {
+    // scrolls through each of the rows to the top, then back down, over NUM_ROWS beats
+    fadeSpan( ctx.leds, NUM_LEDS, 20);
+    uint16_t cycle = (((uint32_t)(ctx.beats % NUM_ROWS) << 16) + ctx.phase) / NUM_ROWS;
+    uint8_t pos = scale16(sin16(cycle - 16384) + 32768, NUM_ROWS - 1);  // starts at the bottom row
+    addHueSet(Geometry::row(ctx.leds, pos), ctx.hue, 15, 255, 192);
+  }
+};
+
+struct BPMBoogie
+{
+  uint8_t lastBar;
+  uint8_t palette;
+
+  static const char *name() { static const char n[] PROGMEM = "BPM Boogie"; return n; }
+  void init(const PatternContext &ctx) { lastBar = ctx.bars; }
+  void draw(const PatternContext &ctx)
+  {
+    // all strips pulsing at a defined BPM, no ofset, on a new palette every
+    // 8 bars, blended in over 64 frames
+    static const TProgmemRGBPalette16 *const palettes[] PROGMEM = { &PartyColors_p, &RainbowColors_p, &OceanColors_p, &ForestColors_p };
+    if (newBar(ctx, lastBar) && !(ctx.bars & 7)) palette = (palette + 1) % 4;
+    const TProgmemRGBPalette16 *p;
+    memcpy_P(&p, &palettes[palette], sizeof(p));
+    PaletteLookup colours = Palettes.use(name(), *p, 64);
+    uint8_t beat = beatSin8( ctx, 64, 255, 90);
+    for( uint16_t i = 0; i < NUM_LEDS; i++) {
+      ctx.leds[i] = colours(ctx.hue+(i*2), beat+(i*10));
+    }
+  }
+};
+
+struct Sparks
+{
+  ParticlePool<MAX_PARTICLES> particles;
+  uint16_t lastBeat;
+
+  static const char *name() { static const char n[] PROGMEM = "Sparks"; return n; }
+  void init(const PatternContext &ctx) { lastBeat = ctx.beats; }
+  void draw(const PatternContext &ctx)
+  {
+    // a burst of sparks up from the bottom on each beat, falling back as they fade
+    particles.erase(ctx.leds);
+    particles.update(-3);
+    if (newBeat(ctx, lastBeat)) {
+      uint16_t x = random16(ParticlePool<MAX_PARTICLES>::width);
+      for (uint8_t i = 0; i < 8; i++) {
+        if (!particleRoom(ctx, particles)) break;
+        if (!particles.spawn(x, 0, random8(65) - 32, 80 + random8(48), ctx.hue + random8(32), 4)) break;
+      }
+    }
+    particles.render(ctx.leds);
+  }
+};
+
+struct Lava
+{
+  static const char *name() { static const char n[] PROGMEM = "Lava"; return n; }
+  void init(const PatternContext &) {}
+  void draw(const PatternContext &ctx)
+  {
+    // big slow blobs, a couple around the globe, drifting an eighth of a cell a beat
+    static const NoiseParams params PROGMEM = {2, 64, 32, 1};
+    PaletteLookup colours = Palettes.use(name(), LavaColors_p);
+    Noise.render(params, ctx.beats, ctx.phase, noiseOctaves(ctx), [&](uint16_t i, uint8_t v) {
+      ctx.leds[i] = colours(v);
+    });
+  }
+};
+
+struct Plasma
+{
+  static const char *name() { static const char n[] PROGMEM = "Plasma"; return n; }
+  void init(const PatternContext &) {}
+  void draw(const PatternContext &ctx)
+  {
+    // the noise as hue, on from the rotating base colour
+    static const NoiseParams params PROGMEM = {3, 96, 96, 2};
+    Noise.render(params, ctx.beats, ctx.phase, noiseOctaves(ctx), [&](uint16_t i, uint8_t v) {
+      rainbowHue(ctx.leds[i], ctx.hue + v);
+    });
+    satValSpan(ctx.leds, NUM_LEDS, 240);
+  }
+};
+
+struct Fire
+{
+  static const char *name() { static const char n[] PROGMEM = "Fire"; return n; }
+  void init(const PatternContext &) {}
+  void draw(const PatternContext &ctx)
+  {
+    // quick flickering noise as heat, hottest at the bottom and cooling up the rows
+    static const NoiseParams params PROGMEM = {4, 80, 160, 3};
+    PaletteLookup colours = Palettes.use(name(), HeatColors_p);
+    Noise.render(params, ctx.beats, ctx.phase, noiseOctaves(ctx), [&](uint16_t i, uint8_t v) {
+      uint8_t cooling = Geometry::rowOf(i) * (160 / NUM_ROWS);
+      ctx.leds[i] = colours(qsub8(qadd8(v, 48), cooling));
+    });
+  }
+};
+
+/******************************/
+/*      PATTERN REGISTRY      */
+/******************************/
+// Storage big enough for any one of the patterns
+template<class... P> union PatternState {};
+template<class First, class... Rest>
+union PatternState<First, Rest...>
+{
+  First first;
+  PatternState<Rest...> rest;
+};
+
+template<class A, class B> struct SameType { static const bool value = false; };
+template<class A> struct SameType<A, A> { static const bool value = true; };
+
+// Compile time table of patterns. Lookups by index unroll into a chain of
+// direct calls the compiler can inline, rather than calls through a pointer.
+// indexOf<P>() is P's index, count if it isn't in the table.
+template<class... P> struct PatternTable;
+
+template<> struct PatternTable<>
+{
+  typedef PatternState<> State;
+  static const uint8_t count = 0;
+  static const char *name(uint8_t) { return ""; }
+  template<class P> static constexpr uint8_t indexOf() { return 0; }
+  static void init(uint8_t, State &, const PatternContext &) {}
+  static void draw(uint8_t, State &, const PatternContext &) {}
+};
+
+template<class First, class... Rest>
+struct PatternTable<First, Rest...>
+{
+  typedef PatternState<First, Rest...> State;
+  typedef PatternTable<Rest...> Next;
+  static const uint8_t count = 1 + Next::count;
+
+  static const char *name(uint8_t i) { return i == 0 ? First::name() : Next::name(i - 1); }
+  template<class P> static constexpr uint8_t indexOf() { return SameType<P, First>::value ? 0 : 1 + Next::template indexOf<P>(); }
+  static void init(uint8_t i, State &s, const PatternContext &ctx)
+  {
+    if (i == 0) s.first.init(ctx);
+    else        Next::init(i - 1, s.rest, ctx);
+  }
+  static void draw(uint8_t i, State &s, const PatternContext &ctx)
+  {
+    if (i == 0) s.first.draw(ctx);
+    else        Next::draw(i - 1, s.rest, ctx);
+  }
+};
+
+// The pattern currently running, and its state
+template<class Table>
+class PatternSlot
+{
+  public:
+    // Switch pattern. State is wiped before init() so every start is the same.
+    void start(uint8_t pattern, const PatternContext &ctx)
+    {
+      index_m = pattern % Table::count;
+      memset(&state_m, 0, sizeof(state_m));
+      Table::init(index_m, state_m, ctx);
+    }
+    void draw(const PatternContext &ctx) { Table::draw(index_m, state_m, ctx); }
+    uint8_t index() const { return index_m; }
+
+  private:
+    uint8_t index_m;
+    typename Table::State state_m;
+};
+
+// All the patterns, in the order the inc/dec buttons step through them
+typedef PatternTable<Rainbow, Confetti, RollingRowsDiag, RollingRows, ScrollRows, BPMBoogie, Sparks, Lava, Plasma, Fire> TotemPatterns;
+
+#endif /* PATTERNS_H */
@@ -0,0 +1,126 @@
+//// Playlist.h
+// A show that runs itself: patterns one after another, changing on the beat
+//
+// A playlist is a list of steps, each a pattern to show for so many beats
+// (or seconds), the transition to bring it in with and a hue speed to set
+// on the way (0 leaves the hue speed alone). Steps are 4 bytes in flash,
+// built with playBeats<Pattern>() and playSeconds<Pattern>(); the playlists
+// themselves are in Playlists.cpp. The toggle button's long press steps
+// through them: off, the first, the second ... then off again.
+//
+// Every change lands on a beat. A step in seconds is rounded to whole beats
+// at the tempo it starts at, so the tempo following the music later only
+// stretches or squeezes it a little. Starting a playlist shows its first
+// step on the next beat.
+// Control switches in handleControl(), after the beat clock has moved and
+// before the frame is drawn, so the step's first frame is the one on its
+// beat. The next step's pattern is staged in the slack after the last frame
+// before that beat has gone out: started (state zeroed, init() run) into a
+// slot of its own, as of the beat it comes in on, and its first frame drawn
+// into the transition's buffer, filling the palette table and noise cache
+// for it there. The switch swaps that frame into place and copies the slot,
+// with no init() or first draw on the frame's time. With a transition still
+// running its buffer's busy, and the first frame is drawn on the switch.
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <Arduino.h>
+#include "Patterns.h"
+#include "Transition.h"
+
+struct PlaylistStep
+{
+  uint8_t pattern;      // index in TotemPatterns
+  uint8_t length;       // beats, or seconds with PlaySeconds
+  uint8_t how;          // TransitionType, | PlaySeconds
+  uint8_t hueSpeed;     // ms per hue step to set, 0 to leave it
+
+  static const uint8_t PlaySeconds = 0x80;
+  TransitionType transition() const { return (TransitionType)(how & 0x0F); }
+  bool inSeconds() const { return how & PlaySeconds; }
+};
+
+template<class P>
+constexpr PlaylistStep playBeats(uint8_t beats, TransitionType t = LinearFade, uint8_t hueSpeed = 0)
+{
+  static_assert(TotemPatterns::indexOf<P>() < TotemPatterns::count, "not one of TotemPatterns");
+  return PlaylistStep{TotemPatterns::indexOf<P>(), beats, (uint8_t)t, hueSpeed};
+}
+
+template<class P>
+constexpr PlaylistStep playSeconds(uint8_t seconds, TransitionType t = LinearFade, uint8_t hueSpeed = 0)
+{
+  static_assert(TotemPatterns::indexOf<P>() < TotemPatterns::count, "not one of TotemPatterns");
+  return PlaylistStep{TotemPatterns::indexOf<P>(), seconds, (uint8_t)(t | PlaylistStep::PlaySeconds), hueSpeed};
+}
+
+struct Playlist
+{
+  const PlaylistStep *steps;    // in flash
+  uint8_t count;
+};
+
+extern const Playlist playlists[] PROGMEM;    // in Playlists.cpp
+extern const uint8_t numPlaylists;
+
+struct PlaylistStats
+{
+  unsigned long switches;     // steps shown
+  unsigned long staged;       // of them, switched to a pattern started ahead of time
+};
+
+// Where a playlist is up to. Only counts beats: Control does the switching.
+class PlaylistPlayer
+{
+  public:
+    static const uint8_t off = 0xFF;
+
+    PlaylistPlayer() : list_m(off), next_m(0), endBeat_m(0) { memset(&stats_m, 0, sizeof(stats_m)); }
+
+    // The first step comes in on the next beat
+    void start(uint8_t list, uint16_t beats)
+    {
+      list_m = list < numPlaylists ? list : off;
+      next_m = 0;
+      endBeat_m = beats + 1;
+    }
+    void stop() { list_m = off; }
+    bool playing() const { return list_m != off; }
+    uint8_t list() const { return list_m; }
+
+    // The step showing has had its beats: time for next()
+    bool due(uint16_t beats) const { return playing() && (int16_t)(beats - endBeat_m) >= 0; }
+    // It's on its last beat: next()'s pattern is staged on it
+    bool stageDue(uint16_t beats) const { return playing() && (int16_t)(endBeat_m - beats) <= 1; }
+
+    PlaylistStep next() const
+    {
+      Playlist p;
+      memcpy_P(&p, &playlists[list_m], sizeof(p));
+      PlaylistStep s;
+      memcpy_P(&s, &p.steps[next_m], sizeof(s));
+      return s;
+    }
+
+    // next() is showing from this beat
+    void advance(const PlaylistStep &s, uint16_t beats, uint32_t beatUs, bool staged)
+    {
+      uint16_t length = s.inSeconds() ? (s.length * 1000000UL + beatUs / 2) / beatUs : s.length;
+      endBeat_m = beats + (length ? length : 1);
+      Playlist p;
+      memcpy_P(&p, &playlists[list_m], sizeof(p));
+      next_m = next_m + 1 < p.count ? next_m + 1 : 0;
+      stats_m.switches++;
+      stats_m.staged += staged;
+    }
+
+    const PlaylistStats &stats() const { return stats_m; }
+
+  private:
+    uint8_t list_m;       // off when there's no playlist
+    uint8_t next_m;       // its step to show next
+    uint16_t endBeat_m;   // the beat the step showing ends on
+    PlaylistStats stats_m;
+};
+
+#endif /* PLAYLIST_H */
@@ -0,0 +1,29 @@
+//// Playlists.cpp
+// The playlists the toggle button's long press steps through (see Playlist.h)
+//
+// To add one, write its steps and add it to playlists[] at the bottom.
+#include "Playlist.h"
+
+// Dance floor: on the beat, 8 bars a pattern or so
+static const PlaylistStep party[] PROGMEM = {
+  playBeats<BPMBoogie>(32, LinearFade),
+  playBeats<RollingRows>(16, WipeRows),
+  playBeats<Confetti>(32, LinearFade, 10),
+  playBeats<RollingRowsDiag>(16, WipeColumns),
+  playBeats<ScrollRows>(16, CutTransition),
+  playBeats<Rainbow>(32, LinearFade, 20),
+};
+
+// Between sets: slow changes, slow colours
+static const PlaylistStep chill[] PROGMEM = {
+  playSeconds<Rainbow>(60, LinearFade, 60),
+  playSeconds<ScrollRows>(30, WipeRows),
+  playSeconds<Confetti>(45, LinearFade, 40),
+  playSeconds<BPMBoogie>(30, LinearFade, 20),
+};
+
+const Playlist playlists[] PROGMEM = {
+  {party, sizeof(party) / sizeof(party[0])},
+  {chill, sizeof(chill) / sizeof(chill[0])},
+};
+const uint8_t numPlaylists = sizeof(playlists) / sizeof(playlists[0]);
@@ -0,0 +1,118 @@
+//// PowerGovernor.h
+// Estimates the LED current of each frame and holds it under a budget
+//
+// The supply is a 2 A boost converter off an 18650, so a frame of full
+// white at full brightness would brown out the pole. The estimate is kept
+// up incrementally: FrameBuffer works out the load of each column as it
+// copies it (only the columns that changed), so there's no second pass over
+// the frame. From the frame's load the governor picks the highest global
+// brightness that stays within budget: dimming straight away when a frame
+// needs it, but only easing back up, so the brightness doesn't pump.
+// The current drawn is integrated over time for a mAh consumed figure.
+//
+// Per LED figures are FastLED's power model (WS2812B at 5 V): 16, 11 and
+// 15 mA for full red, green and blue, 1 mA dark. The colour correction and
+// temperature only ever scale down, so the estimate errs high.
+#ifndef POWERGOVERNOR_H
+#define POWERGOVERNOR_H
+
+#include <FastLED.h>
+
+struct PowerStats
+{
+  uint16_t mA;              // estimated draw of the frame on the LEDs
+  uint16_t peakmA;          // highest seen
+  uint16_t averagemA;       // EWMA over 16 frames
+  uint8_t brightness;       // global brightness applied
+  unsigned long limitedFrames;  // frames dimmed to fit the budget
+  uint32_t mAms;            // charge used so far, in mA x ms (see mAh())
+};
+
+class PowerGovernor
+{
+  public:
+    static const uint8_t redmA = 16;
+    static const uint8_t greenmA = 11;
+    static const uint8_t bluemA = 15;
+    static const uint8_t darkmA = 1;
+    static const uint8_t releaseRate = 4;    // brightness steps per frame when easing back up
+
+    PowerGovernor(uint16_t budgetmA, uint16_t baseloadmA, uint16_t numLeds)
+      : budgetmA_m(budgetmA), idlemA_m(baseloadmA + numLeds * darkmA), applied_m(0), lastmA_m(0), average16_m(0), lastUs_m(0), started_m(false)
+    {
+      memset(&stats_m, 0, sizeof(stats_m));
+    }
+
+    // Load of n pixels at full brightness, in mA x 255
+    static uint32_t load(const CRGB *pixels, uint8_t n)
+    {
+      uint16_t r = 0, g = 0, b = 0;
+      for (uint8_t i = 0; i < n; i++) {
+        r += pixels[i].r;
+        g += pixels[i].g;
+        b += pixels[i].b;
+      }
+      return (uint32_t)r * redmA + (uint32_t)g * greenmA + (uint32_t)b * bluemA;
+    }
+
+    // Brightness to show a frame of the given load at, as close to
+    // requested as the budget allows
+    uint8_t limit(uint8_t requested, uint32_t frameLoad)
+    {
+      uint32_t fullmA = frameLoad / 255;                 // draw at brightness 255
+      uint8_t ceiling = requested;
+      if (fullmA) {
+        uint16_t available = budgetmA_m > idlemA_m ? budgetmA_m - idlemA_m : 0;
+        uint32_t most = (uint32_t)available * 255 / fullmA;
+        if (most < ceiling) { ceiling = most; stats_m.limitedFrames++; }
+      }
+      if (ceiling <= applied_m || !started_m) applied_m = ceiling;          // dim at once
+      else applied_m = ceiling - applied_m > releaseRate ? applied_m + releaseRate : ceiling;  // brighten slowly
+
+      stats_m.mA = idlemA_m + (uint16_t)((fullmA * applied_m) / 255);
+      if (stats_m.mA > stats_m.peakmA) stats_m.peakmA = stats_m.mA;
+      stats_m.brightness = applied_m;
+      return applied_m;
+    }
+
+    // Call once a frame: the draw since the last call was the last frame's
+    void account(unsigned long nowUs)
+    {
+      if (started_m) {
+        uint32_t ms = (nowUs - lastUs_m) / 1000;
+        stats_m.mAms += (uint32_t)lastmA_m * ms;
+        lastUs_m += ms * 1000;
+        average16_m += (int32_t)lastmA_m - (int32_t)(average16_m >> 4);
+      } else {
+        lastUs_m = nowUs;
+        average16_m = (uint32_t)stats_m.mA << 4;
+        started_m = true;
+      }
+      lastmA_m = stats_m.mA;
+      stats_m.averagemA = average16_m >> 4;
+    }
+
+    void setBudget(uint16_t mA) { budgetmA_m = mA; }
+    uint16_t budget() const { return budgetmA_m; }
+    const PowerStats &stats() const { return stats_m; }
+    uint16_t mAh() const { return stats_m.mAms / 3600000UL; }
+    // minutes left of a battery holding capacitymAh (at 5 V), at the average draw
+    uint16_t minutesLeft(uint16_t capacitymAh) const
+    {
+      uint32_t used = mAh();
+      if (used >= capacitymAh || stats_m.averagemA == 0) return 0;
+      return (uint32_t)(capacitymAh - used) * 60 / stats_m.averagemA;
+    }
+
+  private:
+    uint16_t budgetmA_m;
+    uint16_t idlemA_m;        // controller plus every LED dark
+    uint8_t applied_m;
+    uint16_t lastmA_m;
+    uint32_t average16_m;     // averagemA in 1/16 mA
+    unsigned long lastUs_m;
+    bool started_m;
+    PowerStats stats_m;
+};
+
+#endif /* POWERGOVERNOR_H */
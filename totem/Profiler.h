@@ -0,0 +1,166 @@
+//// Profiler.h
+// Where the loop's time goes: per-stage timings with a log2 histogram
+//
+// PROFILE(ProfPattern) at the top of a block times the rest of the block.
+// Each stage keeps its min, max and mean, and a count of the times it took
+// under 8 us, 8-16 us, 16-32 us ... up to 8 ms and over (a power of two a
+// bucket). Ticks are 0.5 us: Timer1 free running at 2 MHz on the AVR, so a
+// scope is two reads of a 16 bit register and a few adds (a stage that runs
+// over 32 ms wraps). On the host they're real time, as the virtual clock
+// stands still while the sketch's code runs; elsewhere micros().
+// Counts are 16 bit. When a stage's count would overflow, its count, sum and
+// histogram all halve, so the mean and the histogram's shape carry on,
+// leaning to recent frames; min and max hold until reset().
+//
+// report() sends a LogProfile record for each stage through the log (Log.h),
+// a stage at a time as the log has room for it, so a report can be asked for
+// at any time without holding up the loop. The serial command 'p' asks for
+// one and 'P' resets (see UI::handleSerial()).
+//
+// Undefine PROFILING in Config.h and PROFILE() compiles to nothing.
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+#include "Log.h"
+
+// X(id, name): the stages timed
+#define PROFILE_STAGES(X) \
+  X(ProfLoop,    "loop") \
+  X(ProfPattern, "pattern") \
+  X(ProfShow,    "show") \
+  X(ProfTap,     "tap") \
+  X(ProfUI,      "ui") \
+  X(ProfOsc,     "osc")
+
+#define PROFILE_STAGE_ID(id, name) id,
+enum ProfileStageId : uint8_t { PROFILE_STAGES(PROFILE_STAGE_ID) numProfileStages };
+#undef PROFILE_STAGE_ID
+
+static const uint8_t profileBuckets = 12;
+
+struct ProfileStage
+{
+  uint16_t count;
+  uint16_t minTicks;
+  uint16_t maxTicks;
+  uint32_t sumTicks;
+  uint16_t buckets[profileBuckets];   // bucket 0 under 16 ticks, then a power of two each, the last open ended
+};
+
+class Profiler
+{
+  public:
+    static const uint8_t ticksPerUs = 2;
+    static const uint8_t firstBucketBits = 4;     // bucket 0 is under 2^4 ticks (8 us)
+
+    static uint16_t ticks()
+    {
+#if defined(__AVR__)
+      return TCNT1;
+#elif defined(HOST_ARDUINO_H)
+      return host::cpuTicks();
+#else
+      return micros() * ticksPerUs;
+#endif
+    }
+
+    Profiler() : reportNext_m(numProfileStages) { reset(); }
+
+    void begin()
+    {
+#if defined(__AVR__)
+      TCCR1A = 0;
+      TCCR1B = _BV(CS11);     // normal mode, clk/8: 2 MHz
+#endif
+    }
+
+    void reset()
+    {
+      memset(stages_m, 0, sizeof(stages_m));
+      for (uint8_t s = 0; s < numProfileStages; s++) stages_m[s].minTicks = 0xFFFF;
+    }
+
+    void record(ProfileStageId s, uint16_t t)
+    {
+      ProfileStage &st = stages_m[s];
+      if (st.count == 0xFFFF) halve(st);
+      st.count++;
+      st.sumTicks += t;
+      if (t < st.minTicks) st.minTicks = t;
+      if (t > st.maxTicks) st.maxTicks = t;
+      st.buckets[bucket(t)]++;
+    }
+
+    const ProfileStage &stage(ProfileStageId s) const { return stages_m[s]; }
+    static const char *name(uint8_t s)
+    {
+#define PROFILE_STAGE_NAME(id, name) name,
+      static const char *const names[] = { PROFILE_STAGES(PROFILE_STAGE_NAME) };
+#undef PROFILE_STAGE_NAME
+      return s < numProfileStages ? names[s] : "?";
+    }
+
+    // Which bucket t ticks falls in: its bit length, less firstBucketBits
+    static uint8_t bucket(uint16_t t)
+    {
+      uint8_t bits = 0;
+      if (t & 0xFF00) { bits = 8; t >>= 8; }
+      while (t) { bits++; t >>= 1; }
+      if (bits <= firstBucketBits) return 0;
+      bits -= firstBucketBits;
+      return bits < profileBuckets ? bits : profileBuckets - 1;
+    }
+
+    // A LogProfile record per stage, sent from service()
+    void report() { reportNext_m = 0; }
+    // Call every loop: as many of the report's records as the log has room for
+    void service()
+    {
+      while (reportNext_m < numProfileStages && Log.fits(reportBytes)) send((ProfileStageId)reportNext_m++);
+    }
+
+  private:
+    static const uint8_t reportBytes = 1 + 4 * 2 + profileBuckets * 2;
+
+    void send(ProfileStageId s)
+    {
+      const ProfileStage &st = stages_m[s];
+      uint16_t minUs = st.count ? st.minTicks / ticksPerUs : 0;
+      uint16_t meanUs = st.count ? st.sumTicks / st.count / ticksPerUs : 0;
+      const uint16_t *b = st.buckets;
+      LOG(LogProfile, (uint8_t)s, st.count, minUs, meanUs, (uint16_t)(st.maxTicks / ticksPerUs),
+          b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7], b[8], b[9], b[10], b[11]);
+    }
+
+    static void halve(ProfileStage &st)
+    {
+      st.count >>= 1;
+      st.sumTicks >>= 1;
+      for (uint8_t i = 0; i < profileBuckets; i++) st.buckets[i] >>= 1;
+    }
+
+    ProfileStage stages_m[numProfileStages];
+    uint8_t reportNext_m;     // next stage of the report to send, numProfileStages when there's none
+};
+
+#ifdef PROFILING
+extern Profiler Profile;      // in Control.cpp
+
+// Times the rest of the enclosing block as a stage
+class ProfileScope
+{
+  public:
+    ProfileScope(ProfileStageId s) : stage_m(s), start_m(Profiler::ticks()) {}
+    ~ProfileScope() { Profile.record(stage_m, Profiler::ticks() - start_m); }
+  private:
+    ProfileStageId stage_m;
+    uint16_t start_m;
+};
+
+  #define PROFILE(stage)    ProfileScope profileScope_(stage)
+#else
+  #define PROFILE(stage)
+#endif
+
+#endif /* PROFILER_H */
@@ -0,0 +1,106 @@
+//// RateGovernor.h
+// Picks the frame rate from what frames cost, and drops pattern quality before the rate falls too far
+//
+// Every window of frames the mean render + show time is taken, and the rate
+// set to the highest that leaves a quarter of each frame spare (for the
+// loop, the mic and the buttons), between FRAME_RATE_MIN and
+// FRAME_RATE_MAX. It comes down at once and goes back up a few frames a
+// second at a time, so a few cheap frames don't send it straight back up
+// to a rate it can't hold.
+// When the rate would have to go under FRAME_RATE_FLOOR, the quality tier
+// is lowered instead, and the rate held at the floor: the patterns leave out
+// what they can do without (a noise octave, particles, glitter; see
+// Patterns.h). Only at the lowest tier does the rate go under the floor.
+// The quality comes back once the rate it could run at is half as much
+// again as the floor (frames cost half the floor's period) and the rate
+// has climbed back to the floor, and not for holdWindows windows after it
+// was lowered, so it doesn't flip between tiers on a pattern that only
+// just fits.
+// The 8x8 globe on the Pro Micro is a few ms a frame and never leaves 60
+// FPS at full quality; it's for big poles and the heavy patterns.
+#ifndef RATEGOVERNOR_H
+#define RATEGOVERNOR_H
+
+#include <Arduino.h>
+
+// Quality tier the patterns draw at
+enum Quality : uint8_t {QualityFull, QualityReduced, QualityMinimal};
+
+struct RateStats
+{
+  uint32_t costUs;          // mean render + show time over the last window
+  unsigned long rateDrops;  // windows the rate came down in
+  unsigned long qualityDrops;
+};
+
+class RateGovernor
+{
+  public:
+    static const uint8_t windowFrames = 32;   // frames between decisions
+    static const uint8_t rampFps = 4;         // most the rate goes up a window
+    static const uint8_t holdWindows = 8;     // after the quality's lowered, before it can come back
+
+    RateGovernor(uint8_t minFps, uint8_t floorFps, uint8_t maxFps)
+      : minFps_m(minFps), floorFps_m(floorFps), maxFps_m(maxFps), fps_m(maxFps), quality_m(QualityFull), frames_m(0),
+        hold_m(0), sumUs_m(0)
+    {
+      memset(&stats_m, 0, sizeof(stats_m));
+    }
+
+    // Call once a frame with its render + show time. True at the end of a
+    // window that changed the rate or the quality.
+    bool frameDone(uint32_t costUs)
+    {
+      sumUs_m += costUs;
+      if (++frames_m < windowFrames) return false;
+      uint32_t mean = sumUs_m / windowFrames;
+      frames_m = 0;
+      sumUs_m = 0;
+      stats_m.costUs = mean;
+      if (hold_m) hold_m--;
+
+      uint8_t fps = sustainable(mean);
+      uint8_t quality = quality_m;
+      if (fps < floorFps_m && quality_m < QualityMinimal) {
+        quality_m = (Quality)(quality_m + 1);
+        stats_m.qualityDrops++;
+        hold_m = holdWindows;
+        fps = floorFps_m;
+      } else if (quality_m > QualityFull && !hold_m && fps >= floorFps_m + floorFps_m / 2 && fps_m >= floorFps_m) {
+        quality_m = (Quality)(quality_m - 1);
+        hold_m = holdWindows / 2;     // give the frames at the better quality a window or two to show what they cost
+      }
+      if (fps < minFps_m) fps = minFps_m;
+
+      uint8_t was = fps_m;
+      if (fps < fps_m) { fps_m = fps; stats_m.rateDrops++; }
+      else fps_m = fps - fps_m > rampFps ? fps_m + rampFps : fps;
+      return fps_m != was || quality_m != quality;
+    }
+
+    uint8_t fps() const { return fps_m; }
+    Quality quality() const { return quality_m; }
+    uint8_t minFps() const { return minFps_m; }
+    uint8_t floorFps() const { return floorFps_m; }
+    uint8_t maxFps() const { return maxFps_m; }
+    const RateStats &stats() const { return stats_m; }
+
+  private:
+    // Highest rate (up to maxFps_m) with a quarter of the frame to spare at this cost
+    uint8_t sustainable(uint32_t costUs) const
+    {
+      uint32_t periodUs = costUs * 4 / 3;         // the cost is three quarters of it
+      if (periodUs <= 1000000UL / maxFps_m) return maxFps_m;
+      return 1000000UL / periodUs;
+    }
+
+    uint8_t minFps_m, floorFps_m, maxFps_m;
+    uint8_t fps_m;
+    Quality quality_m;
+    uint8_t frames_m;       // into the window
+    uint8_t hold_m;         // windows until the quality can come back
+    uint32_t sumUs_m;
+    RateStats stats_m;
+};
+
+#endif /* RATEGOVERNOR_H */
@@ -0,0 +1,189 @@
+//// Settings.h
+// Brightness, pattern, tempo and hue speed kept in EEPROM across power cycles
+//
+// The EEPROM is a journal: each save is a new record in the next slot of a
+// ring over it, so the cells wear evenly, each written once every
+// slots() saves (the 32u4's 1 KB is 128 slots: at 100,000 writes a cell,
+// over 12 million saves). restore() takes the newest record whose CRC is
+// good.
+// Record (8 bytes): sequence number (2), brightness, pattern, hue speed,
+// beat period in ms (2), CRC-8 of the seven before it. It's written with
+// the sequence number last, so a write the power cut short leaves either a
+// record that fails its CRC or one older than the record before it; either
+// way restore() falls back to the last whole save.
+//
+// Changes are coalesced: a save is only made once the settings have stayed
+// put for quietMs, so holding a button down makes one write, not dozens.
+// It's then written a byte per service() call, each only once the EEPROM
+// has finished the one before (3.4 ms on the AVR), so saving never holds
+// up the loop. Bytes that already hold their value aren't written again.
+// While a playlist runs the pattern and hue speed are its, not the user's,
+// so they're left as last saved (or they'd be saved at every step).
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "Control.h"
+
+struct SettingsStats
+{
+  unsigned long saves;          // records written
+  unsigned long bytesWritten;   // of them, the bytes that changed
+  uint16_t seq;                 // of the newest record
+  uint16_t slot;                // where it is
+};
+
+class Settings
+{
+  public:
+    static const uint8_t recordSize = 8;
+    static const uint16_t quietMs = 3000;     // unchanged this long before a save
+
+    Settings(Control *c, uint16_t start = SETTINGS_EEPROM_START, uint16_t size = SETTINGS_EEPROM_SIZE)
+      : control_m(c), start_m(start), slots_m(size / recordSize), writeAt_m(recordSize), saved_m(), pending_m(), changedMs_m(0)
+    {
+      saved_m = pending_m = current();
+      memset(&stats_m, 0, sizeof(stats_m));
+      stats_m.seq = 0xFFFF;
+      stats_m.slot = slots_m - 1;     // so the first save goes in slot 0
+    }
+
+    // Puts the newest good record's settings into Control; false (leaving
+    // Control's defaults) if there isn't one
+    bool restore()
+    {
+      uint8_t rec[recordSize];
+      bool found = false;
+      for (uint16_t slot = 0; slot < slots_m; slot++) {
+        for (uint8_t i = 0; i < recordSize; i++) rec[i] = EEPROM.read(address(slot) + i);
+        uint16_t seq = rec[0] | (rec[1] << 8);
+        if (seq == 0xFFFF || crc(rec) != rec[recordSize - 1]) continue;    // never written, or torn
+        if (found && (int16_t)(seq - stats_m.seq) <= 0) continue;
+        found = true;
+        stats_m.seq = seq;
+        stats_m.slot = slot;
+        saved_m.brightness = rec[2];
+        saved_m.pattern = rec[3];
+        saved_m.speed = rec[4];
+        saved_m.periodMs = rec[5] | (rec[6] << 8);
+      }
+      if (found) {
+        control_m->set_brightness(saved_m.brightness);
+        if (saved_m.pattern < Control::getNumPatterns() && saved_m.pattern != control_m->getPattern()) control_m->set_pattern(saved_m.pattern);
+        control_m->setHueSpeed(saved_m.speed);
+        if (saved_m.periodMs) control_m->set_tempo(saved_m.periodMs);
+        LOG(LogSettings, (uint8_t)0, stats_m.seq, stats_m.slot);
+      }
+      saved_m = pending_m = current();    // what's showing now is what's kept, whether restored or not
+      return found;
+    }
+
+    // Call every loop: starts a save once the settings have been quiet, and
+    // writes a byte of one in progress when the EEPROM is ready for it
+    void service()
+    {
+      if (writeAt_m < recordSize) {
+        if (ready()) writeNext();
+        return;
+      }
+      Values now = current();
+      if (now != saved_m) {
+        if (now != pending_m) { pending_m = now; changedMs_m = millis(); }
+        if (millis() - changedMs_m >= quietMs) save(now);
+      }
+    }
+
+    bool saving() const { return writeAt_m < recordSize; }
+    uint16_t slots() const { return slots_m; }
+    const SettingsStats &stats() const { return stats_m; }
+
+  private:
+    struct Values
+    {
+      uint8_t brightness, pattern, speed;
+      uint16_t periodMs;
+      bool operator!=(const Values &o) const
+      {
+        return brightness != o.brightness || pattern != o.pattern || speed != o.speed || periodMs != o.periodMs;
+      }
+    };
+
+    Values current() const
+    {
+      Values v = {control_m->getBrightness(), control_m->getPattern(), control_m->getHueSpeed(), control_m->get_tempo()};
+      if (control_m->getPlaylist() != PlaylistPlayer::off) { v.pattern = saved_m.pattern; v.speed = saved_m.speed; }
+      return v;
+    }
+
+    // Lays out a record for the next slot; service() writes it out
+    void save(const Values &v)
+    {
+      uint16_t seq = stats_m.seq + 1;
+      if (seq == 0xFFFF) seq = 0;       // reads as an erased slot
+      stats_m.seq = seq;
+      stats_m.slot = (stats_m.slot + 1) % slots_m;
+      record_m[0] = seq;
+      record_m[1] = seq >> 8;
+      record_m[2] = v.brightness;
+      record_m[3] = v.pattern;
+      record_m[4] = v.speed;
+      record_m[5] = v.periodMs;
+      record_m[6] = v.periodMs >> 8;
+      record_m[7] = crc(record_m);
+      writeAt_m = 0;
+      saved_m = v;
+      stats_m.saves++;
+      LOG(LogSettings, (uint8_t)1, seq, stats_m.slot);
+    }
+
+    // One byte: the settings and CRC first, the sequence number last
+    void writeNext()
+    {
+      while (writeAt_m < recordSize) {
+        uint8_t i = (writeAt_m + 2) % recordSize;
+        uint16_t a = address(stats_m.slot) + i;
+        writeAt_m++;
+        if (EEPROM.read(a) != record_m[i]) {
+          EEPROM.write(a, record_m[i]);
+          stats_m.bytesWritten++;
+          return;
+        }
+      }
+    }
+
+    static bool ready()
+    {
+#if defined(__AVR__)
+      return eeprom_is_ready();
+#elif defined(HOST_EEPROM_H)
+      return EEPROM.hostReady();
+#else
+      return true;
+#endif
+    }
+
+    uint16_t address(uint16_t slot) const { return start_m + slot * recordSize; }
+
+    static uint8_t crc(const uint8_t *rec)
+    {
+      uint8_t c = 0;
+      for (uint8_t i = 0; i < recordSize - 1; i++) {
+        c ^= rec[i];
+        for (uint8_t k = 0; k < 8; k++) c = c & 0x80 ? (c << 1) ^ 0x07 : c << 1;
+      }
+      return c;
+    }
+
+    Control *control_m;
+    uint16_t start_m;
+    uint16_t slots_m;
+    uint8_t record_m[recordSize];   // being written
+    uint8_t writeAt_m;              // bytes of it done, recordSize when not saving
+    Values saved_m;                 // as in the newest record
+    Values pending_m;               // changed to this at changedMs_m
+    unsigned long changedMs_m;
+    SettingsStats stats_m;
+};
+
+#endif /* SETTINGS_H */
@@ -0,0 +1,64 @@
+//// Shards.h
+// Splits the matrix into strips of whole columns, each on its own data pin
+//
+// A WS2812B strip takes ~30 us per LED to send, so one long strip caps the
+// frame rate of a big pole (960 LEDs is ~29 ms, under 35 FPS before
+// anything is drawn). The matrix is column major, so a group of columns is
+// a contiguous slice of the frame: shard s is columns s * colsPerShard on,
+// and gets its own FastLED controller on its own pin.
+// How the shards are sent is up to Control (see showFrame()): one after
+// another, skipping those whose columns didn't change, or all at once on
+// boards where FastLED drives several pins in parallel.
+// Patterns that want to can render a shard at a time with slice()/firstCol().
+#ifndef SHARDS_H
+#define SHARDS_H
+
+#include <FastLED.h>
+
+template<class G, uint8_t N>
+struct MatrixShards
+{
+    static_assert(N >= 1 && G::numCols % N == 0, "shards must split the columns evenly");
+
+    static const uint8_t count = N;
+    static const uint8_t colsPerShard = G::numCols / N;
+    static const uint16_t ledsPerShard = colsPerShard * G::numRows;
+
+    // Time to send a shard (24 bits at 800 kHz a LED, then the latch). On
+    // the AVR interrupts are off for all of it, and Timer0 with them, so
+    // micros() can't measure it.
+    static const uint8_t ledUs = 30;
+    static const uint8_t latchUs = 50;
+    static const uint32_t wireUs = (uint32_t)ledsPerShard * ledUs + latchUs;
+
+    static uint8_t firstCol(uint8_t s) { return s * colsPerShard; }
+    static uint8_t shardOf(uint8_t col) { return col / colsPerShard; }
+    static CRGB *slice(CRGB *leds, uint8_t s) { return leds + s * ledsPerShard; }
+
+    // One controller per shard, on the first N of PINS in column order
+    template<template<uint8_t, EOrder> class CHIP, EOrder ORDER, uint8_t... PINS>
+    static void addLeds(CRGB *leds, LEDColorCorrection correction)
+    {
+      static_assert(sizeof...(PINS) >= N, "need a data pin for every shard");
+      AddShard<CHIP, ORDER, 0, true, PINS...>::add(leds, correction);
+    }
+
+  private:
+    // S counts up the shards; stops at N, so unused pins get no controller
+    template<template<uint8_t, EOrder> class CHIP, EOrder ORDER, uint8_t S, bool MORE, uint8_t... PINS>
+    struct AddShard
+    {
+      static void add(CRGB *, LEDColorCorrection) {}
+    };
+    template<template<uint8_t, EOrder> class CHIP, EOrder ORDER, uint8_t S, uint8_t PIN, uint8_t... REST>
+    struct AddShard<CHIP, ORDER, S, true, PIN, REST...>
+    {
+      static void add(CRGB *leds, LEDColorCorrection correction)
+      {
+        FastLED.addLeds<CHIP, PIN, ORDER>(slice(leds, S), ledsPerShard).setCorrection(correction);
+        AddShard<CHIP, ORDER, S + 1, (S + 1 < N), REST...>::add(leds, correction);
+      }
+    };
+};
+
+#endif /* SHARDS_H */
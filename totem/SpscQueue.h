@@ -0,0 +1,59 @@
+//// SpscQueue.h
+// Lock-free queue from one interrupt handler to the main loop
+//
+// One producer (an ISR) and one consumer (loop()). Each side only writes
+// its own index, and indices are single bytes, so no side ever sees a half
+// written index and nothing needs interrupts turned off. An entry is
+// written before head moves past it, and read before tail does. When full,
+// push() drops the entry and counts it rather than overwrite unread ones.
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <Arduino.h>
+
+template<class T, uint8_t N>
+class SpscQueue
+{
+  public:
+    static_assert(N && (N & (N - 1)) == 0 && N <= 128, "queue size must be a power of two, at most 128");
+
+    SpscQueue() : head_m(0), tail_m(0), dropped_m(0) {}
+
+    // producer side
+    bool push(const T &item)
+    {
+      uint8_t head = head_m;
+      uint8_t next = (head + 1) & (N - 1);
+      if (next == tail_m) { dropped_m++; return false; }
+      items_m[head] = item;
+      barrier();
+      head_m = next;
+      return true;
+    }
+
+    // consumer side
+    bool pop(T &item)
+    {
+      uint8_t tail = tail_m;
+      if (tail == head_m) return false;
+      barrier();
+      item = items_m[tail];
+      barrier();
+      tail_m = (tail + 1) & (N - 1);
+      return true;
+    }
+    bool empty() const { return head_m == tail_m; }
+    uint8_t size() const { return (head_m - tail_m) & (N - 1); }
+    uint8_t dropped() const { return dropped_m; }   // entries lost to a full queue (wraps)
+
+  private:
+    // keeps the compiler from moving the entry's copy across the index update
+    static void barrier() { __asm__ __volatile__("" ::: "memory"); }
+
+    T items_m[N];
+    volatile uint8_t head_m;      // written by the producer only
+    volatile uint8_t tail_m;      // written by the consumer only
+    volatile uint8_t dropped_m;
+};
+
+#endif /* SPSCQUEUE_H */
@@ -0,0 +1,130 @@
+//// Transition.h
+// Blends from one pattern to the next instead of cutting
+//
+// While a transition runs both patterns keep drawing: the outgoing one into
+// the transition's own buffer (seeded with its last frame), the incoming one
+// into leds_m as usual. The two are blended a column at a time straight
+// into the front buffer (FrameBuffer::commitFrom), so there's no third
+// full frame buffer.
+// Wipes use the matrix geometry: WipeRows sweeps a soft edge from the
+// bottom to the top, WipeColumns sweeps it around the globe.
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+#include <FastLED.h>
+
+enum TransitionType : uint8_t {CutTransition, LinearFade, WipeRows, WipeColumns, numTransitionTypes};
+
+// out = a * (256 - amountOfB) / 256 + b * amountOfB / 256 over n pixels,
+// amountOfB from 0 (all a) to 256 (all b). Stays within 16 bits on the AVR.
+inline void blendSpan(const CRGB *a, const CRGB *b, CRGB *out, uint8_t n, uint16_t amountOfB)
+{
+  const uint8_t *pa = a[0].raw;
+  const uint8_t *pb = b[0].raw;
+  uint8_t *po = out[0].raw;
+  uint16_t amountOfA = 256 - amountOfB;
+  for (uint16_t i = 0; i < n * 3; i++) {
+    po[i] = (uint8_t)((pa[i] * amountOfA + pb[i] * amountOfB) >> 8);
+  }
+}
+
+inline void blendPixel(const CRGB &a, const CRGB &b, CRGB &out, uint16_t amountOfB)
+{
+  uint16_t amountOfA = 256 - amountOfB;
+  out.r = (uint8_t)((a.r * amountOfA + b.r * amountOfB) >> 8);
+  out.g = (uint8_t)((a.g * amountOfA + b.g * amountOfB) >> 8);
+  out.b = (uint8_t)((a.b * amountOfA + b.b * amountOfB) >> 8);
+}
+
+template<class G>
+class Transition
+{
+  public:
+    Transition() : to_m(0), start_m(0), durationMs_m(800), progress_m(0), type_m(LinearFade), active_m(false), held_m(false) {}
+
+    void setType(TransitionType type) { type_m = type < numTransitionTypes ? type : LinearFade; }
+    void setDuration(uint16_t ms) { durationMs_m = ms ? ms : 1; }
+    TransitionType type() const { return type_m; }
+    uint16_t duration() const { return durationMs_m; }
+    bool active() const { return active_m; }
+
+    // Start blending from the frame in 'to' (the outgoing pattern's last
+    // frame, which it keeps drawing on in outgoing()) to whatever gets
+    // drawn into 'to' from now on. Begun again before it's done, it blends
+    // from the frame it had got to instead, held still (see held()), so the
+    // pattern that was fading out doesn't vanish. fromDrawn: the caller has
+    // put the outgoing frame in outgoing() already.
+    void begin(CRGB *to, unsigned long nowMs, bool fromDrawn = false)
+    {
+      if (type_m == CutTransition) { active_m = false; return; }
+      if (fromDrawn) {
+        held_m = false;
+      } else if (active_m) {
+        for (uint8_t c = 0; c < G::numCols; c++) column(c, from_m + c * G::numRows);   // in place: a pixel only reads itself
+        held_m = true;
+      } else {
+        memcpy(from_m, to, sizeof(from_m));
+        held_m = false;
+      }
+      to_m = to;
+      start_m = nowMs;
+      progress_m = 0;
+      active_m = true;
+    }
+    CRGB *outgoing() { return from_m; }
+    bool held() const { return held_m; }    // the outgoing frame is a still: don't draw into it
+
+    // Call once a frame, before the blended frame is committed
+    void update(unsigned long nowMs)
+    {
+      unsigned long elapsed = nowMs - start_m;
+      if (elapsed >= durationMs_m) {
+        progress_m = 256;
+        active_m = false;   // this last frame is all incoming
+      } else {
+        progress_m = (uint16_t)((elapsed * 256UL) / durationMs_m);
+      }
+    }
+    uint16_t progress() const { return progress_m; }    // 0..256
+
+    // Column source for FrameBuffer::commitFrom()
+    const CRGB *column(uint8_t c, CRGB *scratch)
+    {
+      const CRGB *from = from_m + c * G::numRows;
+      const CRGB *to = to_m + c * G::numRows;
+      switch (type_m) {
+        case WipeRows:
+          for (uint8_t k = 0; k < G::numRows; k++) {
+            blendPixel(from[k], to[k], scratch[k], wipeAmount(G::rowOf(c * G::numRows + k), G::numRows));
+          }
+          break;
+        case WipeColumns:
+          blendSpan(from, to, scratch, G::numRows, wipeAmount(c, G::numCols));
+          break;
+        default:
+          blendSpan(from, to, scratch, G::numRows, progress_m);
+          break;
+      }
+      return scratch;
+    }
+
+  private:
+    // A one row (or column) wide soft edge that travels from before line 0
+    // to past the last line over the transition
+    uint16_t wipeAmount(uint8_t line, uint8_t lines) const
+    {
+      int32_t amount = (int32_t)progress_m * (lines + 1) - (int32_t)line * 256;
+      return amount < 0 ? 0 : (amount > 256 ? 256 : (uint16_t)amount);
+    }
+
+    CRGB from_m[G::numLeds];
+    CRGB *to_m;
+    unsigned long start_m;
+    uint16_t durationMs_m;
+    uint16_t progress_m;
+    TransitionType type_m;
+    bool active_m;
+    bool held_m;
+};
+
+#endif /* TRANSITION_H */
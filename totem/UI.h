@@ -2,6 +2,7 @@
 #define UI_H
 
 #include "Control.h"
+#include "Buttons.h"
 
 #define NUM_BUTTONS       4
 #define UI_LEDS   3
@@ -9,7 +10,6 @@
 //TODO
 // VISUAL FEEDBACK FOR MODES
 // EXTRA MODES (e.g. hue speed select, single hue select)
-// refactor button handle code (single handleButton fn that takes (button pressed and press type) and calls relevant fns)
 
 
 // Enum definitions
@@ -42,127 +42,168 @@ class UI
       // Decrements either pattern, brightness scale or speed depending on UIState
       // inputPins[2]
     void fnButton(buttonPress_t b);
-      // Used for tap tempo, possibly other fns... (See below)
+      // Used for tap tempo, possibly other fns... (See below). Long press shows the frame rate and quality
       // inputPins[3]
+    void stepButton(int8_t direction, buttonPress_t b);
+      // what inc and dec share, direction +1 or -1
 
-    void (UI::*buttonFunctions[NUM_BUTTONS])(buttonPress_t b) = {&toggleButton, &incButton, &decButton, &fnButton};
-      // pointer to each of the button functions (each take a buttonPress variable (shortPress/longPress))
+    typedef void (UI::*ButtonHandler)(buttonPress_t b);
+    static const ButtonHandler buttonFunctions[NUM_BUTTONS];
+      // pointer to each of the button functions (each take a buttonPress variable (shortPress/longPress)), in flash
+    void callButton(uint8_t button, buttonPress_t b);
 
+    void buttonEvent(const ButtonEvent &e);
+      // calls the button's function for presses, long presses and repeats
+    void showState();
+      // UIState on the indicator LEDs, when it changes
+    void showStatus();
+      // the frame rate and quality on the indicator LEDs, for statusMs after a long press of fn or a change of quality
+    void handleSerial();
+      // one letter commands from the serial port
       
-    // Pin definitions
-    const uint8_t outputPins[UI_LEDS] = {A1,A2,A3};             // output pins for feedback of UIState 
-    const uint8_t inputPins[NUM_BUTTONS] = {2,3,4,5};   //In order: toggle, inc, dec, fn
+    // Pin definitions (the tables are in flash, PROGMEM, below)
+    static const uint8_t outputPins[UI_LEDS];       // output pins for feedback of UIState
+    static const uint8_t inputPins[NUM_BUTTONS];    // In order: toggle, inc, dec, fn
     
-    // Button related declarations
-    unsigned long lastDebounceTime[NUM_BUTTONS];  //used to debounce buttons. last time pin output toggled
-    uint8_t lastPinValue[NUM_BUTTONS];      // last button state
-    uint8_t buttonState[NUM_BUTTONS];       // current button state
-    
-    const unsigned short debounceDelay = 20;
-    const unsigned short holdTime[NUM_BUTTONS] = {4000,600,600,4000};
-    const unsigned short repeatRate[NUM_BUTTONS] = {4000,200,200,4000}; //repeat rate different for different buttons
+    // Button timing: hold for a long press, then repeat rate (different for different buttons)
     // TODO, repeatRate increases if you hold down for longer
-    bool trigger[NUM_BUTTONS] = {true, true, true, true};
-    unsigned long lastTriggered[NUM_BUTTONS] = {0,0,0,0};
+    static const ButtonTiming buttonTiming[NUM_BUTTONS];
+    Buttons<NUM_BUTTONS> buttons;     // interrupt driven, see Buttons.h
+    ButtonEvent event;                // the one being handled
+
+    static const uint16_t statusMs = 4000;
+    bool showingStatus;
+    unsigned long statusFrom;         // millis() the status went up on the LEDs
+    Quality shownQuality;             // last quality the status was shown for
 };
 
 #endif /* UI_H */
 
+#if defined(__AVR__)
+// 1 kHz tick for the buttons on pins without an interrupt of their own (see Buttons::begin())
+ISR(TIMER0_COMPB_vect)
+{
+  Buttons<NUM_BUTTONS>::isr();
+}
+#endif
+
+const uint8_t UI::outputPins[UI_LEDS] PROGMEM = {A1,A2,A3};
+const uint8_t UI::inputPins[NUM_BUTTONS] PROGMEM = {2,3,4,5};
+const ButtonTiming UI::buttonTiming[NUM_BUTTONS] PROGMEM = {{4000,4000}, {600,200}, {600,200}, {1000,4000}};
+const UI::ButtonHandler UI::buttonFunctions[NUM_BUTTONS] PROGMEM = {&UI::toggleButton, &UI::incButton, &UI::decButton, &UI::fnButton};
+
 UI::UI(Control *c)
-  : UIState(pattern)
+  : UIState(pattern), buttons(inputPins, buttonTiming), showingStatus(false), statusFrom(0), shownQuality(QualityFull)
 {
   Control_m = c;
-  
-  unsigned long lastDebounceTime[NUM_BUTTONS] = {0,0,0,0};  //used to debounce buttons. last time pin output toggled
-  unsigned short debounceDelay = 20;
-
-  uint8_t lastPinValue[NUM_BUTTONS] = {HIGH, HIGH, HIGH, HIGH}; // pills are pulled high
-  uint8_t buttonState[NUM_BUTTONS] = {HIGH, HIGH, HIGH, HIGH};
+  memset(&event, 0, sizeof(event));
 }
 
 void UI::setupUI()
 {
-  for (uint8_t i = 0; i < NUM_BUTTONS; i++)
-  {
-    pinMode(inputPins[i], INPUT_PULLUP);
-  }  
+  buttons.begin();
   for (uint8_t i = 0; i < UI_LEDS; i++)
   {
-    pinMode(outputPins[i], OUTPUT);
-    digitalWrite(outputPins[i], LOW);
+    pinMode(pgm_read_byte(&outputPins[i]), OUTPUT);
   }
+  showState();
 }
 
 void UI::handleUI()
 {
-  // Includes jitter protection (i.e. won't register button repress if within 20msec)
-  // Inc and dec buttons keep firing after a period of time (700msec, sends button down every 200msec?)
+  PROFILE(ProfUI);
+  // Buttons are read by interrupts; this only hands on what they queued
+  // (debounced, with long presses repeating), so it costs next to nothing
+  // while no button is touched
+  buttons.poll([this](const ButtonEvent &e) { buttonEvent(e); });
+  handleSerial();
+
+  // the status comes up by itself when the patterns' quality changes
+  if (Control_m->getQuality() != shownQuality) {
+    shownQuality = Control_m->getQuality();
+    showingStatus = true;
+    statusFrom = millis();
+  }
+  if (showingStatus) {
+    if (millis() - statusFrom < statusMs) showStatus();
+    else showState();
+  }
+}
+
+void UI::handleSerial()
+{
+  while (Serial.available()) {
+    switch (Serial.read()) {
+#ifdef PROFILING
+      case 'p' : Profile.report(); break;     // a LogProfile record per stage
+      case 'P' : Profile.reset(); break;
+#endif
+      case 's' : Control_m->logFrameRate(); break;    // the frame rate and quality, as logged when they change
+      default : break;
+    }
+  }
+#ifdef PROFILING
+  Profile.service();    // the report goes out a stage at a time, as the log has room
+#endif
+}
+
+void UI::buttonEvent(const ButtonEvent &e)
+{
+  event = e;
+  LOG(LogButton, e.button, (uint8_t)e.type, e.heldMs);
+  switch (e.type) {
+    case ButtonPress :
+      callButton(e.button, shortPress);
+      break;
+    case ButtonLongPress :
+    case ButtonRepeat :
+      callButton(e.button, longPress);
+      break;
+    default :
+      break;
+  }
+}
 
+void UI::callButton(uint8_t button, buttonPress_t b)
+{
+  ButtonHandler f;
+  memcpy_P(&f, &buttonFunctions[button], sizeof(f));
+  (this->*f)(b);
+}
+
+void UI::showState()
+{
+  showingStatus = false;
   //Output indictor lights
   for (uint8_t i = 0; i < UI_LEDS; i++)
   {
     if (UIState == i){
-      digitalWrite(outputPins[i], HIGH);  
+      digitalWrite(pgm_read_byte(&outputPins[i]), HIGH);  
     }
     else {
-      digitalWrite(outputPins[i], LOW);
+      digitalWrite(pgm_read_byte(&outputPins[i]), LOW);
     }
   }
+}
 
-  // for each button
-  for (uint8_t i = 0; i < NUM_BUTTONS; i++)
+// The frame rate as a bar: all three at the top rate, one at the floor or
+// under. Steady at full quality, blinking slowly at reduced and quickly at
+// minimal.
+void UI::showStatus()
+{
+  uint8_t fps = Control_m->getFrameRate();
+  const RateGovernor &rate = Control_m->getRateGovernor();
+  uint8_t lit = fps >= rate.maxFps() ? 3 : fps > rate.floorFps() ? 2 : 1;
+  Quality q = Control_m->getQuality();
+  bool on = q == QualityFull || ((millis() - statusFrom) >> (q == QualityReduced ? 9 : 7)) % 2 == 0;
+  for (uint8_t i = 0; i < UI_LEDS; i++)
   {
-    // Looking for switch that goes low as we have pullup resistors on
-    uint8_t reading = digitalRead(inputPins[i]);
-
-    // If the switch changed, due to noise or pressing
-    if ( reading != lastPinValue[i] )
-    {
-      // reset debouncing timer
-      lastDebounceTime[i] = millis();
-    }
-
-    if ( (millis() - lastDebounceTime[i]) > debounceDelay )
-    {
-      // Whatever the reading is it, it's been there for longer than debounce delay
-      // So take it as current state
-
-      // if button has changed state
-      if (reading != buttonState[i]) 
-      {
-        buttonState[i] = reading; 
-        // if button has changed state to LOW reading
-        if (reading == LOW)
-        { // triger short press
-          (this->*buttonFunctions[i])(shortPress);
-        }
-      }
-      // This triggers after a button has been low for > 700msec
-      if ( (reading == LOW) and (( millis() - lastDebounceTime[i] ) > holdTime[i]) )
-      {
-        // If trigger is true, repeat function inc
-        if (trigger[i])
-        {
-          (this->*buttonFunctions[i])(longPress);
-          trigger[i] = false;
-          lastTriggered[i] = millis();
-        }
-        // this checks if we have gone past repeatrate
-        if ( (millis() - lastTriggered[i]) > repeatRate[i])
-        {
-          trigger[i] = true; 
-        }
-      }
-    }
-    lastPinValue[i] = reading; // save the reading
+    digitalWrite(pgm_read_byte(&outputPins[i]), on && i < lit ? HIGH : LOW);
   }
-
-//  updateTap();
 }
 
 void UI::toggleButton(buttonPress_t p)
 {
-  DEBUG("Toggle button Pressed\n\tUI State: ");
   // Short press
   if (p == shortPress)
   {
@@ -171,129 +212,72 @@ void UI::toggleButton(buttonPress_t p)
       // LEDS A (pattern) LED A (brightness) LED A Speed
       case pattern : 
         UIState = brightness;   
-        DEBUG_L("Brightness");
         break;
       case brightness :
         UIState = speed;        
-        DEBUG_L("Speed");
         break;
       case speed : 
         UIState = pattern;      
-        DEBUG_L("Pattern");
         break;
     }
+    LOG(LogUIState, (uint8_t)UIState);
+    showState();
   }
-  // Long press ??
-  // Possible modes: pattern (default), brightness, speed. Inditacted by lights
+  // Long press: the next playlist, or off after the last (see Playlist.h)
   if (p == longPress)
   {
-    // do something fun. Maybe default/reset/lasers on&off?
-    DEBUG("\t(long press)");
+    Control_m->nextPlaylist();
   }
 }
 
 void UI::incButton(buttonPress_t p)
 {
-  DEBUG("Inc button Pressed");
-  if (p == shortPress)
-  {
-//    Serial.println("\t(Short press)");
-    switch(UIState){
-    case pattern :
-      // increment pattern
-      DEBUG_L("\t(inc pattern)");
-      Control_m->inc_pattern();
-      break;
-    case brightness :
-      // inc brightness
-      DEBUG_L("\t(inc brightness)");
-      Control_m->incBrightness();
-      DEBUG("Brightness:\t");
-      DEBUG_L(Control_m->getBrightness());
-      break;
-    case speed :
-      // inc speed
-      DEBUG_L("\t(inc speed)");
-      Control_m->incHueSpeed();
-      break;
-    }
-  } else if (p == longPress)
-  {
-    // long press
-    DEBUG_L("\t(Long press)");
-    uint8_t multiplier = 1;
-    switch(UIState){
-    case pattern :
-      // increment pattern
-      DEBUG_L("\t(inc pattern)");
-      //Control_m->incPattern();
-      break;
-    case brightness :
-      // inc brightness
-      DEBUG_L("\t(inc brightness)");
-      // speed up inc if held for longer
-      if (( millis() - lastDebounceTime[1] ) > 2000)       {multiplier = 2;} 
-      Control_m->incBrightness(5*multiplier);
-      DEBUG("Brightness:\t");
-      DEBUG_L(Control_m->getBrightness());
-      break;
-    case speed :
-      // inc speed
-      DEBUG_L("\t(inc speed)");
-      //Control_m->incSpeed(5);
-      break;
-    }
-  }
+  stepButton(1, p);
 }
 
 void UI::decButton(buttonPress_t p)
 {
-  DEBUG("Dec button");
+  stepButton(-1, p);
+}
+
+void UI::stepButton(int8_t direction, buttonPress_t p)
+{
   if (p == shortPress)
   {
-//    Serial.println("\t(Short press)");
     switch(UIState){
     case pattern :
-      // decrement pattern
-      DEBUG_L("\t(dec pattern)");
-      Control_m->dec_pattern();
+      // step pattern
+      if (direction > 0) {Control_m->inc_pattern();}
+      else               {Control_m->dec_pattern();}
       break;
     case brightness :
-      // dec brightness
-      DEBUG_L("\t(dec brightness)");
-      Control_m->decBrightness();
-      DEBUG("Brightness:\t");
-      DEBUG_L(Control_m->getBrightness());
+      // step brightness
+      if (direction > 0) {Control_m->incBrightness();}
+      else               {Control_m->decBrightness();}
+      LOG(LogBrightness, Control_m->getBrightness());
       break;
     case speed :
-      // dec speed
-      DEBUG_L("\t(dec speed)");
-      Control_m->decHueSpeed();
+      // step speed
+      if (direction > 0) {Control_m->incHueSpeed();}
+      else               {Control_m->decHueSpeed();}
       break;
     }
   } else if (p == longPress)
   {
-    // long press
-    DEBUG_L("\t(Long press)");
+    // long press, repeats while held
     uint8_t multiplier = 1;
     switch(UIState){
     case pattern :
-      // decrement pattern
-      DEBUG_L("\t(inc pattern)");
-      //Control_m->decPattern();
+      //Control_m->incPattern();
       break;
     case brightness :
-      // dec brightness
-      DEBUG_L("\t(dec brightness)");
-      // speed up decrement if button held for longer
-      if (( millis() - lastDebounceTime[2] ) > 2000)       {multiplier = 2;} 
-      Control_m->decBrightness(5*multiplier);
-      DEBUG("Brightness:\t");
-      DEBUG_L(Control_m->getBrightness());
+      // speed up if held for longer
+      if (event.heldMs > 2000)       {multiplier = 2;} 
+      if (direction > 0) {Control_m->incBrightness(5*multiplier);}
+      else               {Control_m->decBrightness(5*multiplier);}
+      LOG(LogBrightness, Control_m->getBrightness());
       break;
     case speed :
-      // inc speed
-      DEBUG_L("\t(inc speed)");
       //Control_m->incSpeed(5);
       break;
     }
@@ -302,10 +286,16 @@ void UI::decButton(buttonPress_t p)
 
 void UI::fnButton(buttonPress_t p)
 {
+  // Long press: the frame rate and quality on the indicator LEDs for a while
+  if (p == longPress)
+  {
+    showingStatus = true;
+    statusFrom = millis();
+    Control_m->logFrameRate();
+  }
   if (p == shortPress)
   {
-    DEBUG_L("Function Button (Short press)");
-    Control_m->tap();
+    Control_m->tap(micros() - (millis() - event.ms) * 1000);   // when it was pressed, not when we got to it
     switch(UIState){
     case pattern :
       // temporary flash pattern while held down?
@@ -323,9 +313,5 @@ void UI::fnButton(buttonPress_t p)
 
 void UI::renderUI() {
   //potentially output to OSC
-  uint8_t brightness_temp = 96;
-  uint8_t speed_temp = 10;
-  
-  
 }
 
@@ -1,24 +1,43 @@
 #include "Control.h"
 #include "UI.h"
+#include "Settings.h"
+#ifdef OSC
+#include OSC_UDP_H
+#include "Osc.h"
+#endif
 
 
 
 CRGB leds[NUM_LEDS];
 Control Control(leds, NUM_LEDS);
 UI ui(&Control);
+Settings settings(&Control);
+#ifdef OSC
+OSC_UDP oscUdp;
+OscEndpoint osc(&Control, oscUdp);
+#endif
 
 void setup() {
   // put your setup code here, to run once:
-  Serial.begin(115200);
-  while (!Serial);
+  Serial.begin(115200);     // no waiting for USB: the log just drops what can't be sent
   
   Control.setupControl();
   ui.setupUI();
-  Serial.println("Setup Complete");
+  settings.restore();       // as they were when the power went
+#ifdef OSC
+  osc.begin(OSC_PORT, OSC_FEEDBACK_PORT);   // after the network board is up
+#endif
+  LOG(LogBoot, (uint16_t)NUM_LEDS, (uint8_t)NUM_SHARDS);
 }
 
 void loop() {
   // put your main code here, to run repeatedly:
+  PROFILE(ProfLoop);
   Control.handleControl();
   ui.handleUI();
+  settings.service();
+#ifdef OSC
+  osc.service();
+#endif
+  Log.service();
 }